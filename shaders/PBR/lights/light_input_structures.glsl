@@ -25,13 +25,23 @@ layout(set = 1, binding = 0) uniform LightData
 }
 lightData;
 
-layout(set = 2, binding = 0) uniform GLTFMaterialData
+// bindless materials: one table for every material, draws pick theirs with PushConstants.materialIndex. the
+// texture fields are indices into textures, the shaders indexing it need GL_EXT_nonuniform_qualifier for the
+// runtime sized array.
+struct GLTFMaterialData
 {
-
     vec4 colorFactors;
     vec4 metal_rough_factors;
+    uint colorTexture;
+    uint metalRoughTexture;
+    uint pad0;
+    uint pad1;
+};
+
+layout(set = 2, binding = 0, std430) readonly buffer MaterialTable
+{
+    GLTFMaterialData materials[];
 }
-materialData;
+materialTable;
 
-layout(set = 2, binding = 1) uniform sampler2D colorTex;
-layout(set = 2, binding = 2) uniform sampler2D metalRoughTex;
\ No newline at end of file
+layout(set = 2, binding = 1) uniform sampler2D textures[];
\ No newline at end of file
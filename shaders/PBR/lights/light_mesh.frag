@@ -1,12 +1,14 @@
 #version 450
 
 #extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
 #include "light_input_structures.glsl"
 
 layout(location = 0) in vec3 inNormal;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inUV;
 layout(location = 3) in vec4 inPos;
+layout(location = 4) flat in uint inMaterialIndex;
 
 layout(location = 0) out vec4 outFragColor;
 
@@ -90,16 +92,21 @@ void main()
     float G;
     vec3 F;
 
+    GLTFMaterialData material = materialTable.materials[inMaterialIndex];
+    // the slots come from the push constant material index, so they are dynamically uniform across the draw
+    vec4 colorSample = texture(textures[material.colorTexture], inUV);
+    vec4 metalRoughSample = texture(textures[material.metalRoughTexture], inUV);
+
     tempNormal = normalize(inNormal); // world space
     // if (!gl_FrontFacing)
     //     tempNormal = -tempNormal;
     viewVec = (normalize(sceneData.cameraPos - inPos)).xyz;                    // world space.
-    vec3 albedo = pow(texture(colorTex, vec2(inUV.s, inUV.t)).rgb, vec3(2.2)); // conversion from sRGB
+    vec3 albedo = pow(colorSample.rgb, vec3(2.2));                             // conversion from sRGB
     // to linear space
     vec3 normal = tempNormal;
-    vec2 metalRough = texture(metalRoughTex, inUV).bg;
-    float metallic = metalRough.x * materialData.metal_rough_factors.x;
-    float roughness = metalRough.y * materialData.metal_rough_factors.y;
+    vec2 metalRough = metalRoughSample.bg;
+    float metallic = metalRough.x * material.metal_rough_factors.x;
+    float roughness = metalRough.y * material.metal_rough_factors.y;
     float ao = 1;
 
     vec3 F0 = vec3(0.04);
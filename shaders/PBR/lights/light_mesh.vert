@@ -9,33 +9,13 @@ layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec3 outColor;
 layout(location = 2) out vec2 outUV;
 layout(location = 3) out vec4 outPos;
+layout(location = 4) flat out uint outMaterialIndex;
 
-struct Vertex
-{
-
-    vec3 position;
-    float uv_x;
-    vec3 normal;
-    float uv_y;
-    vec4 color;
-};
-
-layout(buffer_reference, std430) readonly buffer VertexBuffer
-{
-    Vertex vertices[];
-};
-
-// push constants block
-layout(push_constant) uniform constants
-{
-    mat4 render_matrix;
-    VertexBuffer vertexBuffer;
-}
-PushConstants;
+#include "../vertex_input.glsl"
 
 void main()
 {
-    Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+    Vertex v = load_vertex(uint(gl_VertexIndex));
 
     vec4 position = vec4(v.position, 1.0f);
 
@@ -44,7 +24,8 @@ void main()
     gl_Position = sceneData.viewproj * outPos;
 
     outNormal = (PushConstants.render_matrix * vec4(v.normal, 0.f)).xyz;
-    outColor = v.color.xyz * materialData.colorFactors.xyz;
+    outColor = v.color.xyz * materialTable.materials[PushConstants.materialIndex].colorFactors.xyz;
     outUV.x = v.uv_x;
     outUV.y = v.uv_y;
+    outMaterialIndex = PushConstants.materialIndex;
 }
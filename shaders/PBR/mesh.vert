@@ -9,32 +9,11 @@ layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec3 outColor;
 layout(location = 2) out vec2 outUV;
 
-struct Vertex
-{
-
-    vec3 position;
-    float uv_x;
-    vec3 normal;
-    float uv_y;
-    vec4 color;
-};
-
-layout(buffer_reference, std430) readonly buffer VertexBuffer
-{
-    Vertex vertices[];
-};
-
-// push constants block
-layout(push_constant) uniform constants
-{
-    mat4 render_matrix;
-    VertexBuffer vertexBuffer;
-}
-PushConstants;
+#include "vertex_input.glsl"
 
 void main()
 {
-    Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+    Vertex v = load_vertex(uint(gl_VertexIndex));
 
     vec4 position = vec4(v.position, 1.0f);
 
@@ -0,0 +1,77 @@
+// vertex pulling for the mesh shaders. meshes are stored either as full float vertices or as packed 20 byte
+// vertices, the push constants say which one and how to dequantize it. needs GL_EXT_buffer_reference.
+
+struct Vertex
+{
+
+    vec3 position;
+    float uv_x;
+    vec3 normal;
+    float uv_y;
+    vec4 color;
+};
+
+// unorm16 position xyz (w unused), octahedral snorm16 normal, unorm16 uv, unorm8 color
+struct PackedVertex
+{
+    uint positionXY;
+    uint positionZ;
+    uint normal;
+    uint uv;
+    uint color;
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer
+{
+    Vertex vertices[];
+};
+
+layout(buffer_reference, std430) readonly buffer PackedVertexBuffer
+{
+    PackedVertex vertices[];
+};
+
+const uint VERTEX_FORMAT_FLOAT = 0;
+const uint VERTEX_FORMAT_PACKED = 1;
+
+// push constants block
+layout(push_constant) uniform constants
+{
+    mat4 render_matrix;
+    VertexBuffer vertexBuffer;
+    uint vertexFormat;
+    uint materialIndex;
+    vec4 positionOffset;
+    vec4 positionScale;
+    vec4 uvOffsetScale;
+}
+PushConstants;
+
+vec3 decode_octahedral(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+Vertex load_vertex(uint index)
+{
+    if (PushConstants.vertexFormat == VERTEX_FORMAT_FLOAT)
+        return PushConstants.vertexBuffer.vertices[index];
+
+    PackedVertex p = PackedVertexBuffer(PushConstants.vertexBuffer).vertices[index];
+
+    vec3 position = vec3(unpackUnorm2x16(p.positionXY), unpackUnorm2x16(p.positionZ).x);
+    vec2 uv = unpackUnorm2x16(p.uv);
+
+    Vertex v;
+    v.position = PushConstants.positionOffset.xyz + position * PushConstants.positionScale.xyz;
+    v.normal = decode_octahedral(unpackSnorm2x16(p.normal));
+    uv = PushConstants.uvOffsetScale.xy + uv * PushConstants.uvOffsetScale.zw;
+    v.uv_x = uv.x;
+    v.uv_y = uv.y;
+    v.color = unpackUnorm4x8(p.color);
+    return v;
+}
@@ -0,0 +1,126 @@
+#include "AsyncSceneLoader.h"
+#include "fmt/base.h"
+#include <chrono>
+
+AsyncSceneLoader::~AsyncSceneLoader()
+{
+    shutdown();
+}
+
+void AsyncSceneLoader::request(std::string name, std::filesystem::path path, GLTFCreatorData creatorData,
+                               SceneReadyCallback onReady)
+{
+    // started on first use, so an engine that never loads anything in the background has no extra thread
+    if (!worker.joinable())
+        worker = std::thread(&AsyncSceneLoader::worker_loop, this);
+
+    Request newRequest{std::move(name), std::move(path), creatorData, std::move(onReady)};
+    while (!requests.push(std::move(newRequest)))
+        std::this_thread::yield();
+
+    pending++;
+    queuedRequests.fetch_add(1, std::memory_order_release);
+    queuedRequests.notify_one();
+}
+
+void AsyncSceneLoader::update(size_t uploadBudget)
+{
+    while (std::optional<Result> result = results.pop())
+    {
+        if (!result->imported)
+        {
+            fmt::println("Failed to load {}", result->request.path.string());
+            pending--;
+            continue;
+        }
+
+        Upload upload;
+        upload.name = std::move(result->request.name);
+        upload.onReady = std::move(result->request.onReady);
+        upload.builder =
+            std::make_unique<GLTFSceneBuilder>(result->request.creatorData, std::move(result->imported));
+        uploads.push_back(std::move(upload));
+    }
+
+    // scenes are uploaded one after the other, the first in line gets the whole budget
+    if (uploads.empty())
+        return;
+
+    Upload &upload = uploads.front();
+    upload.builder->step(uploadBudget);
+
+    // handed out once its nodes exist, the meshes fill in over the next steps
+    if (!upload.handedOut && upload.builder->nodes_built())
+    {
+        std::shared_ptr<sgraph::GLTFScene> scene = upload.builder->scene();
+        scene->name = upload.name;
+        upload.onReady(scene);
+        upload.handedOut = true;
+    }
+
+    if (upload.builder->done())
+    {
+        fmt::println("Finished loading {}", upload.name);
+        uploads.erase(uploads.begin());
+        pending--;
+    }
+}
+
+void AsyncSceneLoader::shutdown()
+{
+    if (worker.joinable())
+    {
+        stopping.store(true, std::memory_order_release);
+        queuedRequests.fetch_add(1, std::memory_order_release);
+        queuedRequests.notify_one();
+        worker.join();
+
+        // the next request starts a new loader thread
+        stopping.store(false, std::memory_order_relaxed);
+        queuedRequests.store(0, std::memory_order_relaxed);
+    }
+
+    // the builders hold the scenes that were not handed out yet, their resources are released here
+    uploads.clear();
+    while (requests.pop())
+        ;
+    while (results.pop())
+        ;
+    pending = 0;
+}
+
+void AsyncSceneLoader::worker_loop()
+{
+    while (true)
+    {
+        queuedRequests.wait(0, std::memory_order_acquire);
+        if (stopping.load(std::memory_order_acquire))
+            return;
+
+        std::optional<Request> next = requests.pop();
+        if (!next.has_value())
+            continue;
+        queuedRequests.fetch_sub(1, std::memory_order_relaxed);
+
+        fmt::println("Loading GLTF in the background: {}", next->path.string());
+        auto importStart = std::chrono::steady_clock::now();
+
+        // only cpu work here, the gpu is left to the render thread
+        Result result;
+        std::optional<ImportedScene> imported = readOrImportGltf(next->path, next->creatorData);
+        if (imported.has_value())
+            result.imported = std::make_shared<const ImportedScene>(std::move(*imported));
+
+        auto importEnd = std::chrono::steady_clock::now();
+        fmt::println("Background import of {} took {} ms", next->path.string(),
+                     std::chrono::duration_cast<std::chrono::milliseconds>(importEnd - importStart).count());
+
+        result.request = std::move(*next);
+        while (!results.push(std::move(result)))
+        {
+            if (stopping.load(std::memory_order_acquire))
+                return;
+            std::this_thread::yield();
+        }
+    }
+}
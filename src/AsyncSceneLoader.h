@@ -0,0 +1,95 @@
+#pragma once
+#include "SpscQueue.h"
+#include "vk_loader.h"
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Loads gltf files in the background. Reading the scene cache or importing the file runs on a loader thread,
+ * the imported scene is handed back to the render thread through a lock-free queue, and update() uploads it a few
+ * bytes per frame. A scene is handed to its callback as soon as its nodes exist, meshes show up once uploaded.
+ *
+ */
+class AsyncSceneLoader
+{
+  public:
+    using SceneReadyCallback = std::function<void(std::shared_ptr<sgraph::GLTFScene>)>;
+
+    AsyncSceneLoader() = default;
+    ~AsyncSceneLoader();
+
+    AsyncSceneLoader(const AsyncSceneLoader &) = delete;
+    AsyncSceneLoader &operator=(const AsyncSceneLoader &) = delete;
+
+    /**
+     * @brief Queue a file for loading. Only call from the render thread.
+     *
+     * @param onReady called from update() once the scene can be drawn, never called when the file fails to load.
+     */
+    void request(std::string name, std::filesystem::path path, GLTFCreatorData creatorData,
+                 SceneReadyCallback onReady);
+
+    /**
+     * @brief Upload up to uploadBudget bytes of the scenes that finished importing, and hand out the ones that became
+     * drawable. Call once per frame from the render thread.
+     *
+     */
+    void update(size_t uploadBudget);
+
+    // true while any requested scene is not fully uploaded
+    bool busy() const
+    {
+        return pending > 0;
+    }
+
+    /**
+     * @brief Stop the loader thread. Scenes that are still importing are dropped, partly uploaded ones keep what
+     * they have. Has to be called before the device is destroyed. Later requests start the loader thread again.
+     *
+     */
+    void shutdown();
+
+  private:
+    struct Request
+    {
+        std::string name;
+        std::filesystem::path path;
+        GLTFCreatorData creatorData;
+        SceneReadyCallback onReady;
+    };
+
+    struct Result
+    {
+        Request request;
+        // empty if the file failed to load
+        std::shared_ptr<const ImportedScene> imported;
+    };
+
+    struct Upload
+    {
+        std::string name;
+        SceneReadyCallback onReady;
+        std::unique_ptr<GLTFSceneBuilder> builder;
+        bool handedOut = false;
+    };
+
+    void worker_loop();
+
+    static constexpr size_t QUEUE_CAPACITY = 16;
+
+    SpscQueue<Request, QUEUE_CAPACITY> requests;
+    SpscQueue<Result, QUEUE_CAPACITY> results;
+    // number of queued requests, the loader thread sleeps on it while it is zero
+    std::atomic<uint32_t> queuedRequests{0};
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+
+    std::vector<Upload> uploads;
+    // requested but not fully uploaded, only touched by the render thread
+    uint32_t pending = 0;
+};
@@ -1,4 +1,7 @@
 #include <GPUResourceAllocator.h>
+#include <TextureProcessing.h>
+#include <algorithm>
+#include <chrono>
 #include <vk_engine.h>
 #include <vk_images.h>
 #include <vk_initializers.h>
@@ -18,6 +21,9 @@ void GPUResourceAllocator::init(VmaAllocator &_allocator, VkDevice _device, Vulk
     this->_allocator = _allocator;
     this->_device = _device;
     this->_engine = _engine;
+
+    geometryPool.init(this, vertexPoolPageSize, indexPoolPageSize);
+    samplerCache.init(_device);
 }
 
 AllocatedBuffer GPUResourceAllocator::create_buffer(size_t allocSize, VkBufferUsageFlags usage,
@@ -44,14 +50,22 @@ AllocatedBuffer GPUResourceAllocator::create_buffer(size_t allocSize, VkBufferUs
 
 AllocatedImage GPUResourceAllocator::create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
                                                   bool mipmapped)
+{
+    uint32_t mipLevels = 1;
+    if (mipmapped)
+        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(size.width, size.height)))) + 1;
+    return allocate_image(size, format, usage, mipLevels);
+}
+
+AllocatedImage GPUResourceAllocator::allocate_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
+                                                    uint32_t mipLevels, VkComponentMapping swizzle)
 {
     AllocatedImage newImage;
     newImage.imageFormat = format;
     newImage.imageExtent = size;
 
     VkImageCreateInfo img_info = vkinit::image_create_info(format, usage, size);
-    if (mipmapped)
-        img_info.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(size.width, size.height)))) + 1;
+    img_info.mipLevels = mipLevels;
 
     // always allocate images on dedicated GPU memory
     VmaAllocationCreateInfo allocinfo = {};
@@ -70,32 +84,37 @@ AllocatedImage GPUResourceAllocator::create_image(VkExtent3D size, VkFormat form
     // build a image-view for the image
     VkImageViewCreateInfo view_info = vkinit::imageview_create_info(format, newImage.image, aspectFlag);
     view_info.subresourceRange.levelCount = img_info.mipLevels;
+    view_info.components = swizzle;
 
     VK_CHECK(vkCreateImageView(_device, &view_info, nullptr, &newImage.imageView));
 
     return newImage;
 }
 
-AllocatedImage GPUResourceAllocator::create_image(void *data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
+AllocatedImage GPUResourceAllocator::create_image(const void *data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
                                                   bool mipmapped)
 {
     size_t data_size = size.depth * size.width * size.height * 4;
-    AllocatedBuffer uploadbuffer =
-        create_buffer(data_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
 
-    memcpy(uploadbuffer.info.pMappedData, data, data_size);
+    // uploads outside of a batch get a batch of their own
+    bool ownsBatch = !uploadBatch.active;
+    if (ownsBatch)
+        begin_upload_batch();
+
+    StagingAllocation staging = stage(data_size);
+    memcpy(staging.mappedData, data, data_size);
 
     AllocatedImage new_image = create_image(
         size, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, mipmapped);
 
-    _engine->immediate_submit(
-        [&](VkCommandBuffer cmd)
+    uploadBatch.copies.push_back(
+        [=](VkCommandBuffer cmd)
         {
             vkutil::transition_image(cmd, new_image.image, VK_IMAGE_LAYOUT_UNDEFINED,
                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
             VkBufferImageCopy copyRegion = {};
-            copyRegion.bufferOffset = 0;
+            copyRegion.bufferOffset = staging.offset;
             copyRegion.bufferRowLength = 0;
             copyRegion.bufferImageHeight = 0;
 
@@ -106,7 +125,7 @@ AllocatedImage GPUResourceAllocator::create_image(void *data, VkExtent3D size, V
             copyRegion.imageExtent = size;
 
             // copy the buffer into the image
-            vkCmdCopyBufferToImage(cmd, uploadbuffer.buffer, new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+            vkCmdCopyBufferToImage(cmd, staging.buffer, new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
                                    &copyRegion);
 
             if (mipmapped)
@@ -120,69 +139,299 @@ AllocatedImage GPUResourceAllocator::create_image(void *data, VkExtent3D size, V
                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
             }
         });
-    destroy_buffer(uploadbuffer);
+    uploadBatch.stats.uploads++;
+
+    if (ownsBatch)
+        submit_upload_batch();
+
     return new_image;
 }
 
-GPUMeshBuffers GPUResourceAllocator::uploadMesh(std::span<uint32_t> indices, std::span<Vertex> vertices)
+AllocatedImage GPUResourceAllocator::create_image(std::span<const uint8_t> levels, VkExtent3D size, VkFormat format,
+                                                  VkImageUsageFlags usage, uint32_t mipLevels,
+                                                  VkComponentMapping swizzle)
 {
-    const size_t vertexBufferSize = vertices.size() * sizeof(Vertex);
+    std::vector<std::span<const uint8_t>> levelSpans;
+    size_t levelOffset = 0;
+    for (uint32_t level = 0; level < mipLevels; level++)
+    {
+        size_t levelSize = texproc::mip_level_size(format, texproc::mip_extent(size, level));
+        levelSpans.push_back(levels.subspan(levelOffset, levelSize));
+        levelOffset += levelSize;
+    }
+    return create_image(levelSpans, size, format, usage, swizzle);
+}
+
+AllocatedImage GPUResourceAllocator::create_image(std::span<const std::span<const uint8_t>> levels, VkExtent3D size,
+                                                  VkFormat format, VkImageUsageFlags usage, VkComponentMapping swizzle)
+{
+    bool ownsBatch = !uploadBatch.active;
+    if (ownsBatch)
+        begin_upload_batch();
+
+    // every level starts 16 byte aligned, copies need offsets that are a multiple of the texel or block size
+    auto aligned = [](size_t bytes) { return (bytes + 15) & ~size_t(15); };
+    size_t stagingSize = 0;
+    for (std::span<const uint8_t> level : levels)
+        stagingSize += aligned(level.size());
+    StagingAllocation staging = stage(stagingSize);
+
+    uint32_t mipLevels = static_cast<uint32_t>(levels.size());
+    AllocatedImage new_image =
+        allocate_image(size, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT, mipLevels, swizzle);
+
+    // one region per level, all in the same copy. compressed levels are tightly packed blocks, and the extent of a
+    // level does not have to be a multiple of the block size
+    std::vector<VkBufferImageCopy> regions;
+    size_t levelOffset = 0;
+    for (uint32_t level = 0; level < mipLevels; level++)
+    {
+        VkExtent3D levelExtent = texproc::mip_extent(size, level);
+        assert(levels[level].size() >= texproc::mip_level_size(format, levelExtent));
+        memcpy(static_cast<char *>(staging.mappedData) + levelOffset, levels[level].data(), levels[level].size());
+
+        VkBufferImageCopy copyRegion = {};
+        copyRegion.bufferOffset = staging.offset + levelOffset;
+        copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copyRegion.imageSubresource.mipLevel = level;
+        copyRegion.imageSubresource.baseArrayLayer = 0;
+        copyRegion.imageSubresource.layerCount = 1;
+        copyRegion.imageExtent = levelExtent;
+        regions.push_back(copyRegion);
+
+        levelOffset += aligned(levels[level].size());
+    }
+
+    uploadBatch.copies.push_back(
+        [=](VkCommandBuffer cmd)
+        {
+            // transition_image covers every mip level
+            vkutil::transition_image(cmd, new_image.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+            vkCmdCopyBufferToImage(cmd, staging.buffer, new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   static_cast<uint32_t>(regions.size()), regions.data());
+            vkutil::transition_image(cmd, new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        });
+    uploadBatch.stats.uploads++;
+
+    if (ownsBatch)
+        submit_upload_batch();
+
+    return new_image;
+}
+
+GPUMeshBuffers GPUResourceAllocator::uploadMesh(std::span<const uint32_t> indices, std::span<const Vertex> vertices)
+{
+    GPUMeshBuffers newSurface = upload_geometry(indices, std::as_bytes(vertices), sizeof(Vertex));
+    newSurface.vertexFormat = VertexFormat::Float;
+    newSurface.quantization = {};
+    return newSurface;
+}
+
+GPUMeshBuffers GPUResourceAllocator::uploadMesh(std::span<const uint32_t> indices,
+                                                std::span<const PackedVertex> vertices,
+                                                const VertexQuantization &quantization)
+{
+    GPUMeshBuffers newSurface = upload_geometry(indices, std::as_bytes(vertices), sizeof(PackedVertex));
+    newSurface.vertexFormat = VertexFormat::Packed;
+    newSurface.quantization = quantization;
+    return newSurface;
+}
+
+GPUMeshBuffers GPUResourceAllocator::upload_geometry(std::span<const uint32_t> indices,
+                                                     std::span<const std::byte> vertexData, size_t vertexStride)
+{
+    const size_t vertexBufferSize = vertexData.size();
     const size_t indexBufferSize = indices.size() * sizeof(uint32_t);
 
     GPUMeshBuffers newSurface;
+    newSurface.allocation = geometryPool.allocate(vertexBufferSize, vertexStride, indexBufferSize, sizeof(uint32_t));
 
-    // create vertex buffer
-    newSurface.vertexBuffer = create_buffer(vertexBufferSize,
-                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                                                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                                            VMA_MEMORY_USAGE_GPU_ONLY);
-
-    // find the adress of the vertex buffer
-    VkBufferDeviceAddressInfo deviceAdressInfo{.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-                                               .buffer = newSurface.vertexBuffer.buffer};
-    newSurface.vertexBufferAddress = vkGetBufferDeviceAddress(_device, &deviceAdressInfo);
+    const GeometryPool::Page &page = geometryPool.page(newSurface.allocation.page);
+    newSurface.indexBuffer = page.indexBuffer.buffer;
+    newSurface.vertexBufferAddress = page.vertexBufferAddress;
+    newSurface.firstIndex = static_cast<uint32_t>(newSurface.allocation.indexOffset / sizeof(uint32_t));
+    newSurface.vertexOffset = static_cast<int32_t>(newSurface.allocation.vertexOffset / vertexStride);
 
-    // create index buffer
-    newSurface.indexBuffer =
-        create_buffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                      VMA_MEMORY_USAGE_GPU_ONLY);
+    if (vertexBufferSize == 0 || indexBufferSize == 0)
+        return newSurface;
 
-    AllocatedBuffer staging =
-        create_buffer(vertexBufferSize + indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+    bool ownsBatch = !uploadBatch.active;
+    if (ownsBatch)
+        begin_upload_batch();
 
-    void *data = staging.allocation->GetMappedData();
+    StagingAllocation staging = stage(vertexBufferSize + indexBufferSize);
 
     // copy vertex buffer
-    memcpy(data, vertices.data(), vertexBufferSize);
+    memcpy(staging.mappedData, vertexData.data(), vertexBufferSize);
     // copy index buffer
-    memcpy((char *)data + vertexBufferSize, indices.data(), indexBufferSize);
+    memcpy((char *)staging.mappedData + vertexBufferSize, indices.data(), indexBufferSize);
 
-    _engine->immediate_submit(
-        [&](VkCommandBuffer cmd)
+    VkBuffer vertexBuffer = page.vertexBuffer.buffer;
+    VkBuffer indexBuffer = page.indexBuffer.buffer;
+    GeometryAllocation allocation = newSurface.allocation;
+    uploadBatch.copies.push_back(
+        [=](VkCommandBuffer cmd)
         {
             VkBufferCopy vertexCopy{0};
-            vertexCopy.dstOffset = 0;
-            vertexCopy.srcOffset = 0;
+            vertexCopy.dstOffset = allocation.vertexOffset;
+            vertexCopy.srcOffset = staging.offset;
             vertexCopy.size = vertexBufferSize;
 
-            vkCmdCopyBuffer(cmd, staging.buffer, newSurface.vertexBuffer.buffer, 1, &vertexCopy);
+            vkCmdCopyBuffer(cmd, staging.buffer, vertexBuffer, 1, &vertexCopy);
 
             VkBufferCopy indexCopy{0};
-            indexCopy.dstOffset = 0;
-            indexCopy.srcOffset = vertexBufferSize;
+            indexCopy.dstOffset = allocation.indexOffset;
+            indexCopy.srcOffset = staging.offset + vertexBufferSize;
             indexCopy.size = indexBufferSize;
 
-            vkCmdCopyBuffer(cmd, staging.buffer, newSurface.indexBuffer.buffer, 1, &indexCopy);
+            vkCmdCopyBuffer(cmd, staging.buffer, indexBuffer, 1, &indexCopy);
         });
+    uploadBatch.stats.uploads++;
 
-    destroy_buffer(staging);
+    if (ownsBatch)
+        submit_upload_batch();
 
     return newSurface;
 }
 
+void GPUResourceAllocator::free_mesh(const GPUMeshBuffers &mesh)
+{
+    geometryPool.free(mesh.allocation);
+}
+
+GeometryPoolStats GPUResourceAllocator::geometry_pool_stats() const
+{
+    return geometryPool.stats();
+}
+
+void GPUResourceAllocator::update_budget(uint32_t frameIndex)
+{
+    // the budgets are cached by VMA and refreshed once per frame index
+    vmaSetCurrentFrameIndex(_allocator, frameIndex);
+
+    const VkPhysicalDeviceMemoryProperties *properties;
+    vmaGetMemoryProperties(_allocator, &properties);
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(_allocator, budgets);
+
+    memoryBudget = {};
+    for (uint32_t heap = 0; heap < properties->memoryHeapCount; heap++)
+    {
+        if (!(properties->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+            continue;
+        memoryBudget.usage += budgets[heap].usage;
+        memoryBudget.budget += budgets[heap].budget;
+    }
+}
+
+void GPUResourceAllocator::begin_upload_batch()
+{
+    assert(!uploadBatch.active);
+    uploadBatch = {};
+    uploadBatch.active = true;
+}
+
+UploadBatchStats GPUResourceAllocator::submit_upload_batch()
+{
+    assert(uploadBatch.active);
+    flush_upload_batch();
+
+    uploadBatch.active = false;
+    if (uploadBatch.stats.uploads > 0)
+        uploadBatch.stats.roundTripTime = round_trip_time();
+    return uploadBatch.stats;
+}
+
+GPUResourceAllocator::StagingAllocation GPUResourceAllocator::stage(size_t size)
+{
+    // keep every copy 16 byte aligned, buffer to image copies need at least the texel size
+    size = (size + 15) & ~size_t(15);
+
+    if (uploadBatch.pendingBytes + size > maxPendingStagingBytes && !uploadBatch.copies.empty())
+        flush_upload_batch();
+
+    if (uploadBatch.chunks.empty() || uploadBatch.chunks.back().capacity - uploadBatch.chunks.back().used < size)
+    {
+        StagingChunk chunk;
+        chunk.capacity = std::max(size, stagingChunkSize);
+        chunk.used = 0;
+        chunk.buffer = create_buffer(chunk.capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+        uploadBatch.chunks.push_back(chunk);
+    }
+
+    StagingChunk &chunk = uploadBatch.chunks.back();
+
+    StagingAllocation allocation;
+    allocation.buffer = chunk.buffer.buffer;
+    allocation.offset = chunk.used;
+    allocation.mappedData = (char *)chunk.buffer.info.pMappedData + chunk.used;
+
+    chunk.used += size;
+    uploadBatch.pendingBytes += size;
+    uploadBatch.stats.stagingBytes += size;
+
+    return allocation;
+}
+
+void GPUResourceAllocator::flush_upload_batch()
+{
+    if (!uploadBatch.copies.empty())
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        _engine->immediate_submit(
+            [&](VkCommandBuffer cmd)
+            {
+                for (auto &copy : uploadBatch.copies)
+                    copy(cmd);
+            });
+
+        auto end = std::chrono::steady_clock::now();
+        uploadBatch.stats.submits++;
+        uploadBatch.stats.submitTime +=
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.f;
+    }
+
+    for (auto &chunk : uploadBatch.chunks)
+        destroy_buffer(chunk.buffer);
+    for (const AllocatedImage &image : uploadBatch.destroyedImages)
+        destroy_image(image);
+
+    uploadBatch.chunks.clear();
+    uploadBatch.copies.clear();
+    uploadBatch.destroyedImages.clear();
+    uploadBatch.pendingBytes = 0;
+}
+
+float GPUResourceAllocator::round_trip_time()
+{
+    if (roundTripTime >= 0.f)
+        return roundTripTime;
+
+    // the fastest of a few, the first submit can pay for driver warm up
+    for (int i = 0; i < 3; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        _engine->immediate_submit([](VkCommandBuffer) {});
+        auto end = std::chrono::steady_clock::now();
+
+        float time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.f;
+        roundTripTime = roundTripTime < 0.f ? time : std::min(roundTripTime, time);
+    }
+    return roundTripTime;
+}
+
 void GPUResourceAllocator::cleanup()
 {
-    // do nothing currently.
+    geometryPool.destroy();
+    samplerCache.destroy();
+}
+
+VkSampler GPUResourceAllocator::get_sampler(const VkSamplerCreateInfo &info)
+{
+    return samplerCache.get(info);
 }
 
 void GPUResourceAllocator::destroy_buffer(const AllocatedBuffer &buffer)
@@ -196,6 +445,15 @@ void GPUResourceAllocator::destroy_image(const AllocatedImage &img)
     vmaDestroyImage(_allocator, img.image, img.allocation);
 }
 
+void GPUResourceAllocator::destroy_image_after_upload(const AllocatedImage &img)
+{
+    // outside a batch every copy has been submitted and waited for already
+    if (uploadBatch.active)
+        uploadBatch.destroyedImages.push_back(img);
+    else
+        destroy_image(img);
+}
+
 VkDevice GPUResourceAllocator::getDevice()
 {
     return _device;
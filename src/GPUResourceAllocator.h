@@ -1,15 +1,58 @@
 #pragma once
+#include "GeometryPool.h"
+#include "SamplerCache.h"
+#include <functional>
 #include <vk_mem_alloc.h>
 #include <vk_types.h>
 
 class VulkanEngine;
 
+// statistics for everything that went through one upload batch
+struct UploadBatchStats
+{
+    uint32_t uploads = 0; // meshes and images recorded into the batch
+    uint32_t submits = 0; // queue submissions it took to flush them
+    size_t stagingBytes = 0;
+    float submitTime = 0; // ms spent submitting and waiting on the gpu
+    // ms of a submit-and-wait with nothing in it, what every upload paid on top of its copies before batching
+    float roundTripTime = 0;
+};
+
+// device local memory of the process, from the VMA heap budgets
+struct MemoryBudget
+{
+    size_t usage = 0;  // bytes allocated in the device local heaps, by us or by the driver for us
+    size_t budget = 0; // bytes we can use before allocations fail or start paging. an estimate of 80% of the heaps
+                       // when the device has no VK_EXT_memory_budget
+};
+
 class GPUResourceAllocator
 {
   public:
     void init(VmaAllocator &_allocator, VkDevice _device, VulkanEngine *_engine);
 
-    GPUMeshBuffers uploadMesh(std::span<uint32_t> indices, std::span<Vertex> vertices);
+    /**
+     * @brief Copy a mesh into the shared geometry pool. Indices stay relative to the first vertex of the mesh, draws
+     * use the vertexOffset and firstIndex of the returned buffers.
+     *
+     */
+    GPUMeshBuffers uploadMesh(std::span<const uint32_t> indices, std::span<const Vertex> vertices);
+    GPUMeshBuffers uploadMesh(std::span<const uint32_t> indices, std::span<const PackedVertex> vertices,
+                              const VertexQuantization &quantization);
+    // give the pool space of a mesh back
+    void free_mesh(const GPUMeshBuffers &mesh);
+
+    GeometryPoolStats geometry_pool_stats() const;
+
+    /**
+     * @brief Query the heap budgets from VMA. Call once per frame, memory_budget returns what the last call saw.
+     *
+     */
+    void update_budget(uint32_t frameIndex);
+    MemoryBudget memory_budget() const
+    {
+        return memoryBudget;
+    }
 
     void create_image(VkImageCreateInfo *pImageCreateInfo, VmaAllocationCreateInfo *pAllocationCreateInfo,
                       VkImage *pImage, VmaAllocation *pAllocation, VmaAllocationInfo *pAllocationInfo);
@@ -17,18 +60,116 @@ class GPUResourceAllocator
     void destroy_image(VkImage image, VmaAllocation allocation);
 
     AllocatedImage create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false);
-    AllocatedImage create_image(void *data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
+    AllocatedImage create_image(const void *data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
                                 bool mipmapped = false);
+    /**
+     * @brief Upload an image whose mip chain was built on the cpu. levels holds mipLevels levels back to back,
+     * they are all copied with one copy command and no blits. Block compressed formats are supported.
+     *
+     */
+    AllocatedImage create_image(std::span<const uint8_t> levels, VkExtent3D size, VkFormat format,
+                                VkImageUsageFlags usage, uint32_t mipLevels, VkComponentMapping swizzle = {});
+    /**
+     * @brief Same as above for levels that are not back to back in memory, one span per level with level 0 first.
+     * Each level is copied into staging on its own, so files holding the levels in another order are uploaded
+     * straight from where they are.
+     *
+     */
+    AllocatedImage create_image(std::span<const std::span<const uint8_t>> levels, VkExtent3D size, VkFormat format,
+                                VkImageUsageFlags usage, VkComponentMapping swizzle = {});
     void destroy_image(const AllocatedImage &img);
+    // destroy an image whose copies may still be recorded in the open upload batch, once the batch is submitted
+    void destroy_image_after_upload(const AllocatedImage &img);
 
     AllocatedBuffer create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
     void destroy_buffer(const AllocatedBuffer &buffer);
 
+    /**
+     * @brief Get the shared sampler for a create info, see SamplerCache. The sampler is owned by the allocator and must
+     * not be destroyed by the caller.
+     *
+     */
+    VkSampler get_sampler(const VkSamplerCreateInfo &info);
+    uint32_t sampler_count() const
+    {
+        return samplerCache.size();
+    }
+
+    /**
+     * @brief Start recording uploads into a batch. Until submit_upload_batch is called, uploadMesh and
+     * create_image(data, ...) only copy into staging memory and record their copies, the returned resources are
+     * not filled in until the batch is submitted.
+     *
+     */
+    void begin_upload_batch();
+
+    /**
+     * @brief Submit every copy recorded since begin_upload_batch with a single immediate submit and wait for it.
+     *
+     * @return UploadBatchStats statistics for the whole batch.
+     */
+    UploadBatchStats submit_upload_batch();
+
     void cleanup();
 
     VkDevice getDevice();
 
   private:
+    AllocatedImage allocate_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, uint32_t mipLevels,
+                                  VkComponentMapping swizzle = {});
+
+    struct StagingChunk
+    {
+        AllocatedBuffer buffer;
+        size_t capacity;
+        size_t used;
+    };
+
+    struct StagingAllocation
+    {
+        VkBuffer buffer;
+        size_t offset;
+        void *mappedData;
+    };
+
+    struct UploadBatch
+    {
+        bool active = false;
+        std::vector<StagingChunk> chunks;
+        std::vector<std::function<void(VkCommandBuffer cmd)>> copies;
+        // images that were dropped before their copies ran
+        std::vector<AllocatedImage> destroyedImages;
+        size_t pendingBytes = 0;
+        UploadBatchStats stats;
+    };
+
+    // copy indices and vertices of any layout into the geometry pool
+    GPUMeshBuffers upload_geometry(std::span<const uint32_t> indices, std::span<const std::byte> vertexData,
+                                   size_t vertexStride);
+
+    // reserve space in the staging memory of the current batch
+    StagingAllocation stage(size_t size);
+    // submit the copies recorded so far and release their staging memory, the batch stays open
+    void flush_upload_batch();
+    // fastest of a few empty immediate submits, measured once
+    float round_trip_time();
+
+    // staging chunks are allocated at this size, bigger uploads get a chunk of their own
+    static constexpr size_t stagingChunkSize = 64 * 1024 * 1024;
+    // flush early once this much is staged so big files dont keep all of it in host memory at once
+    static constexpr size_t maxPendingStagingBytes = 512 * 1024 * 1024;
+
+    UploadBatch uploadBatch;
+
+    // default page sizes of the geometry pool, bigger meshes get a page of their own
+    static constexpr VkDeviceSize vertexPoolPageSize = 256 * 1024 * 1024;
+    static constexpr VkDeviceSize indexPoolPageSize = 64 * 1024 * 1024;
+
+    GeometryPool geometryPool;
+    SamplerCache samplerCache;
+    MemoryBudget memoryBudget;
+    float roundTripTime = -1.f;
+
     VmaAllocator _allocator;
     VkDevice _device;
     VulkanEngine *_engine;
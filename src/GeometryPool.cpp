@@ -0,0 +1,191 @@
+#include "GeometryPool.h"
+#include "GPUResourceAllocator.h"
+#include <algorithm>
+
+RangeAllocator::RangeAllocator(VkDeviceSize capacity) : totalSize(capacity)
+{
+    if (capacity > 0)
+        freeRanges[0] = capacity;
+}
+
+std::optional<VkDeviceSize> RangeAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    alignment = std::max<VkDeviceSize>(alignment, 1);
+    if (size == 0)
+        return 0;
+
+    // best fit, the range that leaves the least space behind
+    auto best = freeRanges.end();
+    VkDeviceSize bestOffset = 0;
+    VkDeviceSize bestWaste = ~VkDeviceSize(0);
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); it++)
+    {
+        VkDeviceSize aligned = (it->first + alignment - 1) / alignment * alignment;
+        VkDeviceSize end = it->first + it->second;
+        if (aligned + size > end)
+            continue;
+
+        VkDeviceSize waste = it->second - size;
+        if (waste < bestWaste)
+        {
+            best = it;
+            bestOffset = aligned;
+            bestWaste = waste;
+            if (waste == 0)
+                break;
+        }
+    }
+
+    if (best == freeRanges.end())
+        return {};
+
+    VkDeviceSize rangeOffset = best->first;
+    VkDeviceSize rangeEnd = best->first + best->second;
+    freeRanges.erase(best);
+
+    // give back whatever is left on either side of the allocation
+    if (bestOffset > rangeOffset)
+        freeRanges[rangeOffset] = bestOffset - rangeOffset;
+    if (bestOffset + size < rangeEnd)
+        freeRanges[bestOffset + size] = rangeEnd - (bestOffset + size);
+
+    usedSize += size;
+    return bestOffset;
+}
+
+void RangeAllocator::free(VkDeviceSize offset, VkDeviceSize size)
+{
+    if (size == 0)
+        return;
+
+    usedSize -= size;
+
+    auto next = freeRanges.lower_bound(offset);
+
+    // merge with the range right after
+    if (next != freeRanges.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = freeRanges.erase(next);
+    }
+
+    // and with the range right before
+    if (next != freeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            prev->second += size;
+            return;
+        }
+    }
+
+    freeRanges[offset] = size;
+}
+
+void GeometryPool::init(GPUResourceAllocator *allocator, VkDeviceSize vertexPageSize, VkDeviceSize indexPageSize)
+{
+    this->allocator = allocator;
+    this->vertexPageSize = vertexPageSize;
+    this->indexPageSize = indexPageSize;
+}
+
+GeometryAllocation GeometryPool::allocate(VkDeviceSize vertexBytes, VkDeviceSize vertexStride, VkDeviceSize indexBytes,
+                                          VkDeviceSize indexStride)
+{
+    auto tryPage = [&](uint32_t pageIndex) -> std::optional<GeometryAllocation>
+    {
+        Page &page = pages[pageIndex];
+        std::optional<VkDeviceSize> vertexOffset = page.vertexRanges.allocate(vertexBytes, vertexStride);
+        if (!vertexOffset.has_value())
+            return {};
+
+        std::optional<VkDeviceSize> indexOffset = page.indexRanges.allocate(indexBytes, indexStride);
+        if (!indexOffset.has_value())
+        {
+            page.vertexRanges.free(*vertexOffset, vertexBytes);
+            return {};
+        }
+
+        return GeometryAllocation{pageIndex, *vertexOffset, vertexBytes, *indexOffset, indexBytes};
+    };
+
+    for (uint32_t i = 0; i < pages.size(); i++)
+    {
+        if (auto allocation = tryPage(i))
+        {
+            liveAllocations++;
+            return *allocation;
+        }
+    }
+
+    // the existing pages are full, meshes bigger than a page get a page of their own size
+    create_page(std::max(vertexPageSize, vertexBytes + vertexStride),
+                std::max(indexPageSize, indexBytes + indexStride));
+
+    std::optional<GeometryAllocation> allocation = tryPage(static_cast<uint32_t>(pages.size() - 1));
+    assert(allocation.has_value());
+    liveAllocations++;
+    return *allocation;
+}
+
+void GeometryPool::free(const GeometryAllocation &allocation)
+{
+    if (allocation.page >= pages.size())
+        return;
+
+    Page &page = pages[allocation.page];
+    page.vertexRanges.free(allocation.vertexOffset, allocation.vertexSize);
+    page.indexRanges.free(allocation.indexOffset, allocation.indexSize);
+    liveAllocations--;
+}
+
+GeometryPoolStats GeometryPool::stats() const
+{
+    GeometryPoolStats stats{};
+    stats.pages = static_cast<uint32_t>(pages.size());
+    stats.allocations = liveAllocations;
+    for (const Page &page : pages)
+    {
+        stats.vertexBytesUsed += page.vertexRanges.used();
+        stats.vertexBytesCapacity += page.vertexRanges.capacity();
+        stats.indexBytesUsed += page.indexRanges.used();
+        stats.indexBytesCapacity += page.indexRanges.capacity();
+    }
+    return stats;
+}
+
+void GeometryPool::destroy()
+{
+    for (Page &page : pages)
+    {
+        allocator->destroy_buffer(page.vertexBuffer);
+        allocator->destroy_buffer(page.indexBuffer);
+    }
+    pages.clear();
+    liveAllocations = 0;
+}
+
+GeometryPool::Page &GeometryPool::create_page(VkDeviceSize vertexSize, VkDeviceSize indexSize)
+{
+    Page page;
+
+    page.vertexBuffer = allocator->create_buffer(vertexSize,
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                                     VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                 VMA_MEMORY_USAGE_GPU_ONLY);
+
+    // vertices are pulled in the shader through the buffer address
+    VkBufferDeviceAddressInfo deviceAdressInfo{.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                                               .buffer = page.vertexBuffer.buffer};
+    page.vertexBufferAddress = vkGetBufferDeviceAddress(allocator->getDevice(), &deviceAdressInfo);
+
+    page.indexBuffer = allocator->create_buffer(
+        indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+    page.vertexRanges = RangeAllocator(vertexSize);
+    page.indexRanges = RangeAllocator(indexSize);
+
+    pages.push_back(std::move(page));
+    return pages.back();
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <map>
+#include <optional>
+#include <vector>
+#include <vk_types.h>
+
+class GPUResourceAllocator;
+
+/**
+ * @brief Free-list allocator for byte ranges inside a fixed size block. Neighbouring free ranges are merged when
+ * released, allocations are placed best fit.
+ *
+ */
+class RangeAllocator
+{
+  public:
+    RangeAllocator() = default;
+    explicit RangeAllocator(VkDeviceSize capacity);
+
+    /**
+     * @brief Reserve size bytes, the returned offset is a multiple of alignment. The alignment does not need to be a
+     * power of two, so a vertex stride can be used directly.
+     *
+     * @return std::optional<VkDeviceSize> offset of the range, or empty if no free range is big enough.
+     */
+    std::optional<VkDeviceSize> allocate(VkDeviceSize size, VkDeviceSize alignment);
+    void free(VkDeviceSize offset, VkDeviceSize size);
+
+    VkDeviceSize capacity() const
+    {
+        return totalSize;
+    }
+    VkDeviceSize used() const
+    {
+        return usedSize;
+    }
+
+  private:
+    // offset -> size of every free range
+    std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+    VkDeviceSize totalSize = 0;
+    VkDeviceSize usedSize = 0;
+};
+
+struct GeometryPoolStats
+{
+    uint32_t pages;
+    uint32_t allocations;
+    VkDeviceSize vertexBytesUsed;
+    VkDeviceSize vertexBytesCapacity;
+    VkDeviceSize indexBytesUsed;
+    VkDeviceSize indexBytesCapacity;
+};
+
+/**
+ * @brief Shared vertex and index storage for every mesh. Meshes are sub allocated from one large vertex buffer and
+ * one large index buffer, so a whole scene draws with a single index buffer bind. A new page (another pair of
+ * buffers) is only created when the current ones are full.
+ *
+ */
+class GeometryPool
+{
+  public:
+    struct Page
+    {
+        AllocatedBuffer vertexBuffer;
+        AllocatedBuffer indexBuffer;
+        VkDeviceAddress vertexBufferAddress;
+        RangeAllocator vertexRanges;
+        RangeAllocator indexRanges;
+    };
+
+    void init(GPUResourceAllocator *allocator, VkDeviceSize vertexPageSize, VkDeviceSize indexPageSize);
+
+    /**
+     * @brief Reserve space for a mesh. Vertices are aligned to their stride so they can be addressed with the
+     * vertexOffset of an indexed draw, indices to their size.
+     *
+     */
+    GeometryAllocation allocate(VkDeviceSize vertexBytes, VkDeviceSize vertexStride, VkDeviceSize indexBytes,
+                                VkDeviceSize indexStride);
+    void free(const GeometryAllocation &allocation);
+
+    const Page &page(uint32_t index) const
+    {
+        return pages[index];
+    }
+
+    GeometryPoolStats stats() const;
+
+    // destroys every page, all allocations are invalid afterwards
+    void destroy();
+
+  private:
+    Page &create_page(VkDeviceSize vertexSize, VkDeviceSize indexSize);
+
+    GPUResourceAllocator *allocator = nullptr;
+    VkDeviceSize vertexPageSize = 0;
+    VkDeviceSize indexPageSize = 0;
+    uint32_t liveAllocations = 0;
+    std::vector<Page> pages;
+};
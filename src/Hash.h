@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// small non-cryptographic hashing helpers, used for cache keys and content hashes.
+
+inline uint64_t hash_mix(uint64_t h)
+{
+    // murmur3 finalizer
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+inline uint64_t hash_combine(uint64_t seed, uint64_t value)
+{
+    return hash_mix(seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)));
+}
+
+// hashes 8 bytes at a time, fast enough to run over whole asset files.
+inline uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = 0)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    uint64_t h = hash_mix(seed ^ (size * 0x9e3779b97f4a7c15ull));
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        h = (h ^ hash_mix(word)) * 0x9e3779b97f4a7c15ull;
+        h = (h << 31) | (h >> 33);
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    h ^= hash_mix(tail ^ (size - i));
+
+    return hash_mix(h);
+}
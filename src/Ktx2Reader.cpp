@@ -0,0 +1,118 @@
+#include "Ktx2Reader.h"
+#include "TextureProcessing.h"
+#include "fmt/base.h"
+#include <cstring>
+
+namespace
+{
+    constexpr uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    enum SupercompressionScheme : uint32_t
+    {
+        SUPERCOMPRESSION_NONE = 0,
+        SUPERCOMPRESSION_BASISLZ = 1,
+        SUPERCOMPRESSION_ZSTD = 2,
+        SUPERCOMPRESSION_ZLIB = 3,
+    };
+
+    // file layout, all little endian
+    struct Header
+    {
+        uint8_t identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+    static_assert(sizeof(Header) == 80);
+
+    struct LevelIndex
+    {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+} // namespace
+
+bool ktx2::is_ktx2(std::span<const std::byte> bytes)
+{
+    return bytes.size() >= sizeof(KTX2_IDENTIFIER) &&
+           memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+std::optional<ktx2::Texture> ktx2::parse(std::span<const std::byte> bytes)
+{
+    if (!is_ktx2(bytes) || bytes.size() < sizeof(Header))
+    {
+        fmt::println("KTX2: not a KTX2 file");
+        return {};
+    }
+
+    Header header;
+    memcpy(&header, bytes.data(), sizeof(header));
+
+    VkFormat format = static_cast<VkFormat>(header.vkFormat);
+    if (header.supercompressionScheme != SUPERCOMPRESSION_NONE || format == VK_FORMAT_UNDEFINED)
+    {
+        // basis universal payloads have no vulkan format until they are transcoded
+        fmt::println("KTX2: supercompression scheme {} is not supported", header.supercompressionScheme);
+        return {};
+    }
+    if (!texproc::is_supported_format(format))
+    {
+        fmt::println("KTX2: vkFormat {} is not supported", header.vkFormat);
+        return {};
+    }
+    if (header.layerCount > 1 || header.faceCount != 1 || header.pixelDepth > 1 || header.pixelWidth == 0 ||
+        header.pixelHeight == 0)
+    {
+        fmt::println("KTX2: only 2D textures are supported");
+        return {};
+    }
+
+    Texture texture;
+    texture.format = format;
+    texture.extent = {header.pixelWidth, header.pixelHeight, 1};
+
+    // a level count of 0 asks the loader to generate mips, we just take the base level
+    uint32_t levelCount = std::max(header.levelCount, 1u);
+    if (levelCount > texproc::mip_level_count(texture.extent))
+    {
+        fmt::println("KTX2: {} levels is more than a {}x{} texture has", levelCount, texture.extent.width,
+                     texture.extent.height);
+        return {};
+    }
+    if (sizeof(Header) + levelCount * sizeof(LevelIndex) > bytes.size())
+    {
+        fmt::println("KTX2: truncated level index");
+        return {};
+    }
+
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        LevelIndex index;
+        memcpy(&index, bytes.data() + sizeof(Header) + level * sizeof(LevelIndex), sizeof(index));
+
+        size_t expected = texproc::mip_level_size(format, texproc::mip_extent(texture.extent, level));
+        if (index.byteOffset > bytes.size() || index.byteLength > bytes.size() - index.byteOffset ||
+            index.byteLength != expected)
+        {
+            fmt::println("KTX2: level {} is out of bounds or has an unexpected size", level);
+            return {};
+        }
+        texture.levels.push_back(bytes.subspan(index.byteOffset, index.byteLength));
+    }
+    return texture;
+}
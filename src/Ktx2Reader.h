@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+#include <vk_types.h>
+
+/**
+ * @brief Reader for KTX2 texture containers. Only textures stored in a vulkan format the engine can upload as is are
+ * accepted: no basis universal or zstd supercompression, no arrays or cubemaps.
+ *
+ */
+namespace ktx2
+{
+    struct Texture
+    {
+        VkFormat format;
+        VkExtent3D extent;
+        // level 0 first, views into the bytes handed to parse
+        std::vector<std::span<const std::byte>> levels;
+    };
+
+    // checks the file identifier
+    bool is_ktx2(std::span<const std::byte> bytes);
+
+    /**
+     * @brief Read the header and level index of a KTX2 file.
+     *
+     * @return std::optional<Texture> empty if the file is malformed or stored in a way that would need transcoding.
+     */
+    std::optional<Texture> parse(std::span<const std::byte> bytes);
+} // namespace ktx2
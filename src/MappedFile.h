@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <span>
+
+/**
+ * @brief Read only memory mapping of a whole file. The mapping lives as long as the object, so hand out a shared_ptr
+ * to anything that keeps views into it.
+ *
+ */
+class MappedFile
+{
+  public:
+    /**
+     * @brief Map the file at path.
+     *
+     * @return std::shared_ptr<MappedFile> the mapping, or nullptr if the file could not be opened or mapped.
+     */
+    static std::shared_ptr<MappedFile> open(const std::filesystem::path &path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    std::span<const std::byte> bytes() const
+    {
+        return {static_cast<const std::byte *>(data), size};
+    }
+
+  private:
+    MappedFile() = default;
+
+    void *data = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
@@ -1,39 +1,220 @@
 #include "MaterialSystem.h"
+#include "GPUResourceAllocator.h"
 
-void GLTFMRMaterialSystem::build_descriptors(VkDevice device)
+void GLTFMRMaterialSystem::build_descriptors(VkDevice device, GPUResourceAllocator *allocator, uint32_t maxMaterials,
+                                             uint32_t maxTextures)
 {
+    this->allocator = allocator;
+    this->maxMaterials = maxMaterials;
+    this->maxTextures = maxTextures;
 
     DescriptorLayoutBuilder layoutBuilder;
-    layoutBuilder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);         // material data.
-    layoutBuilder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER); // color texture.
-    layoutBuilder.add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER); // metallic-roughness texture.
+    layoutBuilder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);                      // material table.
+    layoutBuilder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextures); // every material texture.
 
-    materialLayout = layoutBuilder.build(device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+    // slots are written while the set is bound, and only the ones in use have to be valid
+    VkDescriptorBindingFlags bindingFlags[2] = {
+        0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+               VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT};
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+    flagsInfo.bindingCount = 2;
+    flagsInfo.pBindingFlags = bindingFlags;
+
+    materialLayout = layoutBuilder.build(device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, &flagsInfo,
+                                         VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+
+    VkDescriptorPoolSize poolSizes[2] = {
+        {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1},
+        {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = maxTextures},
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool));
+
+    VkDescriptorSetAllocateInfo allocInfo = {.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &materialLayout;
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &materialSet));
+
+    // the table stays mapped, entries are written in place
+    materialTable = allocator->create_buffer(sizeof(MaterialConstants) * maxMaterials,
+                                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+    writer.clear();
+    writer.write_buffer(0, materialTable.buffer, sizeof(MaterialConstants) * maxMaterials, 0,
+                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    writer.update_set(device, materialSet);
 }
 
 MaterialInstance GLTFMRMaterialSystem::write_material(VkDevice device, MaterialPass pass,
-                                                      const MaterialResources &resources,
-                                                      DescriptorAllocatorGrowable &descriptorAllocator)
+                                                      const MaterialResources &resources)
 {
     MaterialInstance matData;
     matData.passType = pass;
 
-    matData.materialSet = descriptorAllocator.allocate(device, materialLayout);
+    if (!freeMaterials.empty())
+    {
+        matData.materialIndex = freeMaterials.back();
+        freeMaterials.pop_back();
+    }
+    else if (nextMaterial < maxMaterials)
+    {
+        matData.materialIndex = nextMaterial++;
+        materialTextures.resize(nextMaterial);
+    }
+    else
+    {
+        // the material shares the first entry instead, like textures share the first slot. the entry is freed with
+        // its last reference
+        fmt::println("Material table is full ({} materials)", maxMaterials);
+        matData.materialIndex = 0;
+        fallbackReferences++;
+        return matData;
+    }
+    liveMaterials++;
+
+    uint32_t colorSlot = acquire_texture(device, resources.colorImage, resources.colorSampler);
+    uint32_t metalRoughSlot = acquire_texture(device, resources.metalRoughImage, resources.metalRoughSampler);
+    materialTextures[matData.materialIndex] = {colorSlot, metalRoughSlot};
+    write_entry(matData.materialIndex, resources, colorSlot, metalRoughSlot);
+
+    return matData;
+}
+
+void GLTFMRMaterialSystem::update_material(VkDevice device, const MaterialInstance &material,
+                                           const MaterialResources &resources)
+{
+    // take the new slots before letting go of the old ones, a texture shared by both stays in its slot
+    uint32_t colorSlot = acquire_texture(device, resources.colorImage, resources.colorSampler);
+    uint32_t metalRoughSlot = acquire_texture(device, resources.metalRoughImage, resources.metalRoughSampler);
+    write_entry(material.materialIndex, resources, colorSlot, metalRoughSlot);
+
+    std::array<uint32_t, 2> &slots = materialTextures[material.materialIndex];
+    release_texture(slots[0]);
+    release_texture(slots[1]);
+    slots = {colorSlot, metalRoughSlot};
+}
+
+void GLTFMRMaterialSystem::free_material(const MaterialInstance &material)
+{
+    if (material.materialIndex == 0 && fallbackReferences > 0)
+    {
+        fallbackReferences--;
+        return;
+    }
+
+    std::array<uint32_t, 2> &slots = materialTextures[material.materialIndex];
+    release_texture(slots[0]);
+    release_texture(slots[1]);
+    retiredMaterials.push_back({material.materialIndex, currentFrame});
+    liveMaterials--;
+}
 
+void GLTFMRMaterialSystem::begin_frame(uint64_t frame)
+{
+    currentFrame = frame;
+
+    auto reclaim = [frame](std::vector<std::pair<uint32_t, uint64_t>> &retired, std::vector<uint32_t> &free)
+    {
+        std::erase_if(retired,
+                      [&](const std::pair<uint32_t, uint64_t> &entry)
+                      {
+                          if (entry.second + FRAME_OVERLAP > frame)
+                              return false;
+                          free.push_back(entry.first);
+                          return true;
+                      });
+    };
+    reclaim(retiredMaterials, freeMaterials);
+    reclaim(retiredTextures, freeTextures);
+}
+
+uint32_t GLTFMRMaterialSystem::acquire_texture(VkDevice device, const AllocatedImage &image, VkSampler sampler)
+{
+    std::pair<VkImageView, VkSampler> key = {image.imageView, sampler};
+    auto it = textureSlots.find(key);
+    if (it != textureSlots.end())
+    {
+        it->second.references++;
+        return it->second.slot;
+    }
+
+    uint32_t slot;
+    if (!freeTextures.empty())
+    {
+        slot = freeTextures.back();
+        freeTextures.pop_back();
+    }
+    else if (nextTexture < maxTextures)
+    {
+        slot = nextTexture++;
+        slotKeys.resize(nextTexture);
+    }
+    else
+    {
+        // draws share the first slot instead, better than failing the whole load
+        fmt::println("Out of bindless texture slots ({} textures)", maxTextures);
+        auto first = textureSlots.find(slotKeys[0]);
+        if (first != textureSlots.end() && first->second.slot == 0)
+            first->second.references++;
+        return 0;
+    }
+
+    // nothing in flight reads a fresh or reclaimed slot, so it can be written while the set is bound
     writer.clear();
-    writer.write_buffer(0, resources.dataBuffer, sizeof(MaterialConstants), resources.dataBufferOffset,
-                        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-    writer.write_image(1, resources.colorImage.imageView, resources.colorSampler,
-                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-    writer.write_image(2, resources.metalRoughImage.imageView, resources.metalRoughSampler,
-                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    writer.write_image(1, image.imageView, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                       VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, slot);
+    writer.update_set(device, materialSet);
 
-    writer.update_set(device, matData.materialSet);
+    textureSlots[key] = TextureSlot{slot, 1};
+    slotKeys[slot] = key;
+    return slot;
+}
 
-    return matData;
+void GLTFMRMaterialSystem::release_texture(uint32_t slot)
+{
+    auto it = textureSlots.find(slotKeys[slot]);
+    if (it == textureSlots.end() || it->second.slot != slot)
+        return;
+
+    if (--it->second.references == 0)
+    {
+        textureSlots.erase(it);
+        retiredTextures.push_back({slot, currentFrame});
+    }
+}
+
+void GLTFMRMaterialSystem::write_entry(uint32_t index, const MaterialResources &resources, uint32_t colorSlot,
+                                       uint32_t metalRoughSlot)
+{
+    MaterialConstants entry{};
+    entry.colorFactors = resources.colorFactors;
+    entry.metal_rough_factors = resources.metalRoughFactors;
+    entry.colorTexture = colorSlot;
+    entry.metalRoughTexture = metalRoughSlot;
+
+    MaterialConstants *table = static_cast<MaterialConstants *>(materialTable.info.pMappedData);
+    table[index] = entry;
 }
 
 void GLTFMRMaterialSystem::clear_resources(VkDevice device)
 {
+    if (allocator != nullptr)
+        allocator->destroy_buffer(materialTable);
+    vkDestroyDescriptorPool(device, pool, nullptr);
     vkDestroyDescriptorSetLayout(device, materialLayout, nullptr);
-}
\ No newline at end of file
+
+    textureSlots.clear();
+    slotKeys.clear();
+    freeTextures.clear();
+    retiredTextures.clear();
+    freeMaterials.clear();
+    retiredMaterials.clear();
+    materialTextures.clear();
+    nextTexture = nextMaterial = liveMaterials = 0;
+}
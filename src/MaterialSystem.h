@@ -2,6 +2,7 @@
 #include "vk_descriptors.h"
 #include "vk_engine.h"
 #include "vk_types.h"
+#include <map>
 
 struct GLTFMRMaterialSystemCreateInfo
 {
@@ -12,18 +13,30 @@ struct GLTFMRMaterialSystemCreateInfo
     VkDescriptorSetLayout _gpuSceneDataDescriptorLayout;
 };
 
-// GLTF Metalllic-Roughness material system.
+/**
+ * @brief GLTF Metalllic-Roughness material system, bindless. Every material is an entry of one table in a storage
+ * buffer and its textures are slots of one sampler array, both in a single descriptor set that stays bound for the
+ * whole pass. Draws select their material with the materialIndex push constant.
+ *
+ * Materials using the same image and sampler share a texture slot. Released table entries and slots are only reused
+ * FRAME_OVERLAP frames later, since the frames in flight may still read them.
+ *
+ */
 struct GLTFMRMaterialSystem
 {
     VkDescriptorSetLayout materialLayout;
+    VkDescriptorSet materialSet;
 
+    // one entry of the material table, matches MaterialData in the shaders (std430)
     struct MaterialConstants
     {
         glm::vec4 colorFactors;
         glm::vec4 metal_rough_factors;
-        // padding, we need it anyway for uniform buffers
-        glm::vec4 extra[14];
+        uint32_t colorTexture; // slots in the texture array
+        uint32_t metalRoughTexture;
+        uint32_t pad[2];
     };
+    static_assert(sizeof(MaterialConstants) == 48);
 
     struct MaterialResources
     {
@@ -31,15 +44,72 @@ struct GLTFMRMaterialSystem
         VkSampler colorSampler;
         AllocatedImage metalRoughImage;
         VkSampler metalRoughSampler;
-        VkBuffer dataBuffer;
-        uint32_t dataBufferOffset;
+        glm::vec4 colorFactors{1.f};
+        glm::vec4 metalRoughFactors{1.f, 0.5f, 0.f, 0.f};
     };
 
-    DescriptorWriter writer;
-
-    void build_descriptors(VkDevice device);
+    void build_descriptors(VkDevice device, GPUResourceAllocator *allocator, uint32_t maxMaterials = 16384,
+                           uint32_t maxTextures = 4096);
     void clear_resources(VkDevice device);
 
-    MaterialInstance write_material(VkDevice device, MaterialPass pass, const MaterialResources &resources,
-                                    DescriptorAllocatorGrowable &descriptorAllocator);
-};
\ No newline at end of file
+    // once the table is full the material gets the first entry instead, written by whoever took it first
+    MaterialInstance write_material(VkDevice device, MaterialPass pass, const MaterialResources &resources);
+    // point a material to other textures or factors. the frames in flight keep seeing the old textures or the new
+    // ones, both stay valid until they are done
+    void update_material(VkDevice device, const MaterialInstance &material, const MaterialResources &resources);
+    void free_material(const MaterialInstance &material);
+
+    /**
+     * @brief Reuse the table entries and texture slots that no frame in flight can read anymore. Call once per frame
+     * on the render thread.
+     *
+     */
+    void begin_frame(uint64_t frame);
+
+    uint32_t material_count() const
+    {
+        return liveMaterials;
+    }
+    uint32_t texture_count() const
+    {
+        return static_cast<uint32_t>(textureSlots.size());
+    }
+
+  private:
+    struct TextureSlot
+    {
+        uint32_t slot;
+        uint32_t references;
+    };
+
+    uint32_t acquire_texture(VkDevice device, const AllocatedImage &image, VkSampler sampler);
+    void release_texture(uint32_t slot);
+    void write_entry(uint32_t index, const MaterialResources &resources, uint32_t colorSlot, uint32_t metalRoughSlot);
+
+    GPUResourceAllocator *allocator = nullptr;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    AllocatedBuffer materialTable{};
+    uint32_t maxMaterials = 0;
+    uint32_t maxTextures = 0;
+    uint64_t currentFrame = 0;
+
+    // table entries: never used ones start at nextMaterial, released ones wait in retiredMaterials until no frame
+    // can read them
+    uint32_t nextMaterial = 0;
+    uint32_t liveMaterials = 0;
+    std::vector<uint32_t> freeMaterials;
+    std::vector<std::pair<uint32_t, uint64_t>> retiredMaterials;
+    // materials sharing entry 0 because the table was full
+    uint32_t fallbackReferences = 0;
+    // texture slots of every live entry, color then metal-rough
+    std::vector<std::array<uint32_t, 2>> materialTextures;
+
+    // same for the texture slots, which are shared by image view and sampler
+    uint32_t nextTexture = 0;
+    std::vector<uint32_t> freeTextures;
+    std::vector<std::pair<uint32_t, uint64_t>> retiredTextures;
+    std::map<std::pair<VkImageView, VkSampler>, TextureSlot> textureSlots;
+    std::vector<std::pair<VkImageView, VkSampler>> slotKeys;
+
+    DescriptorWriter writer;
+};
@@ -0,0 +1,1190 @@
+#include "MeshProcessing.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+void meshproc::MeshOptimizationStats::add(const MeshOptimizationStats &other)
+{
+    // acmr is averaged over triangles
+    size_t totalTriangles = triangles + other.triangles;
+    if (totalTriangles > 0)
+    {
+        acmrBefore = (acmrBefore * triangles + other.acmrBefore * other.triangles) / totalTriangles;
+        acmrAfter = (acmrAfter * triangles + other.acmrAfter * other.triangles) / totalTriangles;
+    }
+
+    meshes += other.meshes;
+    triangles = totalTriangles;
+    verticesBefore += other.verticesBefore;
+    verticesAfter += other.verticesAfter;
+}
+
+float meshproc::analyze_acmr(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize)
+{
+    if (indices.size() < 3)
+        return 0;
+
+    // a vertex is in the fifo while fewer than cacheSize misses happened since it was last loaded
+    std::vector<uint32_t> loadedAt(vertexCount, 0);
+    uint32_t misses = 0;
+    uint32_t timestamp = cacheSize + 1;
+
+    for (uint32_t index : indices)
+    {
+        if (timestamp - loadedAt[index] > cacheSize)
+        {
+            loadedAt[index] = timestamp++;
+            misses++;
+        }
+    }
+
+    return float(misses) / float(indices.size() / 3);
+}
+
+void meshproc::weld_vertices(std::vector<Vertex> &vertices, std::span<uint32_t> indices)
+{
+    struct VertexHash
+    {
+        const Vertex *vertices;
+        size_t operator()(uint32_t i) const
+        {
+            return hash_bytes(&vertices[i], sizeof(Vertex));
+        }
+    };
+    struct VertexEqual
+    {
+        const Vertex *vertices;
+        bool operator()(uint32_t a, uint32_t b) const
+        {
+            return memcmp(&vertices[a], &vertices[b], sizeof(Vertex)) == 0;
+        }
+    };
+
+    std::unordered_map<uint32_t, uint32_t, VertexHash, VertexEqual> unique(
+        vertices.size(), VertexHash{vertices.data()}, VertexEqual{vertices.data()});
+
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+
+    for (uint32_t i = 0; i < vertices.size(); i++)
+    {
+        auto [it, inserted] = unique.try_emplace(i, static_cast<uint32_t>(welded.size()));
+        if (inserted)
+            welded.push_back(vertices[i]);
+        remap[i] = it->second;
+    }
+
+    for (uint32_t &index : indices)
+        index = remap[index];
+
+    vertices = std::move(welded);
+}
+
+// {{{ VERTEX CACHE
+
+namespace
+{
+    constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+    constexpr float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+    constexpr float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+    constexpr float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+    constexpr float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+    float forsyth_vertex_score(int32_t cachePosition, uint32_t remainingValence)
+    {
+        // no triangles left that use this vertex
+        if (remainingValence == 0)
+            return -1.f;
+
+        float score = 0.f;
+        if (cachePosition >= 0)
+        {
+            // the last triangle's vertices get a fixed score so the next triangle doesnt just reuse them
+            if (cachePosition < 3)
+                score = FORSYTH_LAST_TRIANGLE_SCORE;
+            else
+                score = std::pow(1.f - float(cachePosition - 3) / float(FORSYTH_CACHE_SIZE - 3),
+                                 FORSYTH_CACHE_DECAY_POWER);
+        }
+
+        // boost vertices with few triangles left, so lone triangles get picked up instead of left behind
+        score += FORSYTH_VALENCE_BOOST_SCALE * std::pow(float(remainingValence), -FORSYTH_VALENCE_BOOST_POWER);
+        return score;
+    }
+} // namespace
+
+void meshproc::optimize_vertex_cache(std::span<uint32_t> indices, size_t vertexCount)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // triangles per vertex, as offsets into one adjacency array
+    std::vector<uint32_t> valence(vertexCount, 0);
+    for (uint32_t index : indices)
+        valence[index]++;
+
+    std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + valence[v];
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+    }
+
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = forsyth_vertex_score(-1, valence[v]);
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    // the cache is kept with 3 extra slots for the vertices pushed out by the newest triangle
+    std::vector<uint32_t> cache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    std::vector<uint32_t> newCache;
+    newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    size_t scanCursor = 0;
+    int64_t bestTriangle = -1;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        // nothing in the cache connects to a triangle left, continue with the next one in input order. scanning for
+        // the best score here instead would be quadratic on meshes made of many small pieces
+        if (bestTriangle < 0)
+            bestTriangle = static_cast<int64_t>(scanCursor);
+
+        uint32_t tri = static_cast<uint32_t>(bestTriangle);
+        emitted[tri] = true;
+        while (scanCursor < triangleCount && emitted[scanCursor])
+            scanCursor++;
+
+        const uint32_t a = indices[tri * 3], b = indices[tri * 3 + 1], c = indices[tri * 3 + 2];
+        output.insert(output.end(), {a, b, c});
+
+        // drop the triangle from the adjacency of its vertices
+        for (uint32_t v : {a, b, c})
+        {
+            uint32_t *begin = adjacency.data() + adjacencyOffset[v];
+            uint32_t *end = begin + valence[v];
+            *std::find(begin, end, tri) = *(end - 1);
+            valence[v]--;
+        }
+
+        // move the triangle's vertices to the front of the cache
+        newCache.assign({a, b, c});
+        for (uint32_t v : cache)
+        {
+            if (v != a && v != b && v != c)
+                newCache.push_back(v);
+        }
+        std::swap(cache, newCache);
+
+        for (size_t i = 0; i < cache.size(); i++)
+        {
+            uint32_t v = cache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+            vertexScore[v] = forsyth_vertex_score(cachePosition[v], valence[v]);
+        }
+        // rescore the triangles touching the cache (including the vertices that just fell out of it) and pick the
+        // next one among them
+        bestTriangle = -1;
+        float bestScore = -1.f;
+        for (uint32_t v : cache)
+        {
+            for (uint32_t i = 0; i < valence[v]; i++)
+            {
+                uint32_t t = adjacency[adjacencyOffset[v] + i];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+                              vertexScore[indices[t * 3 + 2]];
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        if (cache.size() > FORSYTH_CACHE_SIZE)
+            cache.resize(FORSYTH_CACHE_SIZE);
+    }
+
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+// }}} VERTEX CACHE end
+
+void meshproc::optimize_overdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, float threshold)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 16)
+        return;
+
+    constexpr uint32_t cacheSize = 16;
+    constexpr size_t minClusterTriangles = 8;
+
+    // hard boundaries, where the cache optimized order misses on all three vertices
+    std::vector<size_t> clusterStarts;
+    {
+        std::vector<uint32_t> loadedAt(vertices.size(), 0);
+        uint32_t timestamp = cacheSize + 1;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            uint32_t misses = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t v = indices[t * 3 + k];
+                if (timestamp - loadedAt[v] > cacheSize)
+                {
+                    loadedAt[v] = timestamp++;
+                    misses++;
+                }
+            }
+            if (t == 0 || (misses == 3 && t - clusterStarts.back() >= minClusterTriangles))
+                clusterStarts.push_back(t);
+        }
+    }
+
+    // soft boundaries, split the hard clusters further wherever restarting the cache there keeps the miss ratio of
+    // the piece under the threshold
+    std::vector<size_t> softStarts;
+    for (size_t c = 0; c < clusterStarts.size(); c++)
+    {
+        size_t start = clusterStarts[c];
+        size_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+        float clusterAcmr = analyze_acmr(indices.subspan(start * 3, (end - start) * 3), vertices.size(), cacheSize);
+
+        softStarts.push_back(start);
+
+        std::vector<uint32_t> loadedAt(vertices.size(), 0);
+        uint32_t timestamp = cacheSize + 1;
+        uint32_t misses = 0;
+        size_t pieceStart = start;
+        for (size_t t = start; t < end; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t v = indices[t * 3 + k];
+                if (timestamp - loadedAt[v] > cacheSize)
+                {
+                    loadedAt[v] = timestamp++;
+                    misses++;
+                }
+            }
+
+            size_t pieceTriangles = t + 1 - pieceStart;
+            if (t + 1 < end && pieceTriangles >= minClusterTriangles &&
+                float(misses) / float(pieceTriangles) <= clusterAcmr * threshold)
+            {
+                softStarts.push_back(t + 1);
+                pieceStart = t + 1;
+                misses = 0;
+                // the next piece can be drawn anywhere, so it starts from a cold cache
+                timestamp += cacheSize + 1;
+            }
+        }
+    }
+
+    // sort key per cluster, how much it faces away from the center of the mesh
+    glm::vec3 meshCentroid{0.f};
+    float meshArea = 0.f;
+    std::vector<glm::vec3> triangleCentroid(triangleCount);
+    std::vector<glm::vec3> triangleNormal(triangleCount); // length is twice the area
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        glm::vec3 p0 = vertices[indices[t * 3]].position;
+        glm::vec3 p1 = vertices[indices[t * 3 + 1]].position;
+        glm::vec3 p2 = vertices[indices[t * 3 + 2]].position;
+        triangleCentroid[t] = (p0 + p1 + p2) / 3.f;
+        triangleNormal[t] = glm::cross(p1 - p0, p2 - p0);
+
+        float area = glm::length(triangleNormal[t]);
+        meshCentroid += triangleCentroid[t] * area;
+        meshArea += area;
+    }
+    if (meshArea > 0.f)
+        meshCentroid /= meshArea;
+
+    struct Cluster
+    {
+        size_t start;
+        size_t end;
+        float sortKey;
+    };
+    std::vector<Cluster> clusters;
+    clusters.reserve(softStarts.size());
+    for (size_t c = 0; c < softStarts.size(); c++)
+    {
+        Cluster cluster{softStarts[c], c + 1 < softStarts.size() ? softStarts[c + 1] : triangleCount, 0.f};
+
+        glm::vec3 centroid{0.f}, normal{0.f};
+        float area = 0.f;
+        for (size_t t = cluster.start; t < cluster.end; t++)
+        {
+            float triangleArea = glm::length(triangleNormal[t]);
+            centroid += triangleCentroid[t] * triangleArea;
+            normal += triangleNormal[t];
+            area += triangleArea;
+        }
+        if (area > 0.f)
+            centroid /= area;
+
+        float normalLength = glm::length(normal);
+        if (normalLength > 0.f)
+            cluster.sortKey = glm::dot(centroid - meshCentroid, normal / normalLength);
+
+        clusters.push_back(cluster);
+    }
+
+    // outward facing clusters first, they are the ones that occlude the rest
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (const Cluster &cluster : clusters)
+        output.insert(output.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void meshproc::optimize_vertex_fetch(std::vector<Vertex> &vertices, std::span<uint32_t> indices)
+{
+    constexpr uint32_t unused = ~0u;
+    std::vector<uint32_t> remap(vertices.size(), unused);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (uint32_t &index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(reordered);
+}
+
+meshproc::MeshOptimizationStats meshproc::optimize_mesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices,
+                                                        std::span<const IndexRange> surfaces)
+{
+    MeshOptimizationStats stats;
+    stats.meshes = 1;
+    stats.triangles = indices.size() / 3;
+    stats.verticesBefore = vertices.size();
+    stats.acmrBefore = analyze_acmr(indices, vertices.size());
+
+    weld_vertices(vertices, indices);
+
+    for (const IndexRange &surface : surfaces)
+    {
+        std::span<uint32_t> surfaceIndices = std::span(indices).subspan(surface.first, surface.count);
+        optimize_vertex_cache(surfaceIndices, vertices.size());
+        optimize_overdraw(surfaceIndices, vertices);
+    }
+
+    // last, it depends on the final triangle order
+    optimize_vertex_fetch(vertices, indices);
+
+    stats.verticesAfter = vertices.size();
+    stats.acmrAfter = analyze_acmr(indices, vertices.size());
+    return stats;
+}
+
+// {{{ MESHLETS
+
+void meshproc::MeshletStats::add(const MeshletStats &other)
+{
+    meshlets += other.meshlets;
+    triangles += other.triangles;
+    vertices += other.vertices;
+    withCone += other.withCone;
+}
+
+namespace
+{
+    struct PositionHash
+    {
+        size_t operator()(const glm::vec3 &p) const
+        {
+            return hash_bytes(&p, sizeof(p));
+        }
+    };
+
+    // uniform grid over the centroids of the triangles of a surface, to find the nearest one not yet in a meshlet
+    class TriangleGrid
+    {
+      public:
+        explicit TriangleGrid(std::span<const glm::vec3> centroids) : centroids(centroids)
+        {
+            for (const glm::vec3 &c : centroids)
+            {
+                minCorner = glm::min(minCorner, c);
+                maxCorner = glm::max(maxCorner, c);
+            }
+
+            // cubes of about two triangles each for a mesh that fills its box, flat meshes get a single layer
+            int perAxis = std::clamp(static_cast<int>(std::cbrt(centroids.size() / 2.0)), 1, 128);
+            glm::vec3 size = maxCorner - minCorner;
+            cellSize = std::max({size.x, size.y, size.z, 1e-6f}) / perAxis;
+            cells = glm::clamp(glm::ivec3(glm::ceil(size / cellSize)), glm::ivec3(1), glm::ivec3(perAxis));
+
+            triangleCell.resize(centroids.size());
+            cellStart.assign(size_t(cells.x) * cells.y * cells.z + 1, 0);
+            for (size_t t = 0; t < centroids.size(); t++)
+            {
+                glm::ivec3 cell = cell_of(centroids[t]);
+                triangleCell[t] = static_cast<uint32_t>((cell.z * cells.y + cell.y) * cells.x + cell.x);
+                cellStart[triangleCell[t] + 1]++;
+            }
+            for (size_t c = 1; c < cellStart.size(); c++)
+                cellStart[c] += cellStart[c - 1];
+            cellLive.resize(cellStart.size() - 1);
+            for (size_t c = 0; c < cellLive.size(); c++)
+                cellLive[c] = cellStart[c];
+
+            cellTriangles.resize(centroids.size());
+            triangleSlot.resize(centroids.size());
+            for (uint32_t t = 0; t < centroids.size(); t++)
+            {
+                uint32_t slot = cellLive[triangleCell[t]]++;
+                cellTriangles[slot] = t;
+                triangleSlot[t] = slot;
+            }
+            live = centroids.size();
+        }
+
+        // swaps the triangle behind the live ones of its cell
+        void remove(uint32_t t)
+        {
+            uint32_t cell = triangleCell[t];
+            uint32_t last = --cellLive[cell];
+            uint32_t other = cellTriangles[last];
+            std::swap(cellTriangles[triangleSlot[t]], cellTriangles[last]);
+            triangleSlot[other] = triangleSlot[t];
+            triangleSlot[t] = last;
+            live--;
+        }
+
+        // -1 when every triangle was removed
+        int64_t nearest(const glm::vec3 &point) const
+        {
+            int64_t best = -1;
+            float bestDistance = FLT_MAX;
+            if (live == 0)
+                return best;
+
+            // rings of cells around the one of the point, until no closer triangle can be further out
+            glm::ivec3 center = cell_of(point);
+            int maxRing = std::max({cells.x, cells.y, cells.z});
+            for (int ring = 0; ring <= maxRing; ring++)
+            {
+                if (best >= 0 && bestDistance <= (ring - 1) * cellSize)
+                    break;
+                glm::ivec3 low = glm::max(center - ring, glm::ivec3(0));
+                glm::ivec3 high = glm::min(center + ring, cells - 1);
+                for (int z = low.z; z <= high.z; z++)
+                {
+                    for (int y = low.y; y <= high.y; y++)
+                    {
+                        // inside the ring in y and z only the two ends of the row are on it
+                        bool inner = std::abs(y - center.y) < ring && std::abs(z - center.z) < ring;
+                        int step = inner ? 2 * ring : 1;
+                        for (int x = center.x - ring; x <= center.x + ring; x += step)
+                        {
+                            if (x < low.x || x > high.x)
+                                continue;
+                            uint32_t cell = static_cast<uint32_t>((z * cells.y + y) * cells.x + x);
+                            for (uint32_t i = cellStart[cell]; i < cellLive[cell]; i++)
+                            {
+                                float distance = glm::length(centroids[cellTriangles[i]] - point);
+                                if (distance < bestDistance)
+                                {
+                                    best = cellTriangles[i];
+                                    bestDistance = distance;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            return best;
+        }
+
+      private:
+        glm::ivec3 cell_of(const glm::vec3 &p) const
+        {
+            glm::ivec3 cell = glm::ivec3((p - minCorner) / cellSize);
+            return glm::clamp(cell, glm::ivec3(0), cells - 1);
+        }
+
+        std::span<const glm::vec3> centroids;
+        glm::vec3 minCorner{FLT_MAX};
+        glm::vec3 maxCorner{-FLT_MAX};
+        glm::ivec3 cells;
+        float cellSize;
+        // triangles of every cell, the ones still unused first
+        std::vector<uint32_t> cellStart;
+        std::vector<uint32_t> cellLive; // end of the unused triangles of every cell
+        std::vector<uint32_t> cellTriangles;
+        std::vector<uint32_t> triangleCell;
+        std::vector<uint32_t> triangleSlot; // position in cellTriangles
+        size_t live = 0;
+    };
+
+    // bounding sphere and normal cone of one meshlet, same approach as meshoptimizer's meshlet bounds
+    void compute_meshlet_bounds(Meshlet &meshlet, std::span<const uint32_t> indices, std::span<const Vertex> vertices)
+    {
+        glm::vec3 minPos = vertices[indices[0]].position, maxPos = minPos;
+        for (uint32_t index : indices)
+        {
+            minPos = glm::min(minPos, vertices[index].position);
+            maxPos = glm::max(maxPos, vertices[index].position);
+        }
+
+        glm::vec3 center = (minPos + maxPos) * 0.5f;
+        float radius = 0.f;
+        for (uint32_t index : indices)
+            radius = std::max(radius, glm::length(vertices[index].position - center));
+        meshlet.boundingSphere = glm::vec4(center, radius);
+
+        // average the triangle normals, and check how far the worst one is from it. degenerate triangles dont face
+        // anywhere and are skipped
+        struct Plane
+        {
+            glm::vec3 point;
+            glm::vec3 normal;
+        };
+        std::vector<Plane> planes;
+        planes.reserve(indices.size() / 3);
+        glm::vec3 axis{0.f};
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            glm::vec3 p0 = vertices[indices[i]].position;
+            glm::vec3 n = glm::cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+            float length = glm::length(n);
+            if (length == 0.f)
+                continue;
+            planes.push_back({p0, n / length});
+            axis += n / length;
+        }
+
+        meshlet.coneAxisCutoff = glm::vec4(0.f, 0.f, 1.f, 1.f);
+        meshlet.coneApex = glm::vec4(center, 0.f);
+
+        float axisLength = glm::length(axis);
+        if (axisLength == 0.f)
+            return;
+        axis /= axisLength;
+
+        float minDot = 1.f;
+        for (const Plane &plane : planes)
+            minDot = std::min(minDot, glm::dot(plane.normal, axis));
+
+        // cones wider than ~85 degrees barely cull anything
+        if (minDot <= 0.1f)
+            return;
+
+        // move the apex back along the axis until it is behind every triangle plane
+        float maxT = 0.f;
+        for (const Plane &plane : planes)
+            maxT = std::max(maxT, glm::dot(center - plane.point, plane.normal) / glm::dot(axis, plane.normal));
+
+        meshlet.coneApex = glm::vec4(center - axis * maxT, 0.f);
+        meshlet.coneAxisCutoff = glm::vec4(axis, std::sqrt(1.f - minDot * minDot));
+    }
+} // namespace
+
+std::vector<Meshlet> meshproc::build_meshlets(std::span<uint32_t> surfaceIndices, std::span<const Vertex> vertices,
+                                              uint32_t indexBase, uint32_t maxVertices, uint32_t maxTriangles)
+{
+    std::vector<Meshlet> meshlets;
+    const size_t triangleCount = surfaceIndices.size() / 3;
+    if (triangleCount == 0)
+        return meshlets;
+
+    // adjacency goes through welded positions, so the faces of flat shaded meshes that keep their own vertices
+    // still count as connected
+    std::vector<uint32_t> positionId(vertices.size(), ~0u);
+    std::vector<uint32_t> positionTriangleStart;
+    {
+        std::unordered_map<glm::vec3, uint32_t, PositionHash> unique;
+        for (uint32_t index : surfaceIndices)
+        {
+            if (positionId[index] != ~0u)
+                continue;
+            auto [it, inserted] = unique.try_emplace(vertices[index].position, static_cast<uint32_t>(unique.size()));
+            positionId[index] = it->second;
+        }
+        positionTriangleStart.assign(unique.size() + 1, 0);
+    }
+
+    // triangles around each position, a triangle is listed once per distinct position it has
+    std::vector<uint32_t> trianglePositions(surfaceIndices.size());
+    for (size_t i = 0; i < surfaceIndices.size(); i++)
+        trianglePositions[i] = positionId[surfaceIndices[i]];
+    auto distinct_corner = [&](size_t t, int k)
+    {
+        const uint32_t *p = &trianglePositions[t * 3];
+        return (k < 1 || p[k] != p[0]) && (k < 2 || p[k] != p[1]);
+    };
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int k = 0; k < 3; k++)
+            positionTriangleStart[trianglePositions[t * 3 + k] + 1] += distinct_corner(t, k);
+    }
+    for (size_t p = 1; p < positionTriangleStart.size(); p++)
+        positionTriangleStart[p] += positionTriangleStart[p - 1];
+    std::vector<uint32_t> positionTriangles(positionTriangleStart.back());
+    {
+        std::vector<uint32_t> cursor(positionTriangleStart.begin(), positionTriangleStart.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                if (distinct_corner(t, k))
+                    positionTriangles[cursor[trianglePositions[t * 3 + k]]++] = static_cast<uint32_t>(t);
+            }
+        }
+    }
+
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        centroids[t] = (vertices[surfaceIndices[t * 3]].position + vertices[surfaceIndices[t * 3 + 1]].position +
+                        vertices[surfaceIndices[t * 3 + 2]].position) /
+                       3.f;
+    }
+    TriangleGrid unusedTriangles(centroids);
+
+    std::vector<bool> used(triangleCount, false);
+    size_t scanCursor = 0;
+
+    std::vector<uint32_t> output;
+    output.reserve(surfaceIndices.size());
+
+    // vertices and positions of the meshlet being built, marked with the number of the meshlet they are in
+    uint32_t meshletNumber = 0;
+    std::vector<uint32_t> vertexMark(vertices.size(), ~0u);
+    std::vector<uint32_t> positionMark(positionTriangleStart.size() - 1, ~0u);
+    std::vector<uint32_t> meshletPositions;
+    uint32_t meshletVertexCount = 0;
+    glm::vec3 meshletCentroid{0.f};
+    uint32_t meshletTriangles = 0;
+
+    auto finishMeshlet = [&]()
+    {
+        if (meshletTriangles == 0)
+            return;
+
+        Meshlet meshlet{};
+        meshlet.firstIndex = indexBase + static_cast<uint32_t>(output.size() - meshletTriangles * 3);
+        meshlet.indexCount = meshletTriangles * 3;
+        meshlet.vertexCount = meshletVertexCount;
+        compute_meshlet_bounds(meshlet, std::span(output).last(meshlet.indexCount), vertices);
+        meshlets.push_back(meshlet);
+
+        meshletNumber++;
+        meshletPositions.clear();
+        meshletVertexCount = 0;
+        meshletCentroid = glm::vec3(0.f);
+        meshletTriangles = 0;
+    };
+
+    auto shared_vertices = [&](uint32_t t)
+    {
+        int shared = 0;
+        for (int k = 0; k < 3; k++)
+            shared += vertexMark[surfaceIndices[t * 3 + k]] == meshletNumber;
+        return shared;
+    };
+
+    for (size_t emitted = 0; emitted < triangleCount; emitted++)
+    {
+        // best unused triangle touching the meshlet: most shared vertices, then closest to the meshlet centre
+        int64_t best = -1;
+        int bestShared = -1;
+        float bestDistance = 0.f;
+        for (uint32_t position : meshletPositions)
+        {
+            for (uint32_t i = positionTriangleStart[position]; i < positionTriangleStart[position + 1]; i++)
+            {
+                uint32_t t = positionTriangles[i];
+                if (used[t])
+                    continue;
+
+                int shared = shared_vertices(t);
+                if (meshletVertexCount + (3 - shared) > maxVertices)
+                    continue;
+
+                float distance = glm::length(centroids[t] - meshletCentroid);
+                if (shared > bestShared || (shared == bestShared && distance < bestDistance))
+                {
+                    best = t;
+                    bestShared = shared;
+                    bestDistance = distance;
+                }
+            }
+        }
+
+        // nothing connected fits, keep filling with the nearest triangle while three more vertices do
+        if (best < 0 && meshletTriangles > 0 && meshletVertexCount + 3 <= maxVertices)
+            best = unusedTriangles.nearest(meshletCentroid);
+
+        // the meshlet is full, start a new one from the next triangle in order
+        if (best < 0)
+        {
+            finishMeshlet();
+            while (used[scanCursor])
+                scanCursor++;
+            best = static_cast<int64_t>(scanCursor);
+        }
+
+        uint32_t tri = static_cast<uint32_t>(best);
+        used[tri] = true;
+        unusedTriangles.remove(tri);
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = surfaceIndices[tri * 3 + k];
+            output.push_back(v);
+            if (vertexMark[v] != meshletNumber)
+            {
+                vertexMark[v] = meshletNumber;
+                meshletVertexCount++;
+            }
+            uint32_t position = trianglePositions[tri * 3 + k];
+            if (positionMark[position] != meshletNumber)
+            {
+                positionMark[position] = meshletNumber;
+                meshletPositions.push_back(position);
+            }
+        }
+
+        meshletCentroid =
+            (meshletCentroid * float(meshletTriangles) + centroids[tri]) / float(meshletTriangles + 1);
+        meshletTriangles++;
+
+        if (meshletTriangles == maxTriangles)
+            finishMeshlet();
+    }
+    finishMeshlet();
+
+    std::copy(output.begin(), output.end(), surfaceIndices.begin());
+    return meshlets;
+}
+
+meshproc::MeshletStats meshproc::analyze_meshlets(std::span<const Meshlet> meshlets)
+{
+    MeshletStats stats;
+    stats.meshlets = meshlets.size();
+    for (const Meshlet &meshlet : meshlets)
+    {
+        stats.triangles += meshlet.indexCount / 3;
+        stats.vertices += meshlet.vertexCount;
+        stats.withCone += meshlet.coneAxisCutoff.w < 1.f;
+    }
+    return stats;
+}
+
+// }}} MESHLETS end
+
+// {{{ SIMPLIFICATION
+
+namespace
+{
+    // sum of squared distances to a set of planes, weighted by triangle area
+    struct Quadric
+    {
+        double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+        double b0 = 0, b1 = 0, b2 = 0;
+        double c = 0;
+        double weight = 0;
+
+        void add_plane(const glm::dvec3 &n, double d, double w)
+        {
+            a00 += w * n.x * n.x;
+            a11 += w * n.y * n.y;
+            a22 += w * n.z * n.z;
+            a01 += w * n.x * n.y;
+            a02 += w * n.x * n.z;
+            a12 += w * n.y * n.z;
+            b0 += w * n.x * d;
+            b1 += w * n.y * d;
+            b2 += w * n.z * d;
+            c += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric &o)
+        {
+            a00 += o.a00, a11 += o.a11, a22 += o.a22, a01 += o.a01, a02 += o.a02, a12 += o.a12;
+            b0 += o.b0, b1 += o.b1, b2 += o.b2;
+            c += o.c;
+            weight += o.weight;
+        }
+
+        double evaluate(const glm::dvec3 &p) const
+        {
+            double rx = a00 * p.x + a01 * p.y + a02 * p.z;
+            double ry = a01 * p.x + a11 * p.y + a12 * p.z;
+            double rz = a02 * p.x + a12 * p.y + a22 * p.z;
+            double value = p.x * rx + p.y * ry + p.z * rz + 2 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return std::max(value, 0.0);
+        }
+    };
+
+    struct Collapse
+    {
+        uint32_t from; // position ids
+        uint32_t to;
+        uint32_t toVertex; // vertex used by the triangles of from after the collapse
+        double error;      // squared distance
+    };
+
+    uint64_t edge_key(uint32_t a, uint32_t b)
+    {
+        return a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+    }
+} // namespace
+
+std::vector<uint32_t> meshproc::simplify(std::span<const uint32_t> indices, std::span<const Vertex> vertices,
+                                         size_t targetIndexCount, float targetError, float *resultError)
+{
+    std::vector<uint32_t> result(indices.begin(), indices.end());
+    if (resultError)
+        *resultError = 0.f;
+
+    // vertices that only differ by attributes share a position id, the topology is built on those
+    std::vector<uint32_t> positionId(vertices.size(), ~0u);
+    std::vector<glm::dvec3> positions;
+    std::vector<uint32_t> positionVertex; // one vertex per position id, ~0u once it has several
+    {
+        std::unordered_map<glm::vec3, uint32_t, PositionHash> unique;
+        for (uint32_t index : result)
+        {
+            if (positionId[index] != ~0u)
+                continue;
+            auto [it, inserted] = unique.try_emplace(vertices[index].position, static_cast<uint32_t>(positions.size()));
+            if (inserted)
+            {
+                positions.push_back(glm::dvec3(vertices[index].position));
+                positionVertex.push_back(index);
+            }
+            else if (positionVertex[it->second] != index)
+                positionVertex[it->second] = ~0u;
+            positionId[index] = it->second;
+        }
+    }
+    const size_t positionCount = positions.size();
+
+    // border and non manifold edges are locked, so are the vertices on attribute seams. this keeps the outline of
+    // the surface and its uv layout intact
+    std::vector<bool> locked(positionCount, false);
+    {
+        std::unordered_map<uint64_t, uint32_t> edgeUse;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+                edgeUse[edge_key(positionId[result[i + k]], positionId[result[i + (k + 1) % 3]])]++;
+        }
+        for (auto &[key, count] : edgeUse)
+        {
+            if (count != 2)
+            {
+                locked[key >> 32] = true;
+                locked[key & 0xffffffffu] = true;
+            }
+        }
+        for (size_t p = 0; p < positionCount; p++)
+            locked[p] = locked[p] || positionVertex[p] == ~0u;
+    }
+
+    std::vector<Quadric> quadrics(positionCount);
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        uint32_t a = positionId[result[i]], b = positionId[result[i + 1]], c = positionId[result[i + 2]];
+        glm::dvec3 n = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+        double length = glm::length(n);
+        if (length == 0.0)
+            continue;
+        n /= length;
+        // area weighted, length is twice the area
+        double area = length * 0.5;
+        quadrics[a].add_plane(n, -glm::dot(n, positions[a]), area);
+        quadrics[b].add_plane(n, -glm::dot(n, positions[a]), area);
+        quadrics[c].add_plane(n, -glm::dot(n, positions[a]), area);
+    }
+
+    const double maxError = double(targetError) * targetError;
+    double worstError = 0.0;
+
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<bool> touched(positionCount);
+    std::vector<uint32_t> triangleOffsets(positionCount + 1);
+    std::vector<uint32_t> triangleList;
+
+    // every pass collapses a set of independent edges, cheapest first, then the index list is rebuilt
+    while (result.size() > targetIndexCount)
+    {
+        // triangles around each position
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (uint32_t index : result)
+            triangleOffsets[positionId[index] + 1]++;
+        for (size_t p = 0; p < positionCount; p++)
+            triangleOffsets[p + 1] += triangleOffsets[p];
+        triangleList.resize(result.size());
+        {
+            std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++)
+                triangleList[cursor[positionId[result[i]]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<Collapse> collapses;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t from = positionId[result[i + k]];
+                uint32_t toVertex = result[i + (k + 1) % 3];
+                uint32_t to = positionId[toVertex];
+                if (locked[from])
+                    continue;
+
+                Quadric q = quadrics[from];
+                q.add(quadrics[to]);
+                double error = q.weight > 0 ? q.evaluate(positions[to]) / q.weight : 0.0;
+                if (error <= maxError)
+                    collapses.push_back({from, to, toVertex, error});
+            }
+        }
+        if (collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse &a, const Collapse &b) { return a.error < b.error; });
+
+        std::fill(touched.begin(), touched.end(), false);
+        for (size_t v = 0; v < vertices.size(); v++)
+            remap[v] = static_cast<uint32_t>(v);
+
+        size_t triangleCount = result.size() / 3;
+        const size_t targetTriangles = targetIndexCount / 3;
+        bool collapsed = false;
+        for (const Collapse &collapse : collapses)
+        {
+            if (triangleCount <= targetTriangles)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // moving from onto to must not flip any of the triangles around from
+            bool flips = false;
+            uint32_t removed = 0;
+            for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && !flips; t++)
+            {
+                uint32_t tri = triangleList[t];
+                uint32_t ids[3] = {positionId[result[tri * 3]], positionId[result[tri * 3 + 1]],
+                                   positionId[result[tri * 3 + 2]]};
+                if (ids[0] == collapse.to || ids[1] == collapse.to || ids[2] == collapse.to)
+                {
+                    removed++;
+                    continue;
+                }
+
+                auto normal = [&]()
+                { return glm::cross(positions[ids[1]] - positions[ids[0]], positions[ids[2]] - positions[ids[0]]); };
+                glm::dvec3 before = normal();
+                for (uint32_t &id : ids)
+                    id = id == collapse.from ? collapse.to : id;
+                glm::dvec3 after = normal();
+                flips = glm::dot(before, after) <= 0.0;
+            }
+            if (flips)
+                continue;
+
+            // lock the whole fan, so the flip check above stays valid for the rest of the pass
+            for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++)
+            {
+                uint32_t tri = triangleList[t];
+                for (int k = 0; k < 3; k++)
+                    touched[positionId[result[tri * 3 + k]]] = true;
+            }
+
+            // from has a single vertex, it is not on a seam
+            remap[positionVertex[collapse.from]] = collapse.toVertex;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            worstError = std::max(worstError, collapse.error);
+            triangleCount -= removed;
+            collapsed = true;
+        }
+        if (!collapsed)
+            break;
+
+        // rewrite the indices and drop the triangles that collapsed to a line
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (positionId[a] == positionId[b] || positionId[b] == positionId[c] || positionId[a] == positionId[c])
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (resultError)
+        *resultError = static_cast<float>(std::sqrt(worstError));
+    return result;
+}
+
+std::vector<SurfaceLod> meshproc::build_lod_chain(std::vector<uint32_t> &indices, IndexRange surface,
+                                                  std::span<const Vertex> vertices, float maxError, uint32_t maxLods)
+{
+    std::vector<SurfaceLod> lods;
+    lods.push_back({surface.first, surface.count, 0.f});
+
+    std::vector<uint32_t> source(indices.begin() + surface.first, indices.begin() + surface.first + surface.count);
+    float error = 0.f;
+    while (lods.size() < maxLods && source.size() >= 3 * 64 && error < maxError)
+    {
+        // every level halves the triangles, the errors of the levels add up since each one is built from the last
+        size_t target = source.size() / 6 * 3;
+        float levelError = 0.f;
+        std::vector<uint32_t> simplified = simplify(source, vertices, target, maxError - error, &levelError);
+
+        // stop once the simplifier is stuck on locked vertices or out of error budget
+        if (simplified.size() > source.size() * 3 / 4)
+            break;
+
+        error += levelError;
+        optimize_vertex_cache(simplified, vertices.size());
+
+        lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), error});
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        source = std::move(simplified);
+    }
+    return lods;
+}
+
+// }}} SIMPLIFICATION end
+
+// {{{ QUANTIZATION
+
+namespace
+{
+    uint16_t quantize_unorm16(float v)
+    {
+        return static_cast<uint16_t>(std::clamp(v, 0.f, 1.f) * 65535.f + 0.5f);
+    }
+
+    int16_t quantize_snorm16(float v)
+    {
+        return static_cast<int16_t>(std::round(std::clamp(v, -1.f, 1.f) * 32767.f));
+    }
+
+    // octahedral mapping of a unit vector onto the [-1, 1] square
+    glm::vec2 encode_octahedral(glm::vec3 n)
+    {
+        float length = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (length == 0.f)
+            return glm::vec2(0.f);
+
+        glm::vec2 p = glm::vec2(n.x, n.y) / length;
+        if (n.z < 0.f)
+        {
+            glm::vec2 folded = 1.f - glm::abs(glm::vec2(p.y, p.x));
+            p.x = p.x >= 0.f ? folded.x : -folded.x;
+            p.y = p.y >= 0.f ? folded.y : -folded.y;
+        }
+        return p;
+    }
+} // namespace
+
+std::optional<meshproc::QuantizedVertices> meshproc::quantize_vertices(std::span<const Vertex> vertices,
+                                                                       float maxPositionError, float maxUVError)
+{
+    if (vertices.empty())
+        return {};
+
+    glm::vec3 minPos = vertices[0].position, maxPos = vertices[0].position;
+    glm::vec2 minUV{vertices[0].uv_x, vertices[0].uv_y}, maxUV = minUV;
+    for (const Vertex &v : vertices)
+    {
+        minPos = glm::min(minPos, v.position);
+        maxPos = glm::max(maxPos, v.position);
+        minUV = glm::min(minUV, glm::vec2(v.uv_x, v.uv_y));
+        maxUV = glm::max(maxUV, glm::vec2(v.uv_x, v.uv_y));
+
+        // hdr vertex colors dont fit unorm8
+        if (glm::any(glm::lessThan(v.color, glm::vec4(0.f))) || glm::any(glm::greaterThan(v.color, glm::vec4(1.f))))
+            return {};
+    }
+
+    glm::vec3 posExtent = maxPos - minPos;
+    glm::vec2 uvExtent = maxUV - minUV;
+
+    // worst case rounding error is half a step
+    float maxStep = std::max({posExtent.x, posExtent.y, posExtent.z}) / 65535.f;
+    if (maxStep * 0.5f > maxPositionError)
+        return {};
+    // tiled uvs span many units, past a few the steps get coarser than a texel
+    float maxUVStep = std::max(uvExtent.x, uvExtent.y) / 65535.f;
+    if (maxUVStep * 0.5f > maxUVError)
+        return {};
+
+    QuantizedVertices result;
+    result.quantization.positionOffset = glm::vec4(minPos, 0.f);
+    result.quantization.positionScale = glm::vec4(posExtent, 0.f);
+    result.quantization.uvOffsetScale = glm::vec4(minUV, uvExtent);
+
+    // flat axes would divide by zero, any value decodes to the offset there
+    glm::vec3 posInvExtent = glm::vec3(posExtent.x > 0.f ? 1.f / posExtent.x : 0.f,
+                                       posExtent.y > 0.f ? 1.f / posExtent.y : 0.f,
+                                       posExtent.z > 0.f ? 1.f / posExtent.z : 0.f);
+    glm::vec2 uvInvExtent = glm::vec2(uvExtent.x > 0.f ? 1.f / uvExtent.x : 0.f,
+                                      uvExtent.y > 0.f ? 1.f / uvExtent.y : 0.f);
+
+    result.vertices.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex &v = vertices[i];
+        PackedVertex &packed = result.vertices[i];
+
+        glm::vec3 pos = (v.position - minPos) * posInvExtent;
+        packed.position[0] = quantize_unorm16(pos.x);
+        packed.position[1] = quantize_unorm16(pos.y);
+        packed.position[2] = quantize_unorm16(pos.z);
+        packed.pad = 0;
+
+        glm::vec2 oct = encode_octahedral(v.normal);
+        packed.normal[0] = quantize_snorm16(oct.x);
+        packed.normal[1] = quantize_snorm16(oct.y);
+
+        glm::vec2 uv = (glm::vec2(v.uv_x, v.uv_y) - minUV) * uvInvExtent;
+        packed.uv[0] = quantize_unorm16(uv.x);
+        packed.uv[1] = quantize_unorm16(uv.y);
+
+        for (int c = 0; c < 4; c++)
+            packed.color[c] = static_cast<uint8_t>(v.color[c] * 255.f + 0.5f);
+    }
+
+    return result;
+}
+
+// }}} QUANTIZATION end
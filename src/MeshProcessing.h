@@ -0,0 +1,141 @@
+#pragma once
+#include <optional>
+#include <span>
+#include <vector>
+#include <vk_types.h>
+
+/**
+ * @brief Import time mesh optimization. Every pass works on a mesh made of several surfaces that share one vertex
+ * array, each surface being a range of the index array. Surfaces keep their index ranges, only the order of the
+ * triangles inside a range and the order of the vertices change.
+ *
+ */
+namespace meshproc
+{
+    struct IndexRange
+    {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    struct MeshOptimizationStats
+    {
+        size_t meshes = 0;
+        size_t triangles = 0;
+        size_t verticesBefore = 0;
+        size_t verticesAfter = 0;
+        // vertex shader invocations per triangle, with a 16 entry fifo cache
+        float acmrBefore = 0;
+        float acmrAfter = 0;
+
+        void add(const MeshOptimizationStats &other);
+    };
+
+    /**
+     * @brief Average cache miss ratio of the index sequence, simulated with a fifo post transform cache.
+     *
+     */
+    float analyze_acmr(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize = 16);
+
+    /**
+     * @brief Merge bitwise identical vertices and rewrite the indices to point to the remaining copy.
+     *
+     */
+    void weld_vertices(std::vector<Vertex> &vertices, std::span<uint32_t> indices);
+
+    /**
+     * @brief Reorder the triangles of an index range for the post transform cache (Forsyth's linear speed
+     * algorithm).
+     *
+     */
+    void optimize_vertex_cache(std::span<uint32_t> indices, size_t vertexCount);
+
+    /**
+     * @brief Reorder clusters of triangles so outward facing ones are drawn first, which reduces overdraw when the
+     * mesh is seen from outside. Clusters are cut where the cache optimized order already restarts, and where a
+     * split keeps the cache miss ratio under threshold times the original, so the cache win is kept.
+     *
+     */
+    void optimize_overdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, float threshold = 1.05f);
+
+    /**
+     * @brief Reorder vertices into the order the indices first reference them, and drop unreferenced vertices.
+     *
+     */
+    void optimize_vertex_fetch(std::vector<Vertex> &vertices, std::span<uint32_t> indices);
+
+    struct MeshletStats
+    {
+        size_t meshlets = 0;
+        size_t triangles = 0;
+        size_t vertices = 0; // summed per meshlet, shared vertices count once per meshlet
+        size_t withCone = 0; // meshlets that can be cone culled
+
+        void add(const MeshletStats &other);
+    };
+
+    constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+    constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+    /**
+     * @brief Split the triangles of a surface into meshlets. Meshlets are grown greedily through shared positions,
+     * then with the nearest unused triangle until they are full, and the triangles of the surface are reordered so
+     * every meshlet is one contiguous index range.
+     *
+     * @param surfaceIndices index range of the surface, reordered in place
+     * @param indexBase position of surfaceIndices in the index array of the mesh, the meshlet ranges are relative
+     * to the mesh
+     */
+    std::vector<Meshlet> build_meshlets(std::span<uint32_t> surfaceIndices, std::span<const Vertex> vertices,
+                                        uint32_t indexBase, uint32_t maxVertices = MESHLET_MAX_VERTICES,
+                                        uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+    MeshletStats analyze_meshlets(std::span<const Meshlet> meshlets);
+
+    /**
+     * @brief Quadric error edge collapse. Vertices only move onto their neighbours, so the result indexes the same
+     * vertex array. Borders, non manifold edges and attribute seams are kept as they are.
+     *
+     * @param targetError largest allowed deviation from the source surface, in model units
+     * @param resultError if set, receives the deviation of the result
+     * @return std::vector<uint32_t> the simplified index list, it can stay above targetIndexCount when the error
+     * limit is hit first
+     */
+    std::vector<uint32_t> simplify(std::span<const uint32_t> indices, std::span<const Vertex> vertices,
+                                   size_t targetIndexCount, float targetError, float *resultError = nullptr);
+
+    constexpr uint32_t MAX_SURFACE_LODS = 6;
+
+    /**
+     * @brief Build a chain of simplified versions of a surface, each with about half the triangles of the one
+     * before. The index lists are appended to indices, the first level is the surface itself.
+     *
+     * @param maxError deviation the coarsest level may reach, in model units
+     */
+    std::vector<SurfaceLod> build_lod_chain(std::vector<uint32_t> &indices, IndexRange surface,
+                                            std::span<const Vertex> vertices, float maxError,
+                                            uint32_t maxLods = MAX_SURFACE_LODS);
+
+    struct QuantizedVertices
+    {
+        std::vector<PackedVertex> vertices;
+        VertexQuantization quantization;
+    };
+
+    /**
+     * @brief Pack vertices into the 20 byte PackedVertex layout. Positions and uvs are stored as unorm16 over the
+     * bounds of the whole vertex array.
+     *
+     * @return std::optional<QuantizedVertices> empty if the mesh would lose too much: a position rounding error above
+     * maxPositionError, a uv rounding error above maxUVError, or vertex colors outside of [0, 1].
+     */
+    std::optional<QuantizedVertices> quantize_vertices(std::span<const Vertex> vertices, float maxPositionError,
+                                                       float maxUVError);
+
+    /**
+     * @brief Run weld, vertex cache, overdraw and vertex fetch optimization on a mesh.
+     *
+     */
+    MeshOptimizationStats optimize_mesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices,
+                                        std::span<const IndexRange> surfaces);
+} // namespace meshproc
@@ -33,17 +33,18 @@ void PBREngine::init()
     creatorData.loadErrorImage = _errorCheckerboardImage;
     creatorData._device = _device;
     creatorData.gpuResourceAllocator = getGPUResourceAllocator();
-    creatorData.materialSystemReference =
-        &materialSystemInstance; // this would change to a reference from the material system in PBRShadingFeature.
+    // the shading feature draws from the same material table
+    creatorData.materialSystemReference = &materialSystemInstance;
+    creatorData.importOptions.textureCompressionBC = _textureCompressionBC;
 
-    // this is called after the pipelines are initialzed.
-    auto structureFile = loadGltf(creatorData, structurePath);
+    // textures are uploaded once something using them is on screen
+    textureStreamer.init(getGPUResourceAllocator(), _device, &materialSystemInstance, textureBudget);
+    creatorData.textureStreamer = &textureStreamer;
 
-    assert(structureFile.has_value());
-
-    loadedScenes["outpost"] = *structureFile;
-
-    structureFile.value()->name = "outpost";
+    // this is called after the pipelines are initialzed. the file loads in the background, update_scene uploads it
+    // a bit every frame and it is drawn as soon as its nodes exist
+    sceneLoader.request("outpost", structurePath, creatorData,
+                        [this](std::shared_ptr<sgraph::GLTFScene> scene) { loadedScenes["outpost"] = scene; });
 
     // testing rendergraph build.
     // testRendergraph();
@@ -52,7 +53,8 @@ void PBREngine::init()
     computeFeature = make_shared<rgraph::ComputeBackgroundFeature>(_device, _mainDeletionQueue, extent, _drawImage);
     GLTFMRMaterialSystemCreateInfo msCreateInfo = {_device, _drawImage.imageFormat, _depthImage.imageFormat,
                                                    _gpuSceneDataDescriptorLayout};
-    PBRFeature = make_shared<rgraph::PBRShadingFeature>(mainDrawContext, _device, msCreateInfo, sceneData,
+    PBRFeature = make_shared<rgraph::PBRShadingFeature>(mainDrawContext, _device, msCreateInfo,
+                                                        &materialSystemInstance, sceneData,
                                                         _gpuSceneDataDescriptorLayout, _mainDeletionQueue);
     builder.AddTrackedImage("drawImage", VK_IMAGE_LAYOUT_UNDEFINED, _drawImage);
     builder.AddTrackedImage("depthImage", VK_IMAGE_LAYOUT_UNDEFINED, _depthImage);
@@ -67,7 +69,7 @@ void PBREngine::init_pipelines()
 {
     VulkanEngine::init_pipelines();
 
-    materialSystemInstance.build_descriptors(_device);
+    materialSystemInstance.build_descriptors(_device, &_gpuResourceAllocator);
 }
 
 void PBREngine::init_default_data()
@@ -80,31 +82,19 @@ void PBREngine::init_default_data()
     materialResources.colorSampler = _defaultSamplerLinear;
     materialResources.metalRoughImage = _whiteImage;
     materialResources.metalRoughSampler = _defaultSamplerLinear;
+    materialResources.colorFactors = glm::vec4{1, 1, 1, 1};
+    materialResources.metalRoughFactors = glm::vec4{1, 0.5, 0, 0};
 
-    // set the uniform buffer for the material data
-    AllocatedBuffer materialConstants =
-        _gpuResourceAllocator.create_buffer(sizeof(GLTFMRMaterialSystem::MaterialConstants),
-                                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-    // write the buffer
-    GLTFMRMaterialSystem::MaterialConstants *sceneUniformData =
-        (GLTFMRMaterialSystem::MaterialConstants *)materialConstants.info.pMappedData;
-    sceneUniformData->colorFactors = glm::vec4{1, 1, 1, 1};
-    sceneUniformData->metal_rough_factors = glm::vec4{1, 0.5, 0, 0};
-
-    _mainDeletionQueue.push_function([=, this]() { _gpuResourceAllocator.destroy_buffer(materialConstants); });
-
-    materialResources.dataBuffer = materialConstants.buffer;
-    materialResources.dataBufferOffset = 0;
-
-    defaultData = materialSystemInstance.write_material(_device, MaterialPass::MainColor, materialResources,
-                                                        globalDescriptorAllocator);
+    defaultData = materialSystemInstance.write_material(_device, MaterialPass::MainColor, materialResources);
 }
 
 void PBREngine::cleanupOnChildren()
 {
 
+    // the loader thread has to be gone before the scenes it still holds are released
+    sceneLoader.shutdown();
     loadedScenes.clear();
+    textureStreamer.destroy();
     materialSystemInstance.clear_resources(_device);
 }
 
@@ -112,9 +102,22 @@ void PBREngine::update_scene()
 {
     auto start = std::chrono::system_clock::now();
 
+    // material table entries and texture slots released a few frames ago can be reused now
+    materialSystemInstance.begin_frame(_frameNumber);
+    // the texture budget follows what the device has left
+    _gpuResourceAllocator.update_budget(_frameNumber);
+
+    // what the renderer drew last frame decides which textures to bring in, before the draw context is reset
+    textureStreamer.update(mainDrawContext.visibleMaterials, _frameNumber, textureUploadBudget);
+
     VulkanEngine::update_scene();
 
-    loadedScenes["outpost"]->Draw(glm::mat4{1.f}, mainDrawContext);
+    sceneLoader.update(sceneUploadBudget);
+
+    // only what was added or moved since the last frame reaches the draw context
+    for (auto &[name, scene] : loadedScenes)
+        scene->Sync(glm::mat4{1.f}, renderProxies);
+    renderProxies.update_bvh();
 
     auto end = std::chrono::system_clock::now();
 
@@ -185,7 +188,8 @@ void PBREngine::testRendergraph()
     computeFeature = make_shared<rgraph::ComputeBackgroundFeature>(_device, _mainDeletionQueue, extent, _drawImage);
     GLTFMRMaterialSystemCreateInfo msCreateInfo = {_device, testDrawImage.imageFormat, testDepthImage.imageFormat,
                                                    _gpuSceneDataDescriptorLayout};
-    PBRFeature = make_shared<rgraph::PBRShadingFeature>(mainDrawContext, _device, msCreateInfo, sceneData,
+    PBRFeature = make_shared<rgraph::PBRShadingFeature>(mainDrawContext, _device, msCreateInfo,
+                                                        &materialSystemInstance, sceneData,
                                                         _gpuSceneDataDescriptorLayout, _mainDeletionQueue);
     builder.AddTrackedImage("drawImage", VK_IMAGE_LAYOUT_UNDEFINED, testDrawImage);
     builder.AddTrackedImage("depthImage", VK_IMAGE_LAYOUT_UNDEFINED, testDepthImage);
@@ -197,7 +201,6 @@ void PBREngine::testRendergraph()
 
     // destroy temp resources ----------------------------------------------------------------------------------------
     get_current_frame()._deletionQueue.flush();
-    PBRFeature.get()->getMaterialSystemReference()->clear_resources(_device);
 
     vkDestroyImageView(_device, testDrawImage.imageView, nullptr);
     _gpuResourceAllocator.destroy_image(testDrawImage.image, testDrawImage.allocation);
@@ -316,6 +319,16 @@ void PBREngine::imGuiAddParams()
         ImGui::Text("%.3f ms", lastCompleteStats.CPUFrametime);
         ImGui::NextColumn();
         ImGui::Columns(1);
+        if (sceneLoader.busy())
+            ImGui::Text("Loading scenes...");
+
+        TextureStreamerStats streamStats = textureStreamer.stats();
+        ImGui::Text("Textures resident: %u/%u (%u without fine mips), %.1f/%.1f MB", streamStats.resident,
+                    streamStats.textures, streamStats.partial, streamStats.residentBytes / (1024.f * 1024.f),
+                    streamStats.effectiveBytes / (1024.f * 1024.f));
+        MemoryBudget memory = _gpuResourceAllocator.memory_budget();
+        ImGui::Text("Device memory: %.1f/%.1f MB, mip drops %zu", memory.usage / (1024.f * 1024.f),
+                    memory.budget / (1024.f * 1024.f), streamStats.mipDrops);
 
         ImGui::Spacing();
         ImGui::SeparatorText("Render Passes");
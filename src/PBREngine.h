@@ -1,6 +1,9 @@
 #pragma once
 
+#include "AsyncSceneLoader.h"
 #include "MaterialSystem.h"
+#include "RenderProxyRegistry.h"
+#include "TextureStreamer.h"
 #include "rgraph/ComputeBackgroundFeature.h"
 #include "rgraph/PBRShadingFeature.h"
 #include "rgraph/RendergraphBuilder.h"
@@ -29,8 +32,19 @@ class PBREngine : public VulkanEngine
 
     void imGuiAddParams() override;
 
+    // proxies of the scenes in mainDrawContext. declared before the scenes, they remove their proxies when destroyed
+    RenderProxyRegistry renderProxies{mainDrawContext};
+
     // gltf data
     std::unordered_map<std::string, std::shared_ptr<sgraph::GLTFScene>> loadedScenes;
+    AsyncSceneLoader sceneLoader;
+    // bytes of textures and meshes uploaded per frame while scenes are loading
+    size_t sceneUploadBudget = 8 * 1024 * 1024;
+
+    TextureStreamer textureStreamer;
+    // gpu memory the streamed textures may use, least recently visible ones are evicted above it
+    size_t textureBudget = 512 * 1024 * 1024;
+    size_t textureUploadBudget = 8 * 1024 * 1024;
 
     rgraph::RendergraphBuilder builder;
     std::shared_ptr<rgraph::ComputeBackgroundFeature> computeFeature;
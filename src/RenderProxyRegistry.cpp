@@ -0,0 +1,172 @@
+#include "RenderProxyRegistry.h"
+#include <cassert>
+#include <utility>
+
+namespace
+{
+    SurfaceBVH::Box bvh_box(const WorldBounds &bounds)
+    {
+        return SurfaceBVH::Box{bounds.center - bounds.extents, bounds.center + bounds.extents};
+    }
+} // namespace
+
+RenderProxyRegistry::RenderProxyRegistry(DrawContext &drawContext)
+{
+    drawContext.proxies = this;
+    surfaceLists[OpaqueSurfaces].items = &drawContext.OpaqueSurfaces;
+    surfaceLists[TransparentSurfaces].items = &drawContext.TransparentSurfaces;
+    surfaceLists[HiddenSurfaces].items = &hiddenSurfaces;
+    lightLists[VisibleLights].items = &drawContext.lights;
+    lightLists[HiddenLights].items = &hiddenLights;
+}
+
+template <typename T> void RenderProxyRegistry::push(ProxyList<T> &list, uint8_t listIndex, uint32_t proxy, T item)
+{
+    slots[proxy].list = listIndex;
+    slots[proxy].index = static_cast<uint32_t>(list.items->size());
+    list.items->push_back(std::move(item));
+    list.owners.push_back(proxy);
+}
+
+template <typename T> T RenderProxyRegistry::take(ProxyList<T> &list, uint32_t proxy)
+{
+    uint32_t index = slots[proxy].index;
+    std::vector<T> &items = *list.items;
+    T item = std::move(items[index]);
+
+    // the last proxy of the array fills the hole
+    if (index + 1 != items.size())
+    {
+        items[index] = std::move(items.back());
+        list.owners[index] = list.owners.back();
+        slots[list.owners[index]].index = index;
+    }
+    items.pop_back();
+    list.owners.pop_back();
+    return item;
+}
+
+uint32_t RenderProxyRegistry::add_surface(const RenderObject &surface)
+{
+    uint32_t proxy = allocate_slot(false);
+    SurfaceList list = surface_list(surface.material);
+    push(surfaceLists[list], list, proxy, surface);
+    surfaceBvh.insert(proxy, bvh_box(surface.worldBounds));
+    return proxy;
+}
+
+void RenderProxyRegistry::update_transform(uint32_t proxy, const glm::mat4 &transform, const WorldBounds &worldBounds)
+{
+    RenderObject &object = mutable_surface(proxy);
+    object.transform = transform;
+    object.worldBounds = worldBounds;
+    surfaceBvh.update(proxy, bvh_box(worldBounds));
+}
+
+void RenderProxyRegistry::update_material(uint32_t proxy, MaterialInstance *material)
+{
+    Slot &slot = slots[proxy];
+    mutable_surface(proxy).material = material;
+
+    // hidden surfaces pick their array when they are shown again
+    SurfaceList list = surface_list(material);
+    if (slot.list == HiddenSurfaces || slot.list == list)
+        return;
+    RenderObject object = take(surfaceLists[slot.list], proxy);
+    push(surfaceLists[list], list, proxy, std::move(object));
+}
+
+uint32_t RenderProxyRegistry::add_light(const GPULightingData &light)
+{
+    uint32_t proxy = allocate_slot(true);
+    push(lightLists[VisibleLights], VisibleLights, proxy, light);
+    return proxy;
+}
+
+void RenderProxyRegistry::update_light(uint32_t proxy, const GPULightingData &light)
+{
+    const Slot &slot = slots[proxy];
+    assert(slot.light);
+    (*lightLists[slot.list].items)[slot.index] = light;
+}
+
+void RenderProxyRegistry::set_visible(uint32_t proxy, bool visible)
+{
+    Slot &slot = slots[proxy];
+    if (slot.light)
+    {
+        LightList list = visible ? VisibleLights : HiddenLights;
+        if (slot.list != list)
+            push(lightLists[list], list, proxy, take(lightLists[slot.list], proxy));
+        return;
+    }
+
+    if (visible == (slot.list != HiddenSurfaces))
+        return;
+    RenderObject object = take(surfaceLists[slot.list], proxy);
+    SurfaceList list = visible ? surface_list(object.material) : HiddenSurfaces;
+    push(surfaceLists[list], list, proxy, std::move(object));
+}
+
+void RenderProxyRegistry::remove(uint32_t proxy)
+{
+    Slot &slot = slots[proxy];
+    if (slot.light)
+        take(lightLists[slot.list], proxy);
+    else
+    {
+        take(surfaceLists[slot.list], proxy);
+        surfaceBvh.remove(proxy);
+    }
+
+    slot.index = INVALID_PROXY;
+    freeSlots.push_back(proxy);
+}
+
+uint32_t RenderProxyRegistry::allocate_slot(bool light)
+{
+    uint32_t proxy;
+    if (!freeSlots.empty())
+    {
+        proxy = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        proxy = static_cast<uint32_t>(slots.size());
+        slots.emplace_back();
+    }
+    slots[proxy].light = light;
+    return proxy;
+}
+
+void RenderProxyRegistry::cull_opaque(std::span<const glm::vec4> planes, std::vector<uint32_t> &opaqueIndices) const
+{
+    // the bvh holds hidden and transparent surfaces too, only the opaque array is wanted here
+    surfaceBvh.query_frustum(planes,
+                             [&](uint32_t proxy)
+                             {
+                                 const Slot &slot = slots[proxy];
+                                 if (slot.list == OpaqueSurfaces)
+                                     opaqueIndices.push_back(slot.index);
+                             });
+}
+
+const RenderObject &RenderProxyRegistry::surface(uint32_t proxy) const
+{
+    const Slot &slot = slots[proxy];
+    assert(!slot.light && slot.index != INVALID_PROXY);
+    return (*surfaceLists[slot.list].items)[slot.index];
+}
+
+RenderObject &RenderProxyRegistry::mutable_surface(uint32_t proxy)
+{
+    const Slot &slot = slots[proxy];
+    assert(!slot.light && slot.index != INVALID_PROXY);
+    return (*surfaceLists[slot.list].items)[slot.index];
+}
+
+RenderProxyRegistry::SurfaceList RenderProxyRegistry::surface_list(const MaterialInstance *material) const
+{
+    return material->passType == MaterialPass::Transparent ? TransparentSurfaces : OpaqueSurfaces;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include "SurfaceBVH.h"
+#include "vk_engine.h"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Retained draw list. Scene nodes register a proxy per surface and per light once, and push updates to it
+ * only when their transform, material or visibility changes. The proxies live in the arrays of the draw context, so
+ * the renderer reads them as before, but they are no longer cleared and rebuilt every frame.
+ *
+ * The arrays are kept dense: removing or hiding a proxy moves the last one of its array into its place, so the order
+ * of the arrays is not stable across removals and proxies are addressed by handle only. Hidden proxies are kept in
+ * the registry and still take updates, showing them again puts them back into the draw context.
+ *
+ * The world bounds of the surfaces are also kept in a SurfaceBVH, for culling and spatial queries that do not touch
+ * every surface.
+ *
+ */
+class RenderProxyRegistry
+{
+  public:
+    static constexpr uint32_t INVALID_PROXY = UINT32_MAX;
+
+    explicit RenderProxyRegistry(DrawContext &drawContext);
+
+    // surfaces go into the opaque or transparent array of the draw context by the pass of their material
+    uint32_t add_surface(const RenderObject &surface);
+    void update_transform(uint32_t proxy, const glm::mat4 &transform, const WorldBounds &worldBounds);
+    // moves the surface to the other array when the pass of the new material differs
+    void update_material(uint32_t proxy, MaterialInstance *material);
+
+    uint32_t add_light(const GPULightingData &light);
+    void update_light(uint32_t proxy, const GPULightingData &light);
+
+    // works for both surfaces and lights
+    void set_visible(uint32_t proxy, bool visible);
+    void remove(uint32_t proxy);
+
+    // live proxies, hidden ones included
+    size_t size() const
+    {
+        return slots.size() - freeSlots.size();
+    }
+
+    // refit or rebuild the bvh with the surfaces added, moved and removed since the last call. once per frame,
+    // after the scenes synced and before the renderer culls
+    void update_bvh()
+    {
+        surfaceBvh.commit();
+    }
+
+    /**
+     * @brief Cull the visible opaque surfaces against a frustum through the bvh.
+     *
+     * @param planes normalized planes with the inside on the positive side
+     * @param opaqueIndices receives the indices into the opaque array of the draw context of the surfaces left
+     */
+    void cull_opaque(std::span<const glm::vec4> planes, std::vector<uint32_t> &opaqueIndices) const;
+
+    // for ray and point queries, its items are surface proxies
+    const SurfaceBVH &bvh() const
+    {
+        return surfaceBvh;
+    }
+    const RenderObject &surface(uint32_t proxy) const;
+
+  private:
+    // a dense array of proxies with the handle of the proxy at every index, to fix up the slot of the one that is
+    // moved into a hole
+    template <typename T> struct ProxyList
+    {
+        std::vector<T> *items;
+        std::vector<uint32_t> owners;
+    };
+
+    enum SurfaceList : uint8_t
+    {
+        OpaqueSurfaces,
+        TransparentSurfaces,
+        HiddenSurfaces,
+    };
+    enum LightList : uint8_t
+    {
+        VisibleLights,
+        HiddenLights,
+    };
+
+    struct Slot
+    {
+        bool light = false;
+        uint8_t list = 0;
+        uint32_t index = INVALID_PROXY; // into the list, INVALID_PROXY while the slot is free
+    };
+
+    uint32_t allocate_slot(bool light);
+    RenderObject &mutable_surface(uint32_t proxy);
+    SurfaceList surface_list(const MaterialInstance *material) const;
+
+    template <typename T> void push(ProxyList<T> &list, uint8_t listIndex, uint32_t proxy, T item);
+    template <typename T> T take(ProxyList<T> &list, uint32_t proxy);
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+
+    std::vector<RenderObject> hiddenSurfaces;
+    std::vector<GPULightingData> hiddenLights;
+    std::array<ProxyList<RenderObject>, 3> surfaceLists;
+    std::array<ProxyList<GPULightingData>, 2> lightLists;
+
+    SurfaceBVH surfaceBvh;
+};
@@ -0,0 +1,49 @@
+#include "SamplerCache.h"
+#include <bit>
+
+void SamplerCache::init(VkDevice device)
+{
+    this->device = device;
+}
+
+VkSampler SamplerCache::get(const VkSamplerCreateInfo &info)
+{
+    assert(info.pNext == nullptr);
+
+    Key key = make_key(info);
+    auto it = samplers.find(key);
+    if (it != samplers.end())
+        return it->second;
+
+    VkSampler sampler;
+    VK_CHECK(vkCreateSampler(device, &info, nullptr, &sampler));
+    samplers[key] = sampler;
+    return sampler;
+}
+
+void SamplerCache::destroy()
+{
+    for (auto &[key, sampler] : samplers)
+        vkDestroySampler(device, sampler, nullptr);
+    samplers.clear();
+}
+
+SamplerCache::Key SamplerCache::make_key(const VkSamplerCreateInfo &info)
+{
+    return Key{info.flags,
+               static_cast<uint32_t>(info.magFilter),
+               static_cast<uint32_t>(info.minFilter),
+               static_cast<uint32_t>(info.mipmapMode),
+               static_cast<uint32_t>(info.addressModeU),
+               static_cast<uint32_t>(info.addressModeV),
+               static_cast<uint32_t>(info.addressModeW),
+               std::bit_cast<uint32_t>(info.mipLodBias),
+               info.anisotropyEnable,
+               std::bit_cast<uint32_t>(info.maxAnisotropy),
+               info.compareEnable,
+               static_cast<uint32_t>(info.compareOp),
+               std::bit_cast<uint32_t>(info.minLod),
+               std::bit_cast<uint32_t>(info.maxLod),
+               static_cast<uint32_t>(info.borderColor),
+               info.unnormalizedCoordinates};
+}
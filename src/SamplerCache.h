@@ -0,0 +1,39 @@
+#pragma once
+#include <array>
+#include <map>
+#include <vk_types.h>
+
+/**
+ * @brief Owns every sampler of the engine. Samplers are looked up by their full create info, so identical states share
+ * one VkSampler (and compare equal in descriptors) no matter which scene or feature asked for them. They live until
+ * the cache is destroyed.
+ *
+ */
+class SamplerCache
+{
+  public:
+    void init(VkDevice device);
+
+    /**
+     * @brief Get the sampler for a create info, creating it on first use. pNext chains are not supported.
+     *
+     */
+    VkSampler get(const VkSamplerCreateInfo &info);
+
+    uint32_t size() const
+    {
+        return static_cast<uint32_t>(samplers.size());
+    }
+
+    // destroys every sampler, all handles handed out are invalid afterwards
+    void destroy();
+
+  private:
+    // every field of VkSamplerCreateInfo after sType and pNext, floats by their bits
+    using Key = std::array<uint32_t, 16>;
+
+    static Key make_key(const VkSamplerCreateInfo &info);
+
+    VkDevice device = VK_NULL_HANDLE;
+    std::map<Key, VkSampler> samplers;
+};
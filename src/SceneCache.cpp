@@ -0,0 +1,905 @@
+#include "SceneCache.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "TextureProcessing.h"
+#include "fmt/base.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+namespace
+{
+    // bump whenever any of the records below change
+    constexpr uint32_t CACHE_VERSION = 11;
+    constexpr char CACHE_MAGIC[8] = {'V', 'K', 'S', 'C', 'A', 'C', 'H', 'E'};
+    constexpr size_t SECTION_ALIGNMENT = 16;
+
+    constexpr uint32_t fourcc(const char (&tag)[5])
+    {
+        return uint32_t(uint8_t(tag[0])) | uint32_t(uint8_t(tag[1])) << 8 | uint32_t(uint8_t(tag[2])) << 16 |
+               uint32_t(uint8_t(tag[3])) << 24;
+    }
+
+    constexpr uint32_t TAG_STRINGS = fourcc("STRS");
+    constexpr uint32_t TAG_DEPENDENCIES = fourcc("DEPS");
+    constexpr uint32_t TAG_MESHES = fourcc("MESH");
+    constexpr uint32_t TAG_SURFACES = fourcc("SURF");
+    constexpr uint32_t TAG_VERTICES = fourcc("VTXS");
+    constexpr uint32_t TAG_PACKED_VERTICES = fourcc("PVTX");
+    constexpr uint32_t TAG_INDICES = fourcc("IDXS");
+    constexpr uint32_t TAG_MESHLETS = fourcc("MSLT");
+    constexpr uint32_t TAG_LODS = fourcc("LODS");
+    constexpr uint32_t TAG_IMAGES = fourcc("IMGS");
+    constexpr uint32_t TAG_TEXELS = fourcc("TEXL");
+    constexpr uint32_t TAG_SAMPLERS = fourcc("SAMP");
+    constexpr uint32_t TAG_MATERIALS = fourcc("MATL");
+    constexpr uint32_t TAG_NODES = fourcc("NODE");
+    constexpr uint32_t TAG_CHILDREN = fourcc("CHLD");
+    constexpr uint32_t TAG_LIGHTS = fourcc("LGHT");
+    constexpr uint32_t TAG_OPTIONS = fourcc("OPTS");
+
+    // {{{ FILE RECORDS - everything below is written to disk as is
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t sectionCount;
+        uint64_t tableOffset;
+    };
+
+    struct SectionEntry
+    {
+        uint32_t tag;
+        uint32_t elementSize;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    // byte range in the STRS section
+    struct StringRef
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct DependencyRecord
+    {
+        StringRef path; // relative to the cache file
+        uint64_t size;
+        int64_t writeTime;
+        uint64_t hash;
+    };
+
+    struct MeshRecord
+    {
+        StringRef name;
+        uint32_t firstSurface;
+        uint32_t surfaceCount;
+        uint32_t vertexFormat;
+        uint32_t pad;
+        uint64_t firstVertex; // into VTXS or PVTX, depending on the format
+        uint64_t vertexCount;
+        uint64_t firstIndex;
+        uint64_t indexCount;
+        uint64_t firstMeshlet;
+        uint64_t meshletCount;
+        uint64_t firstLod;
+        uint64_t lodCount;
+        float quantization[12];
+    };
+
+    struct SurfaceRecord
+    {
+        uint32_t startIndex;
+        uint32_t count;
+        uint32_t materialIndex;
+        float origin[3];
+        float extents[3];
+        float sphereRadius;
+        uint32_t firstMeshlet; // relative to the meshlets of the mesh
+        uint32_t meshletCount;
+        uint32_t firstLod; // relative to the lods of the mesh
+        uint32_t lodCount;
+    };
+
+    struct ImageRecord
+    {
+        StringRef name;
+        uint32_t width;
+        uint32_t height;
+        uint32_t depth;
+        uint32_t format;
+        uint32_t mipLevels;
+        uint32_t pad;
+        uint32_t swizzle[4];
+        uint64_t contentHash;
+        uint64_t texelOffset;
+        uint64_t texelSize; // 0 if the image failed to decode
+    };
+
+    struct SamplerRecord
+    {
+        uint32_t magFilter;
+        uint32_t minFilter;
+        uint32_t mipmapMode;
+    };
+
+    struct MaterialRecord
+    {
+        StringRef name;
+        float colorFactors[4];
+        float metalRoughFactors[4];
+        uint32_t passType;
+        int32_t colorImage;
+        int32_t colorSampler;
+        int32_t metalRoughImage;
+        int32_t metalRoughSampler;
+    };
+
+    struct NodeRecord
+    {
+        StringRef name;
+        int32_t mesh;
+        int32_t light;
+        float localTransform[16];
+        uint32_t firstChild;
+        uint32_t childCount;
+    };
+
+    // the ImportOptions the scene was baked with
+    struct OptionsRecord
+    {
+        uint32_t optimizeMeshes;
+        uint32_t quantizeVertices;
+        float maxPositionError;
+        float maxUVError;
+        uint32_t buildMeshlets;
+        uint32_t buildLods;
+        float lodMaxError;
+        uint32_t generateMips;
+        uint32_t compressTextures;
+        uint32_t textureCompressionBC;
+    };
+
+    struct LightRecord
+    {
+        StringRef name;
+        float color[3];
+        float intensity;
+        float range;
+        float innerConeAngle;
+        float outerConeAngle;
+        uint32_t type;
+    };
+
+    // }}} FILE RECORDS end
+
+    struct FileStamp
+    {
+        uint64_t size;
+        int64_t writeTime;
+    };
+
+    std::optional<FileStamp> stamp_file(const std::filesystem::path &path)
+    {
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(path, ec);
+        if (ec)
+            return {};
+        auto writeTime = std::filesystem::last_write_time(path, ec);
+        if (ec)
+            return {};
+        return FileStamp{size, static_cast<int64_t>(writeTime.time_since_epoch().count())};
+    }
+
+    std::optional<uint64_t> hash_file(const std::filesystem::path &path)
+    {
+        std::shared_ptr<MappedFile> file = MappedFile::open(path);
+        if (!file)
+            return {};
+        return hash_bytes(file->bytes().data(), file->bytes().size());
+    }
+
+    // {{{ WRITER
+
+    class CacheWriter
+    {
+      public:
+        StringRef add_string(const std::string &str)
+        {
+            StringRef ref{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(str.size())};
+            strings.insert(strings.end(), str.begin(), str.end());
+            return ref;
+        }
+
+        // records are copied into the writer
+        template <typename T> void add_records(uint32_t tag, std::vector<T> &&records)
+        {
+            auto owned = std::make_shared<std::vector<T>>(std::move(records));
+            Section &section = sections.emplace_back(Section{tag, sizeof(T), 0, {}, {}});
+            section.chunks.push_back(std::as_bytes(std::span<const T>(*owned)));
+            section.owner = owned;
+        }
+
+        // blob sections only reference the data, it has to stay alive until finish is called
+        void begin_blob(uint32_t tag, uint32_t elementSize)
+        {
+            sections.push_back(Section{tag, elementSize, 0, {}, {}});
+        }
+
+        // returns the byte offset of the data inside the current blob section
+        uint64_t append_blob(std::span<const std::byte> data, size_t alignment = 1)
+        {
+            Section &section = sections.back();
+            uint64_t offset = section.size;
+            uint64_t padding = (alignment - offset % alignment) % alignment;
+            if (padding > 0)
+            {
+                static const std::byte zeros[SECTION_ALIGNMENT] = {};
+                section.chunks.push_back(std::span<const std::byte>(zeros, padding));
+                offset += padding;
+            }
+            section.chunks.push_back(data);
+            section.size = offset + data.size();
+            return offset;
+        }
+
+        bool finish(const std::filesystem::path &path)
+        {
+            Section &stringSection = sections.emplace_back(Section{TAG_STRINGS, 1, 0, {}, {}});
+            stringSection.chunks.push_back(std::as_bytes(std::span<const char>(strings)));
+
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+
+            FileHeader header{};
+            memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+            header.version = CACHE_VERSION;
+            header.sectionCount = static_cast<uint32_t>(sections.size());
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+            uint64_t position = sizeof(header);
+            std::vector<SectionEntry> table;
+            for (Section &section : sections)
+            {
+                position += pad_to_alignment(out, position);
+
+                SectionEntry entry{section.tag, section.elementSize, position, 0};
+                for (std::span<const std::byte> chunk : section.chunks)
+                {
+                    out.write(reinterpret_cast<const char *>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+                    entry.size += chunk.size();
+                }
+                position += entry.size;
+                table.push_back(entry);
+            }
+
+            position += pad_to_alignment(out, position);
+            header.tableOffset = position;
+            out.write(reinterpret_cast<const char *>(table.data()),
+                      static_cast<std::streamsize>(table.size() * sizeof(SectionEntry)));
+
+            // patch the table location into the header now that we know it
+            out.seekp(0);
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            return out.good();
+        }
+
+      private:
+        struct Section
+        {
+            uint32_t tag;
+            uint32_t elementSize;
+            uint64_t size = 0;
+            std::vector<std::span<const std::byte>> chunks;
+            std::shared_ptr<const void> owner;
+        };
+
+        static uint64_t pad_to_alignment(std::ofstream &out, uint64_t position)
+        {
+            static const char zeros[SECTION_ALIGNMENT] = {};
+            uint64_t padding = (SECTION_ALIGNMENT - position % SECTION_ALIGNMENT) % SECTION_ALIGNMENT;
+            out.write(zeros, static_cast<std::streamsize>(padding));
+            return padding;
+        }
+
+        std::vector<Section> sections;
+        std::vector<char> strings;
+    };
+
+    // }}} WRITER end
+
+    // {{{ READER
+
+    class CacheReader
+    {
+      public:
+        bool open(const std::filesystem::path &path)
+        {
+            file = MappedFile::open(path);
+            if (!file)
+                return false;
+
+            bytes = file->bytes();
+            if (bytes.size() < sizeof(FileHeader))
+                return false;
+
+            FileHeader header;
+            memcpy(&header, bytes.data(), sizeof(header));
+            if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION)
+                return false;
+
+            if (!in_range(header.tableOffset, uint64_t(header.sectionCount) * sizeof(SectionEntry)))
+                return false;
+
+            table.resize(header.sectionCount);
+            memcpy(table.data(), bytes.data() + header.tableOffset, table.size() * sizeof(SectionEntry));
+            for (const SectionEntry &entry : table)
+            {
+                if (!in_range(entry.offset, entry.size))
+                    return false;
+            }
+
+            strings = section(TAG_STRINGS);
+            return true;
+        }
+
+        std::span<const std::byte> section(uint32_t tag) const
+        {
+            for (const SectionEntry &entry : table)
+            {
+                if (entry.tag == tag)
+                    return bytes.subspan(entry.offset, entry.size);
+            }
+            return {};
+        }
+
+        // typed view of a section, empty if it is missing. false if it was written with a different record layout
+        template <typename T> bool records(uint32_t tag, std::span<const T> &out) const
+        {
+            out = {};
+            for (const SectionEntry &entry : table)
+            {
+                if (entry.tag != tag)
+                    continue;
+                if (entry.elementSize != sizeof(T) || entry.size % sizeof(T) != 0)
+                    return false;
+                out = {reinterpret_cast<const T *>(bytes.data() + entry.offset), entry.size / sizeof(T)};
+                return true;
+            }
+            return true;
+        }
+
+        std::string string(StringRef ref) const
+        {
+            if (uint64_t(ref.offset) + ref.length > strings.size())
+                return {};
+            return std::string(reinterpret_cast<const char *>(strings.data()) + ref.offset, ref.length);
+        }
+
+        template <typename T> SharedSpan<T> shared(std::span<const T> data) const
+        {
+            return SharedSpan<T>{data, file};
+        }
+
+      private:
+        bool in_range(uint64_t offset, uint64_t size) const
+        {
+            return offset <= bytes.size() && size <= bytes.size() - offset;
+        }
+
+        std::shared_ptr<MappedFile> file;
+        std::span<const std::byte> bytes;
+        std::span<const std::byte> strings;
+        std::vector<SectionEntry> table;
+    };
+
+    // }}} READER end
+
+    // first and count describe a range within an array of size elements
+    bool range_in_bounds(uint64_t first, uint64_t count, uint64_t size)
+    {
+        return first <= size && count <= size - first;
+    }
+
+    // -1 or an index into an array of count elements
+    bool optional_index_in_bounds(int32_t index, size_t count)
+    {
+        return index == -1 || (index >= 0 && size_t(index) < count);
+    }
+
+    // every node is the child of at most one other and is reached from the nodes without a parent, so walking the
+    // hierarchy down from those visits each node exactly once
+    bool node_hierarchy_is_forest(const std::vector<ImportedNode> &nodes)
+    {
+        std::vector<uint8_t> hasParent(nodes.size(), 0);
+        for (const ImportedNode &node : nodes)
+        {
+            for (uint32_t child : node.children)
+            {
+                if (hasParent[child])
+                    return false;
+                hasParent[child] = 1;
+            }
+        }
+
+        // nodes on a cycle all have a parent, they are the ones the walk never reaches
+        std::vector<uint32_t> stack;
+        for (uint32_t i = 0; i < nodes.size(); i++)
+        {
+            if (!hasParent[i])
+                stack.push_back(i);
+        }
+        size_t reached = 0;
+        while (!stack.empty())
+        {
+            uint32_t index = stack.back();
+            stack.pop_back();
+            reached++;
+            stack.insert(stack.end(), nodes[index].children.begin(), nodes[index].children.end());
+        }
+        return reached == nodes.size();
+    }
+
+    bool dependencies_unchanged(const CacheReader &reader, const std::filesystem::path &cacheDirectory)
+    {
+        std::span<const DependencyRecord> dependencies;
+        if (!reader.records(TAG_DEPENDENCIES, dependencies) || dependencies.empty())
+            return false;
+
+        for (const DependencyRecord &dependency : dependencies)
+        {
+            std::filesystem::path path = cacheDirectory / reader.string(dependency.path);
+
+            std::optional<FileStamp> stamp = stamp_file(path);
+            if (!stamp.has_value() || stamp->size != dependency.size)
+                return false;
+
+            // same size and write time, trust it without reading the whole file again
+            if (stamp->writeTime == dependency.writeTime)
+                continue;
+
+            // touched but maybe not changed (a fresh checkout for example), compare contents
+            std::optional<uint64_t> hash = hash_file(path);
+            if (!hash.has_value() || *hash != dependency.hash)
+                return false;
+        }
+        return true;
+    }
+} // namespace
+
+std::filesystem::path scenecache::cache_path(const std::filesystem::path &sourcePath)
+{
+    std::filesystem::path path = sourcePath;
+    path += ".vkcache";
+    return path;
+}
+
+std::optional<ImportedScene> scenecache::read(const std::filesystem::path &cachePath)
+{
+    CacheReader reader;
+    if (!reader.open(cachePath))
+        return {};
+
+    if (!dependencies_unchanged(reader, cachePath.parent_path()))
+    {
+        fmt::println("Scene cache {} is out of date", cachePath.string());
+        return {};
+    }
+
+    ImportedScene scene;
+
+    std::span<const OptionsRecord> options;
+    std::span<const DependencyRecord> dependencies;
+    std::span<const Vertex> vertices;
+    std::span<const PackedVertex> packedVertices;
+    std::span<const uint32_t> indices;
+    std::span<const Meshlet> meshlets;
+    std::span<const SurfaceLod> lods;
+    std::span<const SurfaceRecord> surfaces;
+    std::span<const MeshRecord> meshes;
+    std::span<const uint8_t> texels;
+    std::span<const ImageRecord> images;
+    std::span<const SamplerRecord> samplers;
+    std::span<const MaterialRecord> materials;
+    std::span<const uint32_t> children;
+    std::span<const NodeRecord> nodes;
+    std::span<const LightRecord> lights;
+    if (!reader.records(TAG_OPTIONS, options) || !reader.records(TAG_DEPENDENCIES, dependencies) ||
+        !reader.records(TAG_VERTICES, vertices) || !reader.records(TAG_PACKED_VERTICES, packedVertices) ||
+        !reader.records(TAG_INDICES, indices) || !reader.records(TAG_MESHLETS, meshlets) ||
+        !reader.records(TAG_LODS, lods) || !reader.records(TAG_SURFACES, surfaces) ||
+        !reader.records(TAG_MESHES, meshes) || !reader.records(TAG_TEXELS, texels) ||
+        !reader.records(TAG_IMAGES, images) || !reader.records(TAG_SAMPLERS, samplers) ||
+        !reader.records(TAG_MATERIALS, materials) || !reader.records(TAG_CHILDREN, children) ||
+        !reader.records(TAG_NODES, nodes) || !reader.records(TAG_LIGHTS, lights))
+    {
+        fmt::println("Scene cache {} was written with a different record layout", cachePath.string());
+        return {};
+    }
+
+    if (options.size() != 1)
+        return {};
+    scene.options.optimizeMeshes = options[0].optimizeMeshes != 0;
+    scene.options.quantizeVertices = options[0].quantizeVertices != 0;
+    scene.options.maxPositionError = options[0].maxPositionError;
+    scene.options.maxUVError = options[0].maxUVError;
+    scene.options.buildMeshlets = options[0].buildMeshlets != 0;
+    scene.options.buildLods = options[0].buildLods != 0;
+    scene.options.lodMaxError = options[0].lodMaxError;
+    scene.options.generateMips = options[0].generateMips != 0;
+    scene.options.compressTextures = options[0].compressTextures != 0;
+    scene.options.textureCompressionBC = options[0].textureCompressionBC != 0;
+
+    for (const DependencyRecord &dependency : dependencies)
+        scene.sourceFiles.push_back(cachePath.parent_path() / reader.string(dependency.path));
+
+    // everything below indexes into the arrays of the cache, a corrupt or tampered file must not reach past them
+    for (const MeshRecord &record : meshes)
+    {
+        bool packed = static_cast<VertexFormat>(record.vertexFormat) == VertexFormat::Packed;
+        size_t availableVertices = packed ? packedVertices.size() : vertices.size();
+        if (!range_in_bounds(record.firstVertex, record.vertexCount, availableVertices) ||
+            !range_in_bounds(record.firstIndex, record.indexCount, indices.size()) ||
+            !range_in_bounds(record.firstMeshlet, record.meshletCount, meshlets.size()) ||
+            !range_in_bounds(record.firstLod, record.lodCount, lods.size()) ||
+            !range_in_bounds(record.firstSurface, record.surfaceCount, surfaces.size()))
+            return {};
+
+        ImportedMesh mesh;
+        mesh.name = reader.string(record.name);
+        mesh.vertexFormat = packed ? VertexFormat::Packed : VertexFormat::Float;
+        if (packed)
+            mesh.packedVertices = reader.shared(packedVertices.subspan(record.firstVertex, record.vertexCount));
+        else
+            mesh.vertices = reader.shared(vertices.subspan(record.firstVertex, record.vertexCount));
+        memcpy(&mesh.quantization, record.quantization, sizeof(record.quantization));
+        mesh.indices = reader.shared(indices.subspan(record.firstIndex, record.indexCount));
+        mesh.meshlets = reader.shared(meshlets.subspan(record.firstMeshlet, record.meshletCount));
+        mesh.lods = reader.shared(lods.subspan(record.firstLod, record.lodCount));
+
+        // the shaders fetch vertices by index through their buffer address, nothing on the gpu bounds checks them
+        if (!mesh.indices.data.empty() &&
+            *std::max_element(mesh.indices.data.begin(), mesh.indices.data.end()) >= record.vertexCount)
+            return {};
+        for (const Meshlet &meshlet : mesh.meshlets.data)
+        {
+            if (!range_in_bounds(meshlet.firstIndex, meshlet.indexCount, record.indexCount))
+                return {};
+        }
+        for (const SurfaceLod &lod : mesh.lods.data)
+        {
+            if (!range_in_bounds(lod.firstIndex, lod.indexCount, record.indexCount))
+                return {};
+        }
+
+        for (const SurfaceRecord &s : surfaces.subspan(record.firstSurface, record.surfaceCount))
+        {
+            if (!range_in_bounds(s.startIndex, s.count, record.indexCount) ||
+                !range_in_bounds(s.firstMeshlet, s.meshletCount, record.meshletCount) ||
+                !range_in_bounds(s.firstLod, s.lodCount, record.lodCount) || s.materialIndex >= materials.size())
+                return {};
+
+            ImportedSurface surface;
+            surface.startIndex = s.startIndex;
+            surface.count = s.count;
+            surface.materialIndex = s.materialIndex;
+            surface.bounds.origin = glm::vec3(s.origin[0], s.origin[1], s.origin[2]);
+            surface.bounds.extents = glm::vec3(s.extents[0], s.extents[1], s.extents[2]);
+            surface.bounds.sphereRadius = s.sphereRadius;
+            surface.firstMeshlet = s.firstMeshlet;
+            surface.meshletCount = s.meshletCount;
+            surface.firstLod = s.firstLod;
+            surface.lodCount = s.lodCount;
+            mesh.surfaces.push_back(surface);
+        }
+        scene.meshes.push_back(std::move(mesh));
+    }
+
+    for (const ImageRecord &record : images)
+    {
+        if (!range_in_bounds(record.texelOffset, record.texelSize, texels.size()))
+            return {};
+
+        // images that failed to decode have no texels, the others have to hold exactly their mip chain
+        VkExtent3D extent = {record.width, record.height, record.depth};
+        VkFormat format = static_cast<VkFormat>(record.format);
+        if (record.texelSize > 0 &&
+            (extent.width == 0 || extent.height == 0 || extent.depth == 0 || !texproc::is_supported_format(format) ||
+             record.mipLevels == 0 || record.mipLevels > texproc::mip_level_count(extent) ||
+             record.texelSize != texproc::mip_chain_size(format, extent, record.mipLevels)))
+            return {};
+
+        ImportedImage image;
+        image.name = reader.string(record.name);
+        image.extent = extent;
+        image.format = format;
+        image.mipLevels = record.mipLevels;
+        image.swizzle = {static_cast<VkComponentSwizzle>(record.swizzle[0]),
+                         static_cast<VkComponentSwizzle>(record.swizzle[1]),
+                         static_cast<VkComponentSwizzle>(record.swizzle[2]),
+                         static_cast<VkComponentSwizzle>(record.swizzle[3])};
+        image.contentHash = record.contentHash;
+        if (record.texelSize > 0)
+            image.texels = reader.shared(texels.subspan(record.texelOffset, record.texelSize));
+        scene.images.push_back(std::move(image));
+    }
+
+    for (const SamplerRecord &record : samplers)
+    {
+        scene.samplers.push_back(ImportedSampler{static_cast<VkFilter>(record.magFilter),
+                                                 static_cast<VkFilter>(record.minFilter),
+                                                 static_cast<VkSamplerMipmapMode>(record.mipmapMode)});
+    }
+
+    for (const MaterialRecord &record : materials)
+    {
+        if (!optional_index_in_bounds(record.colorImage, images.size()) ||
+            !optional_index_in_bounds(record.colorSampler, samplers.size()) ||
+            !optional_index_in_bounds(record.metalRoughImage, images.size()) ||
+            !optional_index_in_bounds(record.metalRoughSampler, samplers.size()))
+            return {};
+
+        ImportedMaterial material;
+        material.name = reader.string(record.name);
+        memcpy(&material.colorFactors, record.colorFactors, sizeof(record.colorFactors));
+        memcpy(&material.metalRoughFactors, record.metalRoughFactors, sizeof(record.metalRoughFactors));
+        material.passType = static_cast<MaterialPass>(record.passType);
+        material.colorImage = record.colorImage;
+        material.colorSampler = record.colorSampler;
+        material.metalRoughImage = record.metalRoughImage;
+        material.metalRoughSampler = record.metalRoughSampler;
+        scene.materials.push_back(std::move(material));
+    }
+
+    for (const NodeRecord &record : nodes)
+    {
+        if (!range_in_bounds(record.firstChild, record.childCount, children.size()) ||
+            !optional_index_in_bounds(record.mesh, meshes.size()) ||
+            !optional_index_in_bounds(record.light, lights.size()))
+            return {};
+
+        ImportedNode node;
+        node.name = reader.string(record.name);
+        node.mesh = record.mesh;
+        node.light = record.light;
+        memcpy(&node.localTransform, record.localTransform, sizeof(record.localTransform));
+        std::span<const uint32_t> nodeChildren = children.subspan(record.firstChild, record.childCount);
+        for (uint32_t child : nodeChildren)
+        {
+            if (child >= nodes.size())
+                return {};
+        }
+        node.children.assign(nodeChildren.begin(), nodeChildren.end());
+        scene.nodes.push_back(std::move(node));
+    }
+    if (!node_hierarchy_is_forest(scene.nodes))
+        return {};
+
+    for (const LightRecord &record : lights)
+    {
+        LightingData light;
+        light.name = reader.string(record.name);
+        light.color = glm::vec3(record.color[0], record.color[1], record.color[2]);
+        light.intensity = record.intensity;
+        light.range = record.range;
+        light.innerConeAngle = record.innerConeAngle;
+        light.outerConeAngle = record.outerConeAngle;
+        light.type = static_cast<LightingData::LightType>(record.type);
+        scene.lights.push_back(std::move(light));
+    }
+
+    return scene;
+}
+
+bool scenecache::write(const std::filesystem::path &cachePath, const ImportedScene &scene)
+{
+    CacheWriter writer;
+    std::filesystem::path cacheDirectory = cachePath.parent_path();
+
+    std::vector<DependencyRecord> dependencies;
+    for (const std::filesystem::path &source : scene.sourceFiles)
+    {
+        std::optional<FileStamp> stamp = stamp_file(source);
+        std::optional<uint64_t> hash = hash_file(source);
+        if (!stamp.has_value() || !hash.has_value())
+            return false;
+
+        std::error_code ec;
+        std::filesystem::path relative = std::filesystem::relative(source, cacheDirectory, ec);
+        if (ec || relative.empty())
+            relative = std::filesystem::absolute(source);
+
+        dependencies.push_back(
+            DependencyRecord{writer.add_string(relative.generic_string()), stamp->size, stamp->writeTime, *hash});
+    }
+    writer.add_records(TAG_DEPENDENCIES, std::move(dependencies));
+
+    writer.add_records(TAG_OPTIONS,
+                       std::vector<OptionsRecord>{{scene.options.optimizeMeshes ? 1u : 0u,
+                                                   scene.options.quantizeVertices ? 1u : 0u,
+                                                   scene.options.maxPositionError,
+                                                   scene.options.maxUVError,
+                                                   scene.options.buildMeshlets ? 1u : 0u,
+                                                   scene.options.buildLods ? 1u : 0u,
+                                                   scene.options.lodMaxError,
+                                                   scene.options.generateMips ? 1u : 0u,
+                                                   scene.options.compressTextures ? 1u : 0u,
+                                                   scene.options.textureCompressionBC ? 1u : 0u}});
+
+    std::vector<MeshRecord> meshes;
+    std::vector<SurfaceRecord> surfaces;
+    uint64_t vertexCount = 0, packedVertexCount = 0, indexCount = 0, meshletCount = 0, lodCount = 0;
+    for (const ImportedMesh &mesh : scene.meshes)
+    {
+        bool packed = mesh.vertexFormat == VertexFormat::Packed;
+
+        MeshRecord record{};
+        record.name = writer.add_string(mesh.name);
+        record.firstSurface = static_cast<uint32_t>(surfaces.size());
+        record.surfaceCount = static_cast<uint32_t>(mesh.surfaces.size());
+        record.vertexFormat = static_cast<uint32_t>(mesh.vertexFormat);
+        record.firstVertex = packed ? packedVertexCount : vertexCount;
+        record.vertexCount = packed ? mesh.packedVertices.data.size() : mesh.vertices.data.size();
+        record.firstIndex = indexCount;
+        record.indexCount = mesh.indices.data.size();
+        record.firstMeshlet = meshletCount;
+        record.meshletCount = mesh.meshlets.data.size();
+        record.firstLod = lodCount;
+        record.lodCount = mesh.lods.data.size();
+        memcpy(record.quantization, &mesh.quantization, sizeof(record.quantization));
+        meshes.push_back(record);
+
+        (packed ? packedVertexCount : vertexCount) += record.vertexCount;
+        indexCount += record.indexCount;
+        meshletCount += record.meshletCount;
+        lodCount += record.lodCount;
+
+        for (const ImportedSurface &surface : mesh.surfaces)
+        {
+            const Bounds &b = surface.bounds;
+            surfaces.push_back(SurfaceRecord{surface.startIndex,
+                                             surface.count,
+                                             surface.materialIndex,
+                                             {b.origin.x, b.origin.y, b.origin.z},
+                                             {b.extents.x, b.extents.y, b.extents.z},
+                                             b.sphereRadius,
+                                             surface.firstMeshlet,
+                                             surface.meshletCount,
+                                             surface.firstLod,
+                                             surface.lodCount});
+        }
+    }
+    writer.add_records(TAG_MESHES, std::move(meshes));
+    writer.add_records(TAG_SURFACES, std::move(surfaces));
+
+    writer.begin_blob(TAG_VERTICES, sizeof(Vertex));
+    for (const ImportedMesh &mesh : scene.meshes)
+        writer.append_blob(std::as_bytes(mesh.vertices.data));
+
+    writer.begin_blob(TAG_PACKED_VERTICES, sizeof(PackedVertex));
+    for (const ImportedMesh &mesh : scene.meshes)
+        writer.append_blob(std::as_bytes(mesh.packedVertices.data));
+
+    writer.begin_blob(TAG_INDICES, sizeof(uint32_t));
+    for (const ImportedMesh &mesh : scene.meshes)
+        writer.append_blob(std::as_bytes(mesh.indices.data));
+
+    writer.begin_blob(TAG_MESHLETS, sizeof(Meshlet));
+    for (const ImportedMesh &mesh : scene.meshes)
+        writer.append_blob(std::as_bytes(mesh.meshlets.data));
+
+    writer.begin_blob(TAG_LODS, sizeof(SurfaceLod));
+    for (const ImportedMesh &mesh : scene.meshes)
+        writer.append_blob(std::as_bytes(mesh.lods.data));
+
+    std::vector<ImageRecord> images;
+    writer.begin_blob(TAG_TEXELS, 1);
+    for (const ImportedImage &image : scene.images)
+    {
+        ImageRecord record{};
+        record.name = writer.add_string(image.name);
+        record.width = image.extent.width;
+        record.height = image.extent.height;
+        record.depth = image.extent.depth;
+        record.format = static_cast<uint32_t>(image.format);
+        record.mipLevels = image.mipLevels;
+        record.swizzle[0] = static_cast<uint32_t>(image.swizzle.r);
+        record.swizzle[1] = static_cast<uint32_t>(image.swizzle.g);
+        record.swizzle[2] = static_cast<uint32_t>(image.swizzle.b);
+        record.swizzle[3] = static_cast<uint32_t>(image.swizzle.a);
+        record.contentHash = image.contentHash;
+        // the levels are written back to back, whatever order the file they were imported from has them in
+        std::vector<std::span<const uint8_t>> levels = image.level_spans();
+        for (size_t level = 0; level < levels.size(); level++)
+        {
+            uint64_t offset = writer.append_blob(std::as_bytes(levels[level]), level == 0 ? SECTION_ALIGNMENT : 1);
+            if (level == 0)
+                record.texelOffset = offset;
+            record.texelSize += levels[level].size();
+        }
+        images.push_back(record);
+    }
+    writer.add_records(TAG_IMAGES, std::move(images));
+
+    std::vector<SamplerRecord> samplers;
+    for (const ImportedSampler &sampler : scene.samplers)
+    {
+        samplers.push_back(SamplerRecord{static_cast<uint32_t>(sampler.magFilter),
+                                         static_cast<uint32_t>(sampler.minFilter),
+                                         static_cast<uint32_t>(sampler.mipmapMode)});
+    }
+    writer.add_records(TAG_SAMPLERS, std::move(samplers));
+
+    std::vector<MaterialRecord> materials;
+    for (const ImportedMaterial &material : scene.materials)
+    {
+        MaterialRecord record{};
+        record.name = writer.add_string(material.name);
+        memcpy(record.colorFactors, &material.colorFactors, sizeof(record.colorFactors));
+        memcpy(record.metalRoughFactors, &material.metalRoughFactors, sizeof(record.metalRoughFactors));
+        record.passType = static_cast<uint32_t>(material.passType);
+        record.colorImage = material.colorImage;
+        record.colorSampler = material.colorSampler;
+        record.metalRoughImage = material.metalRoughImage;
+        record.metalRoughSampler = material.metalRoughSampler;
+        materials.push_back(record);
+    }
+    writer.add_records(TAG_MATERIALS, std::move(materials));
+
+    std::vector<NodeRecord> nodes;
+    std::vector<uint32_t> children;
+    for (const ImportedNode &node : scene.nodes)
+    {
+        NodeRecord record{};
+        record.name = writer.add_string(node.name);
+        record.mesh = node.mesh;
+        record.light = node.light;
+        memcpy(record.localTransform, &node.localTransform, sizeof(record.localTransform));
+        record.firstChild = static_cast<uint32_t>(children.size());
+        record.childCount = static_cast<uint32_t>(node.children.size());
+        children.insert(children.end(), node.children.begin(), node.children.end());
+        nodes.push_back(record);
+    }
+    writer.add_records(TAG_NODES, std::move(nodes));
+    writer.add_records(TAG_CHILDREN, std::move(children));
+
+    std::vector<LightRecord> lights;
+    for (const LightingData &light : scene.lights)
+    {
+        LightRecord record{};
+        record.name = writer.add_string(light.name);
+        record.color[0] = light.color.x;
+        record.color[1] = light.color.y;
+        record.color[2] = light.color.z;
+        record.intensity = light.intensity;
+        record.range = light.range;
+        record.innerConeAngle = light.innerConeAngle;
+        record.outerConeAngle = light.outerConeAngle;
+        record.type = static_cast<uint32_t>(light.type);
+        lights.push_back(record);
+    }
+    writer.add_records(TAG_LIGHTS, std::move(lights));
+
+    std::filesystem::path tmpPath = cachePath;
+    tmpPath += ".tmp";
+    if (!writer.finish(tmpPath))
+    {
+        std::filesystem::remove(tmpPath);
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, cachePath, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+
+    fmt::println("Wrote scene cache {}", cachePath.string());
+    return true;
+}
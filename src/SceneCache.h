@@ -0,0 +1,39 @@
+#pragma once
+#include "vk_loader.h"
+#include <filesystem>
+#include <optional>
+
+/**
+ * @brief Baked binary copy of an imported gltf scene. The file is a small header, a table of tagged sections and the
+ * section payloads, all little endian and 16 byte aligned so that vertex, index and texel data can be handed straight
+ * from the memory mapping to the staging copies.
+ *
+ * A cache records every file the scene was imported from (size, write time and a content hash), and is only used
+ * while all of them are unchanged.
+ *
+ */
+namespace scenecache
+{
+    /**
+     * @brief Location of the cache for a source file, next to it with an extra .vkcache extension.
+     *
+     */
+    std::filesystem::path cache_path(const std::filesystem::path &sourcePath);
+
+    /**
+     * @brief Map a cache file and read the scene from it. The mesh and image data in the returned scene points into
+     * the mapping, which stays alive for as long as any of it is referenced.
+     *
+     * @return std::optional<ImportedScene> empty if the cache is missing, from another version, or any of its source
+     * files changed.
+     */
+    std::optional<ImportedScene> read(const std::filesystem::path &cachePath);
+
+    /**
+     * @brief Write the scene to a cache file. The file is written next to the destination and renamed into place, so
+     * a crashed write never leaves a truncated cache behind.
+     *
+     * @return true if the cache was written.
+     */
+    bool write(const std::filesystem::path &cachePath, const ImportedScene &scene);
+} // namespace scenecache
@@ -0,0 +1,54 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+/**
+ * @brief Bounded lock-free queue for exactly one producer thread and one consumer thread. push and pop never block,
+ * they fail when the queue is full or empty instead.
+ *
+ */
+template <typename T, size_t Capacity> class SpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+  public:
+    // producer side
+    bool push(T &&value)
+    {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - headIndex.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        slots[tail & (Capacity - 1)] = std::move(value);
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    std::optional<T> pop()
+    {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailIndex.load(std::memory_order_acquire))
+            return {};
+
+        std::optional<T> value = std::move(slots[head & (Capacity - 1)]);
+        slots[head & (Capacity - 1)].reset();
+        headIndex.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+    bool empty() const
+    {
+        return headIndex.load(std::memory_order_acquire) == tailIndex.load(std::memory_order_acquire);
+    }
+
+  private:
+    std::array<std::optional<T>, Capacity> slots;
+    // both only ever grow, the slot is the index modulo the capacity. kept on separate cache lines so the two
+    // threads do not fight over one
+    alignas(64) std::atomic<size_t> headIndex{0};
+    alignas(64) std::atomic<size_t> tailIndex{0};
+};
@@ -0,0 +1,320 @@
+#include "SurfaceBVH.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    glm::vec3 centroid(const SurfaceBVH::Box &box)
+    {
+        return (box.min + box.max) * 0.5f;
+    }
+
+    // distance along the ray to where it enters the box, or a negative value when it misses it within maxDistance
+    float ray_box(const SurfaceBVH::Box &box, const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                  float maxDistance)
+    {
+        glm::vec3 t0 = (box.min - origin) * inverseDirection;
+        glm::vec3 t1 = (box.max - origin) * inverseDirection;
+        glm::vec3 near = glm::min(t0, t1);
+        glm::vec3 far = glm::max(t0, t1);
+        float enter = std::max({near.x, near.y, near.z, 0.f});
+        float exit = std::min({far.x, far.y, far.z, maxDistance});
+        return enter <= exit ? enter : -1.f;
+    }
+} // namespace
+
+void SurfaceBVH::insert(uint32_t item, const Box &box)
+{
+    if (item >= itemBoxes.size())
+    {
+        itemBoxes.resize(item + 1);
+        leafOf.resize(item + 1, NOT_IN_TREE);
+        moved.resize(item + 1, 0);
+        movedItems.resize(item + 1);
+    }
+    assert(leafOf[item] == NOT_IN_TREE);
+
+    itemBoxes[item] = box;
+    leafOf[item] = PENDING;
+    pending.push_back(item);
+}
+
+void SurfaceBVH::remove(uint32_t item)
+{
+    if (leafOf[item] == PENDING)
+        std::erase(pending, item);
+    else
+    {
+        // the leaf keeps its box until the next rebuild, it is only ever too big
+        leafItems[leafOf[item]] = NOT_IN_TREE;
+        tombstones++;
+    }
+    leafOf[item] = NOT_IN_TREE;
+}
+
+void SurfaceBVH::update(uint32_t item, const Box &box)
+{
+    itemBoxes[item] = box;
+    // every item is updated by one thread at a time, so the flag needs no atomics, only the slot in the list does
+    if (!moved[item])
+    {
+        moved[item] = 1;
+        movedItems[movedCount.fetch_add(1, std::memory_order_relaxed)] = item;
+    }
+}
+
+void SurfaceBVH::commit()
+{
+    // refit the leaves of the moved items and the ancestors whose box changes with them
+    uint32_t movedTotal = movedCount.exchange(0);
+    for (uint32_t i = 0; i < movedTotal; i++)
+    {
+        uint32_t item = movedItems[i];
+        moved[item] = 0;
+        if (leafOf[item] != PENDING && leafOf[item] != NOT_IN_TREE)
+            refit(leafNodes[leafOf[item]]);
+    }
+
+    // rebuild once the flat list or the removed items are a good part of the tree, or the refits spread it out
+    size_t liveItems = treeItems - tombstones;
+    bool rebuildPending = pending.size() > std::max<size_t>(64, liveItems / 8);
+    bool rebuildRemoved = tombstones > 0 && tombstones > liveItems / 4;
+    bool rebuildLoose = !nodes.empty() && nodes[0].box.area() > 2.f * builtArea;
+    if (rebuildPending || rebuildRemoved || rebuildLoose)
+        rebuild();
+}
+
+std::optional<SurfaceBVH::RayHit> SurfaceBVH::raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+                                                      float maxDistance) const
+{
+    glm::vec3 inverseDirection = 1.f / direction;
+    std::optional<RayHit> nearest;
+    auto test_item = [&](uint32_t item)
+    {
+        float distance = ray_box(itemBoxes[item], origin, inverseDirection, maxDistance);
+        if (distance >= 0.f && (!nearest || distance < nearest->distance))
+            nearest = RayHit{item, distance};
+    };
+
+    for (uint32_t item : pending)
+        test_item(item);
+    if (nodes.empty())
+        return nearest;
+
+    // nearer child first, anything entered after the nearest hit so far is skipped
+    std::vector<std::pair<uint32_t, float>> stack;
+    float rootDistance = ray_box(nodes[0].box, origin, inverseDirection, maxDistance);
+    if (rootDistance >= 0.f)
+        stack.push_back({0, rootDistance});
+    while (!stack.empty())
+    {
+        auto [index, distance] = stack.back();
+        stack.pop_back();
+        if (nearest && distance >= nearest->distance)
+            continue;
+
+        const Node &node = nodes[index];
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                if (leafItems[i] != NOT_IN_TREE)
+                    test_item(leafItems[i]);
+            }
+            continue;
+        }
+
+        float left = ray_box(nodes[node.first].box, origin, inverseDirection, maxDistance);
+        float right = ray_box(nodes[node.first + 1].box, origin, inverseDirection, maxDistance);
+        std::pair<uint32_t, float> children[] = {{node.first, left}, {node.first + 1, right}};
+        if (right < left)
+            std::swap(children[0], children[1]);
+        for (int i = 1; i >= 0; i--)
+        {
+            if (children[i].second >= 0.f)
+                stack.push_back(children[i]);
+        }
+    }
+    return nearest;
+}
+
+int64_t SurfaceBVH::classify(const Box &box, std::span<const glm::vec4> planes, uint32_t mask)
+{
+    glm::vec3 center = centroid(box);
+    glm::vec3 extents = (box.max - box.min) * 0.5f;
+    uint32_t crossing = 0;
+    for (uint32_t i = 0; i < planes.size(); i++)
+    {
+        if (!(mask & (1u << i)))
+            continue;
+        const glm::vec4 &p = planes[i];
+        float distance = glm::dot(glm::vec3(p), center) + p.w;
+        float reach = glm::dot(glm::abs(glm::vec3(p)), extents);
+        if (distance < -reach)
+            return -1;
+        if (distance < reach)
+            crossing |= 1u << i;
+    }
+    return crossing;
+}
+
+void SurfaceBVH::rebuild()
+{
+    // the live items of the tree and the flat list, removed ones are dropped
+    std::vector<uint32_t> items;
+    items.reserve(treeItems - tombstones + pending.size());
+    for (uint32_t item : leafItems)
+    {
+        if (item != NOT_IN_TREE)
+            items.push_back(item);
+    }
+    items.insert(items.end(), pending.begin(), pending.end());
+    pending.clear();
+
+    leafItems = std::move(items);
+    leafNodes.resize(leafItems.size());
+    treeItems = leafItems.size();
+    tombstones = 0;
+    rebuilds++;
+
+    nodes.clear();
+    if (leafItems.empty())
+    {
+        builtArea = 0.f;
+        return;
+    }
+    nodes.reserve(2 * leafItems.size());
+    nodes.push_back(Node{Box{}, NOT_IN_TREE, 0, 0});
+    build(0, 0, static_cast<uint32_t>(leafItems.size()));
+
+    for (uint32_t i = 0; i < leafItems.size(); i++)
+        leafOf[leafItems[i]] = i;
+    builtArea = nodes[0].box.area();
+}
+
+void SurfaceBVH::build(uint32_t node, uint32_t begin, uint32_t end)
+{
+    Box bounds, centroidBounds;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        const Box &box = itemBoxes[leafItems[i]];
+        bounds.grow(box);
+        glm::vec3 c = centroid(box);
+        centroidBounds.grow(Box{c, c});
+    }
+    nodes[node].box = bounds;
+
+    uint32_t count = end - begin;
+    auto make_leaf = [&]()
+    {
+        nodes[node].first = begin;
+        nodes[node].count = count;
+        for (uint32_t i = begin; i < end; i++)
+            leafNodes[i] = node;
+    };
+    if (count <= 1)
+    {
+        make_leaf();
+        return;
+    }
+
+    // bin the centroids along the axis they spread the most over
+    glm::vec3 spread = centroidBounds.max - centroidBounds.min;
+    int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+    uint32_t mid = begin + count / 2;
+
+    if (spread[axis] > 0.f)
+    {
+        float scale = sahBins / spread[axis];
+        auto bin_of = [&](uint32_t item)
+        {
+            float offset = centroid(itemBoxes[item])[axis] - centroidBounds.min[axis];
+            return std::min(static_cast<uint32_t>(offset * scale), sahBins - 1);
+        };
+
+        Box binBoxes[sahBins];
+        uint32_t binCounts[sahBins] = {};
+        for (uint32_t i = begin; i < end; i++)
+        {
+            uint32_t bin = bin_of(leafItems[i]);
+            binBoxes[bin].grow(itemBoxes[leafItems[i]]);
+            binCounts[bin]++;
+        }
+
+        // cost of splitting after every bin, sweeping from both sides
+        float leftCosts[sahBins - 1];
+        Box left;
+        uint32_t leftCount = 0;
+        for (uint32_t i = 0; i < sahBins - 1; i++)
+        {
+            left.grow(binBoxes[i]);
+            leftCount += binCounts[i];
+            leftCosts[i] = leftCount > 0 ? left.area() * leftCount : 0.f;
+        }
+        float bestCost = FLT_MAX;
+        uint32_t bestSplit = 0;
+        Box right;
+        uint32_t rightCount = 0;
+        for (uint32_t i = sahBins - 1; i > 0; i--)
+        {
+            right.grow(binBoxes[i]);
+            rightCount += binCounts[i];
+            float cost = leftCosts[i - 1] + (rightCount > 0 ? right.area() * rightCount : 0.f);
+            if (rightCount > 0 && rightCount < count && cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = i;
+            }
+        }
+
+        // a leaf when splitting does not pay off and the leaf stays small
+        if (count <= maxLeafItems && bestCost >= bounds.area() * count)
+        {
+            make_leaf();
+            return;
+        }
+        if (bestSplit > 0)
+        {
+            uint32_t *split = std::partition(leafItems.data() + begin, leafItems.data() + end,
+                                             [&](uint32_t item) { return bin_of(item) < bestSplit; });
+            mid = static_cast<uint32_t>(split - leafItems.data());
+        }
+    }
+    else if (count <= maxLeafItems)
+    {
+        make_leaf();
+        return;
+    }
+
+    uint32_t children = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(Node{Box{}, node, 0, 0});
+    nodes.push_back(Node{Box{}, node, 0, 0});
+    nodes[node].first = children;
+    nodes[node].count = 0;
+    build(children, begin, mid);
+    build(children + 1, mid, end);
+}
+
+void SurfaceBVH::refit(uint32_t node)
+{
+    Box leafBox;
+    const Node &leaf = nodes[node];
+    for (uint32_t i = leaf.first; i < leaf.first + leaf.count; i++)
+    {
+        if (leafItems[i] != NOT_IN_TREE)
+            leafBox.grow(itemBoxes[leafItems[i]]);
+    }
+    if (leafBox == nodes[node].box)
+        return;
+    nodes[node].box = leafBox;
+
+    // up until a box does not change, the ancestors above it do not either
+    for (uint32_t parent = nodes[node].parent; parent != NOT_IN_TREE; parent = nodes[parent].parent)
+    {
+        Box box = nodes[nodes[parent].first].box;
+        box.grow(nodes[nodes[parent].first + 1].box);
+        if (box == nodes[parent].box)
+            break;
+        nodes[parent].box = box;
+    }
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include <atomic>
+#include <cfloat>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+#include <vk_types.h>
+
+/**
+ * @brief Bounding volume hierarchy over world space boxes of items identified by small integer ids (the surface
+ * proxies of a RenderProxyRegistry). Built top down with a binned surface area heuristic.
+ *
+ * Moving an item refits the boxes of its leaf and the ancestors that grow or shrink with it at the next commit, the
+ * tree is rebuilt once enough items were added or removed or the refits made it too loose. Items added since the
+ * last build are kept in a flat list and tested one by one until then, so streaming in a scene does not rebuild the
+ * tree every frame.
+ *
+ */
+class SurfaceBVH
+{
+  public:
+    struct Box
+    {
+        glm::vec3 min{FLT_MAX};
+        glm::vec3 max{-FLT_MAX};
+
+        void grow(const Box &other)
+        {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+        float area() const
+        {
+            glm::vec3 size = glm::max(max - min, glm::vec3(0.f));
+            return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+        bool operator==(const Box &other) const = default;
+    };
+
+    struct RayHit
+    {
+        uint32_t item;
+        float distance; // to where the ray enters the box of the item
+    };
+
+    SurfaceBVH() = default;
+    SurfaceBVH(const SurfaceBVH &) = delete;
+    SurfaceBVH &operator=(const SurfaceBVH &) = delete;
+
+    void insert(uint32_t item, const Box &box);
+    void remove(uint32_t item);
+    // can run on several threads at once for different items, nothing else can run at the same time
+    void update(uint32_t item, const Box &box);
+
+    // apply the changes since the last commit, refitting or rebuilding the tree. call before querying
+    void commit();
+
+    /**
+     * @brief Visit every item whose box is not entirely outside one of the planes. Subtrees outside a plane are
+     * skipped whole, subtrees inside a plane do not test it again further down.
+     *
+     * @param planes normalized planes with the inside on the positive side, at most 32
+     */
+    template <typename F> void query_frustum(std::span<const glm::vec4> planes, F &&visit) const;
+    // visit every item whose box contains point
+    template <typename F> void query_point(const glm::vec3 &point, F &&visit) const;
+    // the item whose box the ray enters first, within maxDistance
+    std::optional<RayHit> raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance) const;
+
+    size_t size() const
+    {
+        return treeItems - tombstones + pending.size();
+    }
+    size_t rebuild_count() const
+    {
+        return rebuilds;
+    }
+
+  private:
+    static constexpr uint32_t NOT_IN_TREE = UINT32_MAX;
+    static constexpr uint32_t PENDING = UINT32_MAX - 1;
+    static constexpr uint32_t maxLeafItems = 4;
+    static constexpr uint32_t sahBins = 12;
+
+    struct Node
+    {
+        Box box;
+        uint32_t parent;
+        // inner nodes: index of the first child, the second one follows it. leaves: first index into leafItems
+        uint32_t first;
+        uint32_t count; // items of a leaf, 0 for inner nodes
+    };
+
+    // -1 when the box is outside one of the planes, otherwise the mask of the planes it still crosses
+    static int64_t classify(const Box &box, std::span<const glm::vec4> planes, uint32_t mask);
+
+    void rebuild();
+    void build(uint32_t node, uint32_t begin, uint32_t end);
+    void refit(uint32_t node);
+
+    std::vector<Node> nodes;
+    // item ids of the leaves, NOT_IN_TREE for items removed since the build
+    std::vector<uint32_t> leafItems;
+    // leaf node of every position of leafItems
+    std::vector<uint32_t> leafNodes;
+    size_t treeItems = 0;
+    size_t tombstones = 0;
+    float builtArea = 0.f;
+    size_t rebuilds = 0;
+
+    // indexed by item id
+    std::vector<Box> itemBoxes;
+    std::vector<uint32_t> leafOf; // position in leafItems, PENDING or NOT_IN_TREE
+    std::vector<uint8_t> moved;   // already listed in movedItems since the last commit
+
+    std::vector<uint32_t> pending;
+    // items updated since the last commit, appended to from several threads. sized to hold every item once
+    std::vector<uint32_t> movedItems;
+    std::atomic<uint32_t> movedCount{0};
+};
+
+template <typename F> void SurfaceBVH::query_frustum(std::span<const glm::vec4> planes, F &&visit) const
+{
+    const uint32_t allPlanes = static_cast<uint32_t>((uint64_t{1} << planes.size()) - 1);
+    for (uint32_t item : pending)
+    {
+        if (classify(itemBoxes[item], planes, allPlanes) >= 0)
+            visit(item);
+    }
+    if (nodes.empty())
+        return;
+
+    // node with the planes its parent still crossed
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    stack.push_back({0, allPlanes});
+    while (!stack.empty())
+    {
+        auto [index, parentMask] = stack.back();
+        stack.pop_back();
+        const Node &node = nodes[index];
+
+        int64_t mask = classify(node.box, planes, parentMask);
+        if (mask < 0)
+            continue;
+        if (node.count == 0)
+        {
+            stack.push_back({node.first + 1, static_cast<uint32_t>(mask)});
+            stack.push_back({node.first, static_cast<uint32_t>(mask)});
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++)
+        {
+            uint32_t item = leafItems[i];
+            if (item != NOT_IN_TREE && (mask == 0 || classify(itemBoxes[item], planes, mask) >= 0))
+                visit(item);
+        }
+    }
+}
+
+template <typename F> void SurfaceBVH::query_point(const glm::vec3 &point, F &&visit) const
+{
+    auto contains = [&](const Box &box)
+    { return glm::all(glm::greaterThanEqual(point, box.min)) && glm::all(glm::lessThanEqual(point, box.max)); };
+
+    for (uint32_t item : pending)
+    {
+        if (contains(itemBoxes[item]))
+            visit(item);
+    }
+    if (nodes.empty())
+        return;
+
+    std::vector<uint32_t> stack{0};
+    while (!stack.empty())
+    {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+        if (!contains(node.box))
+            continue;
+        if (node.count == 0)
+        {
+            stack.push_back(node.first + 1);
+            stack.push_back(node.first);
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++)
+        {
+            uint32_t item = leafItems[i];
+            if (item != NOT_IN_TREE && contains(itemBoxes[item]))
+                visit(item);
+        }
+    }
+}
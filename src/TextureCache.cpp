@@ -0,0 +1,67 @@
+#include "TextureCache.h"
+#include "GPUResourceAllocator.h"
+
+TextureCache &TextureCache::Get()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+std::optional<AllocatedImage> TextureCache::acquire(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    auto it = entries.find(key);
+    if (it == entries.end())
+    {
+        misses++;
+        return {};
+    }
+
+    hits++;
+    it->second.references++;
+    return it->second.image;
+}
+
+AllocatedImage TextureCache::insert(uint64_t key, const AllocatedImage &image, GPUResourceAllocator &allocator)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    auto [it, inserted] = entries.try_emplace(key, Entry{image, 0});
+    it->second.references++;
+    if (!inserted)
+    {
+        // uploaded twice, the copy that came second is dropped
+        hits++;
+        allocator.destroy_image_after_upload(image);
+    }
+    return it->second.image;
+}
+
+void TextureCache::release(uint64_t key, GPUResourceAllocator &allocator)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return;
+
+    if (--it->second.references == 0)
+    {
+        allocator.destroy_image(it->second.image);
+        entries.erase(it);
+    }
+}
+
+TextureCacheStats TextureCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    TextureCacheStats stats{};
+    stats.textures = static_cast<uint32_t>(entries.size());
+    for (const auto &[key, entry] : entries)
+        stats.references += entry.references;
+    stats.hits = hits;
+    stats.misses = misses;
+    return stats;
+}
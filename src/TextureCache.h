@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vk_types.h>
+
+class GPUResourceAllocator;
+
+struct TextureCacheStats
+{
+    uint32_t textures = 0;   // images currently alive in the cache
+    uint32_t references = 0; // scenes holding them, summed over every image
+    size_t hits = 0;         // uploads that were skipped because the texture was already resident
+    size_t misses = 0;
+};
+
+/**
+ * @brief Process wide cache of uploaded textures, keyed by a hash of their contents. Scenes that use the same texture
+ * share one image, which is destroyed when the last of them releases it.
+ *
+ */
+class TextureCache
+{
+  public:
+    /**
+     * @brief Get the process wide cache.
+     *
+     */
+    static TextureCache &Get();
+
+    /**
+     * @brief Look up a texture, and take a reference to it when it is found.
+     *
+     */
+    std::optional<AllocatedImage> acquire(uint64_t key);
+
+    /**
+     * @brief Add a texture that was just uploaded, the caller holds the first reference. If the key was inserted in
+     * the meantime, a reference to the cached image is taken instead and the new image is destroyed once its upload
+     * batch is submitted.
+     *
+     * @return AllocatedImage the image the caller has to use, the cached one if there was one.
+     */
+    AllocatedImage insert(uint64_t key, const AllocatedImage &image, GPUResourceAllocator &allocator);
+
+    /**
+     * @brief Drop a reference taken by acquire or insert, the image is destroyed with the last one.
+     *
+     */
+    void release(uint64_t key, GPUResourceAllocator &allocator);
+
+    TextureCacheStats stats() const;
+
+  private:
+    struct Entry
+    {
+        AllocatedImage image;
+        uint32_t references;
+    };
+
+    mutable std::mutex cacheMutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    size_t hits = 0;
+    size_t misses = 0;
+};
@@ -0,0 +1,416 @@
+#include "TextureProcessing.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <optional>
+
+uint32_t texproc::mip_level_count(VkExtent3D extent)
+{
+    uint32_t size = std::max(extent.width, extent.height);
+    uint32_t levels = 1;
+    while (size > 1)
+    {
+        size /= 2;
+        levels++;
+    }
+    return levels;
+}
+
+VkExtent3D texproc::mip_extent(VkExtent3D extent, uint32_t level)
+{
+    return {std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u),
+            std::max(extent.depth >> level, 1u)};
+}
+
+namespace
+{
+    struct FormatBlock
+    {
+        uint32_t bytes; // per block
+        uint32_t size;  // texels along each side of a block, 1 for plain formats
+    };
+
+    std::optional<FormatBlock> format_block(VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_R8_UNORM:
+            return FormatBlock{1, 1};
+        case VK_FORMAT_R8G8_UNORM:
+            return FormatBlock{2, 1};
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            return FormatBlock{4, 1};
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            return FormatBlock{8, 4};
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return FormatBlock{16, 4};
+        default:
+            return {};
+        }
+    }
+} // namespace
+
+bool texproc::is_supported_format(VkFormat format)
+{
+    return format_block(format).has_value();
+}
+
+bool texproc::is_block_compressed(VkFormat format)
+{
+    std::optional<FormatBlock> block = format_block(format);
+    return block.has_value() && block->size > 1;
+}
+
+size_t texproc::mip_level_size(VkFormat format, VkExtent3D extent)
+{
+    // block compressed levels are padded to whole blocks
+    FormatBlock block = format_block(format).value_or(FormatBlock{4, 1});
+    size_t blocksX = (extent.width + block.size - 1) / block.size;
+    size_t blocksY = (extent.height + block.size - 1) / block.size;
+    return blocksX * blocksY * extent.depth * block.bytes;
+}
+
+size_t texproc::mip_chain_size(VkFormat format, VkExtent3D extent, uint32_t levelCount)
+{
+    size_t size = 0;
+    for (uint32_t level = 0; level < levelCount; level++)
+        size += mip_level_size(format, mip_extent(extent, level));
+    return size;
+}
+
+namespace
+{
+    // the same 2.2 gamma the shaders take off color textures
+    constexpr float COLOR_GAMMA = 2.2f;
+
+    uint8_t encode_gamma(float linear)
+    {
+        return static_cast<uint8_t>(std::pow(std::clamp(linear, 0.f, 1.f), 1.f / COLOR_GAMMA) * 255.f + 0.5f);
+    }
+} // namespace
+
+std::vector<uint8_t> texproc::generate_mips(std::span<const uint8_t> rgba, VkExtent3D extent, bool gammaEncoded)
+{
+    std::array<float, 256> toLinear;
+    for (uint32_t i = 0; i < 256; i++)
+        toLinear[i] = std::pow(i / 255.f, COLOR_GAMMA);
+
+    const uint32_t levelCount = mip_level_count(extent);
+    std::vector<uint8_t> levels(mip_chain_size(VK_FORMAT_R8G8B8A8_UNORM, extent, levelCount));
+    memcpy(levels.data(), rgba.data(), mip_level_size(VK_FORMAT_R8G8B8A8_UNORM, extent));
+
+    size_t srcOffset = 0;
+    for (uint32_t level = 1; level < levelCount; level++)
+    {
+        VkExtent3D src = mip_extent(extent, level - 1);
+        VkExtent3D dst = mip_extent(extent, level);
+        size_t dstOffset = srcOffset + mip_level_size(VK_FORMAT_R8G8B8A8_UNORM, src);
+
+        const uint8_t *in = levels.data() + srcOffset;
+        uint8_t *out = levels.data() + dstOffset;
+        for (uint32_t y = 0; y < dst.height; y++)
+        {
+            uint32_t y0 = std::min(y * 2, src.height - 1);
+            uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+            for (uint32_t x = 0; x < dst.width; x++)
+            {
+                uint32_t x0 = std::min(x * 2, src.width - 1);
+                uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+                const uint8_t *texels[4] = {&in[(y0 * src.width + x0) * 4], &in[(y0 * src.width + x1) * 4],
+                                            &in[(y1 * src.width + x0) * 4], &in[(y1 * src.width + x1) * 4]};
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    if (gammaEncoded && c < 3)
+                    {
+                        float sum = toLinear[texels[0][c]] + toLinear[texels[1][c]] + toLinear[texels[2][c]] +
+                                    toLinear[texels[3][c]];
+                        out[(y * dst.width + x) * 4 + c] = encode_gamma(sum * 0.25f);
+                        continue;
+                    }
+                    uint32_t sum = texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c];
+                    out[(y * dst.width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+        srcOffset = dstOffset;
+    }
+    return levels;
+}
+
+// {{{ BLOCK COMPRESSION
+
+namespace
+{
+    // principal axis of a set of points, by power iteration on the covariance matrix
+    template <int N> void principal_axis(const float (&points)[16][N], float (&mean)[N], float (&axis)[N])
+    {
+        for (int c = 0; c < N; c++)
+        {
+            mean[c] = 0.f;
+            for (int i = 0; i < 16; i++)
+                mean[c] += points[i][c];
+            mean[c] /= 16.f;
+        }
+
+        float covariance[N][N] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            for (int a = 0; a < N; a++)
+            {
+                for (int b = 0; b < N; b++)
+                    covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+            }
+        }
+
+        for (int c = 0; c < N; c++)
+            axis[c] = 1.f;
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[N] = {};
+            for (int a = 0; a < N; a++)
+            {
+                for (int b = 0; b < N; b++)
+                    next[a] += covariance[a][b] * axis[b];
+            }
+
+            float length = 0.f;
+            for (int c = 0; c < N; c++)
+                length += next[c] * next[c];
+            length = std::sqrt(length);
+            if (length < 1e-6f)
+                return;
+            for (int c = 0; c < N; c++)
+                axis[c] = next[c] / length;
+        }
+    }
+
+    // endpoints of the points along their principal axis
+    template <int N> void axis_endpoints(const float (&points)[16][N], float (&e0)[N], float (&e1)[N])
+    {
+        float mean[N], axis[N];
+        principal_axis(points, mean, axis);
+
+        float tMin = 0.f, tMax = 0.f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = 0.f;
+            for (int c = 0; c < N; c++)
+                t += (points[i][c] - mean[c]) * axis[c];
+            tMin = std::min(tMin, t);
+            tMax = std::max(tMax, t);
+        }
+
+        for (int c = 0; c < N; c++)
+        {
+            e0[c] = std::clamp(mean[c] + axis[c] * tMin, 0.f, 255.f);
+            e1[c] = std::clamp(mean[c] + axis[c] * tMax, 0.f, 255.f);
+        }
+    }
+
+    void encode_bc4_block(const uint8_t (&values)[16], uint8_t *out)
+    {
+        uint8_t maxValue = *std::max_element(values, values + 16);
+        uint8_t minValue = *std::min_element(values, values + 16);
+
+        // eight value mode: index 0 is the max, 1 the min, 2..7 interpolate from max to min
+        uint64_t bits = uint64_t(maxValue) | uint64_t(minValue) << 8;
+        if (maxValue != minValue)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                float t = float(maxValue - values[i]) / float(maxValue - minValue);
+                uint64_t step = static_cast<uint64_t>(std::lround(t * 7.f));
+                uint64_t index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+                bits |= index << (16 + i * 3);
+            }
+        }
+        memcpy(out, &bits, 8);
+    }
+
+    // bc7 mode 6: one subset, rgba endpoints with 7 bits and a shared p-bit each, 4 bit indices
+    constexpr int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    void encode_bc7_block(const uint8_t (&rgba)[16][4], uint8_t *out)
+    {
+        float points[16][4];
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < 4; c++)
+                points[i][c] = rgba[i][c];
+        }
+
+        float e0[4], e1[4];
+        axis_endpoints(points, e0, e1);
+
+        // try every p-bit pair, keep the one with the smallest error
+        uint32_t bestQuantized[2][4] = {};
+        uint32_t bestPBits[2] = {};
+        uint32_t bestIndices[16] = {};
+        float bestError = FLT_MAX;
+        for (uint32_t pbits = 0; pbits < 4; pbits++)
+        {
+            uint32_t p[2] = {pbits & 1, pbits >> 1};
+            uint32_t quantized[2][4];
+            int endpoints[2][4];
+            for (int c = 0; c < 4; c++)
+            {
+                const float source[2] = {e0[c], e1[c]};
+                for (int e = 0; e < 2; e++)
+                {
+                    long q = std::lround((source[e] - float(p[e])) / 2.f);
+                    quantized[e][c] = static_cast<uint32_t>(std::clamp(q, 0l, 127l));
+                    endpoints[e][c] = int(quantized[e][c] << 1 | p[e]);
+                }
+            }
+
+            uint32_t indices[16];
+            float error = 0.f;
+            for (int i = 0; i < 16; i++)
+            {
+                float pointError = FLT_MAX;
+                for (uint32_t w = 0; w < 16; w++)
+                {
+                    float e = 0.f;
+                    for (int c = 0; c < 4; c++)
+                    {
+                        int weight = BC7_WEIGHTS[w];
+                        int value = ((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6;
+                        e += (points[i][c] - float(value)) * (points[i][c] - float(value));
+                    }
+                    if (e < pointError)
+                    {
+                        pointError = e;
+                        indices[i] = w;
+                    }
+                }
+                error += pointError;
+            }
+
+            if (error < bestError)
+            {
+                bestError = error;
+                memcpy(bestQuantized, quantized, sizeof(quantized));
+                bestPBits[0] = p[0];
+                bestPBits[1] = p[1];
+                memcpy(bestIndices, indices, sizeof(indices));
+            }
+        }
+
+        // the first index is stored with 3 bits, its top bit must be 0. swap the endpoints if it is not
+        if (bestIndices[0] >= 8)
+        {
+            for (int c = 0; c < 4; c++)
+                std::swap(bestQuantized[0][c], bestQuantized[1][c]);
+            std::swap(bestPBits[0], bestPBits[1]);
+            for (uint32_t &index : bestIndices)
+                index = 15 - index;
+        }
+
+        uint64_t low = 1u << 6; // mode 6
+        uint64_t high = 0;
+        uint32_t bit = 7;
+        auto write = [&](uint64_t value, uint32_t count)
+        {
+            for (uint32_t i = 0; i < count; i++, bit++)
+            {
+                uint64_t b = (value >> i) & 1;
+                if (bit < 64)
+                    low |= b << bit;
+                else
+                    high |= b << (bit - 64);
+            }
+        };
+
+        for (int c = 0; c < 4; c++)
+        {
+            write(bestQuantized[0][c], 7);
+            write(bestQuantized[1][c], 7);
+        }
+        write(bestPBits[0], 1);
+        write(bestPBits[1], 1);
+        write(bestIndices[0], 3);
+        for (int i = 1; i < 16; i++)
+            write(bestIndices[i], 4);
+
+        memcpy(out, &low, 8);
+        memcpy(out + 8, &high, 8);
+    }
+} // namespace
+
+std::vector<uint8_t> texproc::compress(std::span<const uint8_t> levels, VkExtent3D extent, uint32_t mipLevels,
+                                       VkFormat format, std::array<uint32_t, 2> channels)
+{
+    std::vector<uint8_t> compressed(mip_chain_size(format, extent, mipLevels));
+
+    size_t srcOffset = 0, dstOffset = 0;
+    for (uint32_t level = 0; level < mipLevels; level++)
+    {
+        VkExtent3D size = mip_extent(extent, level);
+        const uint8_t *src = levels.data() + srcOffset;
+        uint8_t *dst = compressed.data() + dstOffset;
+        const size_t blockBytes = mip_level_size(format, {1, 1, 1});
+
+        for (uint32_t by = 0; by < (size.height + 3) / 4; by++)
+        {
+            for (uint32_t bx = 0; bx < (size.width + 3) / 4; bx++)
+            {
+                // blocks past the edge of the level repeat the last row and column
+                uint8_t block[16][4];
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    uint32_t x = std::min(bx * 4 + i % 4, size.width - 1);
+                    uint32_t y = std::min(by * 4 + i / 4, size.height - 1);
+                    memcpy(block[i], src + (size_t(y) * size.width + x) * 4, 4);
+                }
+
+                switch (format)
+                {
+                case VK_FORMAT_BC7_UNORM_BLOCK:
+                    encode_bc7_block(block, dst);
+                    break;
+                case VK_FORMAT_BC4_UNORM_BLOCK:
+                case VK_FORMAT_BC5_UNORM_BLOCK:
+                {
+                    // bc4 is one channel, bc5 two bc4 blocks back to back
+                    uint32_t channelCount = format == VK_FORMAT_BC5_UNORM_BLOCK ? 2 : 1;
+                    for (uint32_t c = 0; c < channelCount; c++)
+                    {
+                        uint8_t values[16];
+                        for (int i = 0; i < 16; i++)
+                            values[i] = block[i][channels[c]];
+                        encode_bc4_block(values, dst + c * 8);
+                    }
+                    break;
+                }
+                default:
+                    assert(false && "texproc::compress has no encoder for this format");
+                    break;
+                }
+                dst += blockBytes;
+            }
+        }
+
+        srcOffset += mip_level_size(VK_FORMAT_R8G8B8A8_UNORM, size);
+        dstOffset += mip_level_size(format, size);
+    }
+    return compressed;
+}
+
+// }}} BLOCK COMPRESSION end
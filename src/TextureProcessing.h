@@ -0,0 +1,49 @@
+#pragma once
+#include <array>
+#include <span>
+#include <vector>
+#include <vk_types.h>
+
+/**
+ * @brief Import time texture processing. Images are kept as every mip level back to back, level 0 first, so a whole
+ * chain goes to the gpu with a single copy.
+ *
+ */
+namespace texproc
+{
+    // levels of a full chain down to 1x1
+    uint32_t mip_level_count(VkExtent3D extent);
+
+    VkExtent3D mip_extent(VkExtent3D extent, uint32_t level);
+
+    // formats mip_level_size knows the layout of, and that can be uploaded as stored
+    bool is_supported_format(VkFormat format);
+
+    bool is_block_compressed(VkFormat format);
+
+    // bytes of one level of an image in the given format
+    size_t mip_level_size(VkFormat format, VkExtent3D extent);
+
+    // bytes of the first levelCount levels
+    size_t mip_chain_size(VkFormat format, VkExtent3D extent, uint32_t levelCount);
+
+    /**
+     * @brief Build the full mip chain of an RGBA8 image with a 2x2 box filter. Odd sizes reuse the last row or
+     * column.
+     *
+     * @param gammaEncoded rgb is color stored with the 2.2 gamma the shaders decode, it is averaged in linear space.
+     * alpha and data textures are averaged as stored
+     * @return std::vector<uint8_t> every level back to back, starting with a copy of the source.
+     */
+    std::vector<uint8_t> generate_mips(std::span<const uint8_t> rgba, VkExtent3D extent, bool gammaEncoded);
+
+    /**
+     * @brief Block compress an RGBA8 mip chain. Supports BC4 (one channel), BC5 (two channels) and BC7, which is
+     * always encoded with mode 6.
+     *
+     * @param channels source channels of the bc4/bc5 channels
+     * @return std::vector<uint8_t> the compressed levels back to back
+     */
+    std::vector<uint8_t> compress(std::span<const uint8_t> levels, VkExtent3D extent, uint32_t mipLevels,
+                                  VkFormat format, std::array<uint32_t, 2> channels = {0, 1});
+} // namespace texproc
@@ -0,0 +1,328 @@
+#include "TextureStreamer.h"
+#include "TextureProcessing.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // bytes of the levels of an image from firstMip to the end of its chain
+    size_t chain_size(const ImportedImage &image, uint32_t firstMip)
+    {
+        return texproc::mip_chain_size(image.format, texproc::mip_extent(image.extent, firstMip),
+                                       image.mipLevels - firstMip);
+    }
+
+    // finest level a surface covering screenSize pixels can show, at one texel per pixel. assumes the uvs of the
+    // surface span the texture once
+    uint32_t coverage_mip(const ImportedImage &image, float screenSize)
+    {
+        float size = static_cast<float>(std::max(image.extent.width, image.extent.height));
+        if (screenSize >= size)
+            return 0;
+        uint32_t mip = static_cast<uint32_t>(std::log2(size / std::max(screenSize, 1.f)));
+        return std::min(mip, image.mipLevels - 1);
+    }
+} // namespace
+
+void TextureStreamer::init(GPUResourceAllocator *allocator, VkDevice device, GLTFMRMaterialSystem *materialSystem,
+                           size_t budgetBytes)
+{
+    this->allocator = allocator;
+    this->device = device;
+    this->materialSystem = materialSystem;
+    this->budgetBytes = budgetBytes;
+    this->effectiveBytes = budgetBytes;
+}
+
+void TextureStreamer::add_texture(uint64_t key, const ImportedImage &image)
+{
+    Texture &texture = textures[key];
+    if (texture.references++ == 0)
+        texture.source = image;
+}
+
+void TextureStreamer::release_texture(uint64_t key)
+{
+    auto it = textures.find(key);
+    if (it == textures.end() || --it->second.references > 0)
+        return;
+
+    if (it->second.resident)
+    {
+        residentBytes -= it->second.residentSize;
+        retire_image(it->second.image, it->second.residentSize);
+    }
+    textures.erase(it);
+}
+
+void TextureStreamer::add_material(MaterialInstance *material,
+                                   const GLTFMRMaterialSystem::MaterialResources &placeholders, uint64_t colorTexture,
+                                   uint64_t metalRoughTexture)
+{
+    Material &entry = materials[material];
+    entry = Material{material, placeholders, colorTexture, metalRoughTexture};
+
+    bool anyResident = false;
+    for (uint64_t key : {colorTexture, metalRoughTexture})
+    {
+        if (key == 0)
+            continue;
+        Texture &texture = textures.at(key);
+        texture.materials.push_back(material);
+        anyResident |= texture.resident;
+    }
+
+    // another scene already brought a shared texture in
+    if (anyResident)
+        patch_material(entry);
+}
+
+void TextureStreamer::remove_material(MaterialInstance *material)
+{
+    auto it = materials.find(material);
+    if (it == materials.end())
+        return;
+
+    for (uint64_t key : {it->second.colorTexture, it->second.metalRoughTexture})
+    {
+        auto texture = textures.find(key);
+        if (texture != textures.end())
+            std::erase(texture->second.materials, material);
+    }
+
+    materials.erase(it);
+}
+
+void TextureStreamer::update(std::span<const VisibleMaterial> visibleMaterials, uint64_t frame, size_t uploadBudget)
+{
+    currentFrame = frame;
+    // lastVisibleFrame is 0 for textures that were never visible
+    uint64_t stamp = frame + 1;
+
+    // destroy replaced and evicted images no frame in flight can sample anymore
+    std::erase_if(retiredImages,
+                  [&](const RetiredImage &retired)
+                  {
+                      if (retired.frame + FRAME_OVERLAP >= frame)
+                          return false;
+                      allocator->destroy_image(retired.image);
+                      retiredBytes -= retired.size;
+                      return true;
+                  });
+
+    size_t budget = effective_budget();
+    effectiveBytes = budget;
+
+    // textures of the visible materials, each listed once, with the finest level any of them needs
+    std::vector<uint64_t> visible;
+    for (const VisibleMaterial &visibleMaterial : visibleMaterials)
+    {
+        auto material = materials.find(visibleMaterial.material);
+        if (material == materials.end())
+            continue;
+
+        for (uint64_t key : {material->second.colorTexture, material->second.metalRoughTexture})
+        {
+            if (key == 0)
+                continue;
+            Texture &texture = textures.at(key);
+            uint32_t mip = coverage_mip(texture.source, visibleMaterial.screenSize);
+            if (texture.lastVisibleFrame != stamp)
+            {
+                texture.lastVisibleFrame = stamp;
+                texture.wantedMip = mip;
+                visible.push_back(key);
+            }
+            else
+                texture.wantedMip = std::min(texture.wantedMip, mip);
+        }
+    }
+
+    std::vector<const MaterialInstance *> changedMaterials;
+    size_t uploadedBytes = 0;
+
+    // over the budget: textures that are not on screen go first, then visible ones give back the levels they have
+    // finer than they need, then their finest one. what is still over is given back over the next frames
+    bool overBudget = residentBytes > budget;
+    while (residentBytes > budget && evict_one(stamp, changedMaterials))
+        ;
+    for (uint64_t key : visible)
+    {
+        Texture &texture = textures.at(key);
+        if (residentBytes <= budget)
+            break;
+        if (texture.resident && texture.residentMip < texture.wantedMip)
+            uploadedBytes += upload(texture, texture.wantedMip, changedMaterials);
+    }
+    for (uint64_t key : visible)
+    {
+        Texture &texture = textures.at(key);
+        if (residentBytes <= budget)
+            break;
+        if (texture.resident && texture.residentMip + 1 < texture.source.mipLevels)
+        {
+            uploadedBytes += upload(texture, texture.residentMip + 1, changedMaterials);
+            mipDrops++;
+        }
+    }
+
+    // under the budget: bring in what the visible materials miss. a frame that had to give levels back does not take
+    // any, so they do not bounce
+    for (uint64_t key : visible)
+    {
+        if (overBudget || uploadedBytes >= std::max<size_t>(uploadBudget, 1))
+            break;
+
+        Texture &texture = textures.at(key);
+        if (texture.resident && texture.residentMip <= texture.wantedMip)
+            continue;
+
+        size_t current = texture.resident ? texture.residentSize : 0;
+        auto fits = [&](uint32_t mip) { return residentBytes - current + chain_size(texture.source, mip) <= budget; };
+
+        // make room, only textures that are not on screen are evicted
+        uint32_t mip = texture.wantedMip;
+        while (!fits(mip) && evict_one(stamp, changedMaterials))
+            ;
+        // otherwise take the finest level that fits, the rest follows once there is headroom
+        while (!fits(mip) && mip + 1 < texture.source.mipLevels)
+            mip++;
+        if (!fits(mip) || (texture.resident && mip >= texture.residentMip))
+            continue;
+
+        uploadedBytes += upload(texture, mip, changedMaterials);
+    }
+
+    if (batchOpen)
+    {
+        allocator->submit_upload_batch();
+        batchOpen = false;
+    }
+
+    std::sort(changedMaterials.begin(), changedMaterials.end());
+    changedMaterials.erase(std::unique(changedMaterials.begin(), changedMaterials.end()), changedMaterials.end());
+    for (const MaterialInstance *instance : changedMaterials)
+        patch_material(materials.at(instance));
+}
+
+TextureStreamerStats TextureStreamer::stats() const
+{
+    TextureStreamerStats stats{};
+    stats.textures = static_cast<uint32_t>(textures.size());
+    for (const auto &[key, texture] : textures)
+    {
+        stats.resident += texture.resident ? 1 : 0;
+        stats.partial += texture.resident && texture.residentMip > 0 ? 1 : 0;
+    }
+    stats.residentBytes = residentBytes;
+    stats.budgetBytes = budgetBytes;
+    stats.effectiveBytes = effectiveBytes;
+    stats.uploads = uploads;
+    stats.evictions = evictions;
+    stats.mipDrops = mipDrops;
+    return stats;
+}
+
+void TextureStreamer::destroy()
+{
+    for (auto &[key, texture] : textures)
+    {
+        if (texture.resident)
+            allocator->destroy_image(texture.image);
+    }
+    for (const RetiredImage &retired : retiredImages)
+        allocator->destroy_image(retired.image);
+
+    textures.clear();
+    materials.clear();
+    retiredImages.clear();
+    residentBytes = 0;
+    retiredBytes = 0;
+}
+
+size_t TextureStreamer::effective_budget() const
+{
+    MemoryBudget memory = allocator->memory_budget();
+    if (memory.budget == 0)
+        return budgetBytes;
+
+    // textures can grow into what the heaps have left, minus a margin for everything else that allocates. retired
+    // images are still in the usage but about to go away
+    int64_t spare = static_cast<int64_t>(memory.budget - memory.budget / 10) - static_cast<int64_t>(memory.usage);
+    int64_t available = static_cast<int64_t>(residentBytes + retiredBytes) + spare;
+    return std::min(budgetBytes, static_cast<size_t>(std::max<int64_t>(available, 0)));
+}
+
+size_t TextureStreamer::upload(Texture &texture, uint32_t firstMip,
+                               std::vector<const MaterialInstance *> &changedMaterials)
+{
+    // every upload of this frame goes into one batch
+    if (!batchOpen)
+    {
+        allocator->begin_upload_batch();
+        batchOpen = true;
+    }
+
+    const ImportedImage &image = texture.source;
+    std::vector<std::span<const uint8_t>> levels = image.level_spans();
+    size_t size = chain_size(image, firstMip);
+    AllocatedImage newImage = allocator->create_image(std::span(levels).subspan(firstMip),
+                                                      texproc::mip_extent(image.extent, firstMip), image.format,
+                                                      VK_IMAGE_USAGE_SAMPLED_BIT, image.swizzle);
+
+    // the materials sample the old image until they are patched, it is retired like an evicted one
+    if (texture.resident)
+    {
+        residentBytes -= texture.residentSize;
+        retire_image(texture.image, texture.residentSize);
+    }
+
+    texture.image = newImage;
+    texture.resident = true;
+    texture.residentMip = firstMip;
+    texture.residentSize = size;
+    residentBytes += size;
+    uploads++;
+    changedMaterials.insert(changedMaterials.end(), texture.materials.begin(), texture.materials.end());
+    return size;
+}
+
+bool TextureStreamer::evict_one(uint64_t stamp, std::vector<const MaterialInstance *> &changedMaterials)
+{
+    Texture *oldest = nullptr;
+    for (auto &[key, texture] : textures)
+    {
+        if (texture.resident && texture.lastVisibleFrame < stamp &&
+            (oldest == nullptr || texture.lastVisibleFrame < oldest->lastVisibleFrame))
+            oldest = &texture;
+    }
+
+    if (oldest == nullptr)
+        return false;
+
+    retire_image(oldest->image, oldest->residentSize);
+    oldest->resident = false;
+    residentBytes -= oldest->residentSize;
+    evictions++;
+    changedMaterials.insert(changedMaterials.end(), oldest->materials.begin(), oldest->materials.end());
+    return true;
+}
+
+void TextureStreamer::retire_image(const AllocatedImage &image, size_t size)
+{
+    retiredImages.push_back({image, size, currentFrame});
+    retiredBytes += size;
+}
+
+void TextureStreamer::patch_material(Material &material)
+{
+    GLTFMRMaterialSystem::MaterialResources resources = material.placeholders;
+    if (material.colorTexture != 0 && textures.at(material.colorTexture).resident)
+        resources.colorImage = textures.at(material.colorTexture).image;
+    if (material.metalRoughTexture != 0 && textures.at(material.metalRoughTexture).resident)
+        resources.metalRoughImage = textures.at(material.metalRoughTexture).image;
+
+    // the frames in flight keep sampling the old textures until they are done, the material system holds on to
+    // their slots and the images are retired the same way
+    materialSystem->update_material(device, *material.instance, resources);
+}
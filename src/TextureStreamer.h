@@ -0,0 +1,143 @@
+#pragma once
+#include "MaterialSystem.h"
+#include "vk_loader.h"
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+struct TextureStreamerStats
+{
+    uint32_t textures = 0; // registered, resident or not
+    uint32_t resident = 0;
+    uint32_t partial = 0; // resident without their finest levels
+    size_t residentBytes = 0;
+    size_t budgetBytes = 0;    // the configured budget
+    size_t effectiveBytes = 0; // the budget of the last update, lower when the device memory runs out
+    size_t uploads = 0;        // since startup
+    size_t evictions = 0;      // since startup
+    size_t mipDrops = 0;       // fine levels given back to stay under the budget, since startup
+};
+
+/**
+ * @brief Keeps textures on the gpu only while a material using them is on screen, and only down to the mip level
+ * their size on screen needs. Registered materials start out with placeholder images, once the renderer reports one
+ * as visible its textures are uploaded (a bounded number of bytes per frame) from the level that matches the largest
+ * surface using them, and its material table entry is patched to point to them. Textures are uploaded again with
+ * finer levels when they get closer.
+ *
+ * The budget is the smaller of the configured one and what the VMA heap budgets leave for textures. When the
+ * resident textures go over it the ones that were visible least recently are evicted and their materials go back to
+ * the placeholders, then visible textures give back the levels they have finer than they need, and then their finest
+ * level. The levels come back once there is headroom again.
+ *
+ * Textures are identified by the same content keys as the TextureCache, so scenes sharing a texture share its
+ * residency too.
+ *
+ */
+class TextureStreamer
+{
+  public:
+    void init(GPUResourceAllocator *allocator, VkDevice device, GLTFMRMaterialSystem *materialSystem,
+              size_t budgetBytes);
+
+    /**
+     * @brief Register a texture, or take another reference to it. The texels are kept (not copied) so any range of
+     * levels can be uploaded again after an eviction, from the scene cache mapping or the decoded image.
+     *
+     */
+    void add_texture(uint64_t key, const ImportedImage &image);
+    void release_texture(uint64_t key);
+
+    /**
+     * @brief Register a material written with placeholder images. Its table entry is updated whenever one of its
+     * textures becomes resident, changes its levels or is evicted.
+     *
+     * @param colorTexture key of the texture for the color slot, 0 to keep the placeholder
+     * @param metalRoughTexture same for the metal-rough slot
+     */
+    void add_material(MaterialInstance *material, const GLTFMRMaterialSystem::MaterialResources &placeholders,
+                      uint64_t colorTexture, uint64_t metalRoughTexture);
+    void remove_material(MaterialInstance *material);
+
+    /**
+     * @brief Upload the levels the materials drawn last frame need and give back what no longer fits. Call once per
+     * frame from the render thread after GPUResourceAllocator::update_budget, before the materials are used for
+     * drawing.
+     *
+     * @param visibleMaterials materials the renderer drew with their size on screen, duplicates are fine
+     * @param uploadBudget bytes of texels to upload at most this frame, one texture is uploaded even if it is bigger
+     */
+    void update(std::span<const VisibleMaterial> visibleMaterials, uint64_t frame, size_t uploadBudget);
+
+    void set_budget(size_t budgetBytes)
+    {
+        this->budgetBytes = budgetBytes;
+    }
+
+    TextureStreamerStats stats() const;
+
+    // destroy every texture, call once the device is idle
+    void destroy();
+
+  private:
+    struct Texture
+    {
+        ImportedImage source;
+        uint32_t references = 0;
+        bool resident = false;
+        AllocatedImage image{};
+        // first level on the gpu and the bytes from it to the end of the chain, while resident
+        uint32_t residentMip = 0;
+        size_t residentSize = 0;
+        // finest level the materials using it needed the last time one was visible
+        uint32_t wantedMip = 0;
+        // frame + 1 of the last frame a material using it was visible, 0 if it never was
+        uint64_t lastVisibleFrame = 0;
+        std::vector<const MaterialInstance *> materials;
+    };
+
+    struct Material
+    {
+        MaterialInstance *instance;
+        GLTFMRMaterialSystem::MaterialResources placeholders;
+        uint64_t colorTexture;
+        uint64_t metalRoughTexture;
+    };
+
+    struct RetiredImage
+    {
+        AllocatedImage image;
+        size_t size;
+        uint64_t frame;
+    };
+
+    // the configured budget, lowered to what the device memory budget leaves for textures
+    size_t effective_budget() const;
+    // replace the image of a texture with its levels from firstMip on, returns the bytes uploaded
+    size_t upload(Texture &texture, uint32_t firstMip, std::vector<const MaterialInstance *> &changedMaterials);
+    // evict the resident texture that was visible least recently, as long as it was not visible at stamp
+    bool evict_one(uint64_t stamp, std::vector<const MaterialInstance *> &changedMaterials);
+    void retire_image(const AllocatedImage &image, size_t size);
+    void patch_material(Material &material);
+
+    GPUResourceAllocator *allocator = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    GLTFMRMaterialSystem *materialSystem = nullptr;
+    size_t budgetBytes = 0;
+    size_t effectiveBytes = 0;
+    size_t residentBytes = 0;
+    size_t uploads = 0;
+    size_t evictions = 0;
+    size_t mipDrops = 0;
+    // frame of the last update, retired images are tagged with it
+    uint64_t currentFrame = 0;
+    // the uploads of one update go into a single batch, opened by the first one
+    bool batchOpen = false;
+
+    std::unordered_map<uint64_t, Texture> textures;
+    std::unordered_map<const MaterialInstance *, Material> materials;
+    // replaced and evicted images, destroyed once the frames that could still sample them are done. they count
+    // against the device memory budget until then
+    std::vector<RetiredImage> retiredImages;
+    size_t retiredBytes = 0;
+};
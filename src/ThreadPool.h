@@ -0,0 +1,119 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Fixed size pool of worker threads for CPU side work (texture decoding, mesh processing etc).
+ *
+ */
+class ThreadPool
+{
+  public:
+    explicit ThreadPool(uint32_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief Get the process wide pool. It is created on first use with one worker per hardware thread.
+     *
+     */
+    static ThreadPool &Get();
+
+    /**
+     * @brief Queue a task on the pool.
+     *
+     * @return std::future holding the result of the task.
+     */
+    template <typename F> auto submit(F &&task) -> std::future<std::invoke_result_t<F>>
+    {
+        using ResultType = std::invoke_result_t<F>;
+
+        // packaged_task is move only, std::function needs something copyable.
+        auto packaged = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(task));
+        std::future<ResultType> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.push([packaged]() { (*packaged)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+    uint32_t size() const
+    {
+        return static_cast<uint32_t>(workers.size());
+    }
+
+    // number of batches parallel_for splits count items into
+    uint32_t batch_count(size_t count, size_t minBatch) const
+    {
+        size_t batches = (count + std::max<size_t>(minBatch, 1) - 1) / std::max<size_t>(minBatch, 1);
+        return static_cast<uint32_t>(std::min<size_t>(batches, size()));
+    }
+
+    /**
+     * @brief Split [0, count) into batch_count contiguous batches and run task(batch, begin, end) on each, returns
+     * once all of them are done. The calling thread takes batches too, so it never waits behind tasks queued earlier:
+     * when the workers are busy it runs every batch itself. Batches are numbered in order, so results kept per batch
+     * can be concatenated into the same order however the threads were scheduled.
+     *
+     */
+    template <typename F> void parallel_for(size_t count, size_t minBatch, F &&task)
+    {
+        uint32_t batches = batch_count(count, minBatch);
+        if (batches <= 1)
+        {
+            if (count > 0)
+                task(0u, size_t{0}, count);
+            return;
+        }
+
+        struct Batches
+        {
+            std::atomic<uint32_t> next{0};
+            std::atomic<uint32_t> done{0};
+        };
+        // helpers that only start once every batch is taken return without touching task, which is gone by then
+        auto state = std::make_shared<Batches>();
+        auto run = [state, batches, count, &task]()
+        {
+            for (uint32_t batch = state->next++; batch < batches; batch = state->next++)
+            {
+                task(batch, count * batch / batches, count * (batch + 1) / batches);
+                state->done.fetch_add(1, std::memory_order_release);
+            }
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            for (uint32_t i = 1; i < batches; i++)
+                tasks.push(run);
+        }
+        condition.notify_all();
+
+        run();
+        while (state->done.load(std::memory_order_acquire) < batches)
+            std::this_thread::yield();
+    }
+
+  private:
+    void worker_loop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable condition;
+    bool stopping = false;
+};
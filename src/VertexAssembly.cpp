@@ -0,0 +1,148 @@
+#include "VertexAssembly.h"
+#include <cstring>
+#include <fastgltf/core.hpp>
+#include <fastgltf/tools.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VERTEXASM_SSE 1
+#endif
+
+namespace
+{
+    // defaults of the missing attributes, read with a stride of 0. padded to 4 floats for the simd loads
+    alignas(16) constexpr float DEFAULT_NORMAL[4] = {1.f, 0.f, 0.f, 0.f};
+    alignas(16) constexpr float DEFAULT_UV[4] = {0.f, 0.f, 0.f, 0.f};
+    alignas(16) constexpr float DEFAULT_COLOR[4] = {1.f, 1.f, 1.f, 1.f};
+
+    vertexasm::FloatStream or_default(const vertexasm::FloatStream &stream, const float *fallback)
+    {
+        if (stream.data != nullptr)
+            return stream;
+        return {reinterpret_cast<const std::byte *>(fallback), 0};
+    }
+
+    // reads exactly the bytes of the element
+    void assemble_scalar(const vertexasm::VertexStreams &streams, size_t first, std::span<Vertex> vertices,
+                         glm::vec3 &minPos, glm::vec3 &maxPos)
+    {
+        for (size_t i = first; i < vertices.size(); i++)
+        {
+            Vertex &vertex = vertices[i];
+            glm::vec2 uv;
+            memcpy(&vertex.position, streams.positions.data + i * streams.positions.stride, sizeof(glm::vec3));
+            memcpy(&vertex.normal, streams.normals.data + i * streams.normals.stride, sizeof(glm::vec3));
+            memcpy(&uv, streams.uvs.data + i * streams.uvs.stride, sizeof(glm::vec2));
+            vertex.color = glm::vec4{1.f};
+            memcpy(&vertex.color, streams.colors.data + i * streams.colors.stride,
+                   streams.colorComponents * sizeof(float));
+            vertex.uv_x = uv.x;
+            vertex.uv_y = uv.y;
+
+            minPos = glm::min(minPos, vertex.position);
+            maxPos = glm::max(maxPos, vertex.position);
+        }
+    }
+} // namespace
+
+std::optional<vertexasm::FloatStream> vertexasm::float_stream(const fastgltf::Asset &asset,
+                                                              const fastgltf::Accessor &accessor, uint32_t components)
+{
+    if (accessor.componentType != fastgltf::ComponentType::Float || accessor.sparse.has_value() ||
+        !accessor.bufferViewIndex.has_value() || fastgltf::getNumComponents(accessor.type) != components)
+        return {};
+
+    const fastgltf::BufferView &view = asset.bufferViews[*accessor.bufferViewIndex];
+    const fastgltf::Buffer &buffer = asset.buffers[view.bufferIndex];
+    if (!std::holds_alternative<fastgltf::sources::ByteView>(buffer.data) &&
+        !std::holds_alternative<fastgltf::sources::Array>(buffer.data) &&
+        !std::holds_alternative<fastgltf::sources::Vector>(buffer.data))
+        return {};
+
+    size_t elementSize = components * sizeof(float);
+    size_t stride = view.byteStride.value_or(elementSize);
+    if (accessor.count == 0 || stride < elementSize)
+        return {};
+
+    // a malformed file must not make us read past the view
+    if (accessor.byteOffset + (accessor.count - 1) * stride + elementSize > view.byteLength)
+        return {};
+
+    std::span<const std::byte> bytes = fastgltf::DefaultBufferDataAdapter{}(asset, *accessor.bufferViewIndex);
+    return FloatStream{bytes.data() + accessor.byteOffset, stride};
+}
+
+vertexasm::PositionBounds vertexasm::assemble_vertices(const VertexStreams &input, std::span<Vertex> vertices)
+{
+    if (vertices.empty())
+        return {};
+
+    VertexStreams streams = input;
+    streams.normals = or_default(input.normals, DEFAULT_NORMAL);
+    streams.uvs = or_default(input.uvs, DEFAULT_UV);
+    streams.colors = or_default(input.colors, DEFAULT_COLOR);
+
+    glm::vec3 minPos;
+    memcpy(&minPos, streams.positions.data, sizeof(glm::vec3));
+    glm::vec3 maxPos = minPos;
+    size_t first = 0;
+
+#ifdef VERTEXASM_SSE
+    // vec3 elements are loaded as 4 floats. the extra float is the start of the next element, so it is only safe up to
+    // the second to last vertex, the last one goes through the scalar loop
+    size_t simdCount = vertices.size() - 1;
+    if (simdCount > 0)
+    {
+        const std::byte *position = streams.positions.data;
+        const std::byte *normal = streams.normals.data;
+        const std::byte *uv = streams.uvs.data;
+        const std::byte *color = streams.colors.data;
+        const __m128 alphaOne = _mm_set_ps(1.f, 0.f, 0.f, 0.f);
+        const __m128 rgbMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+        const bool rgb = streams.colorComponents == 3;
+
+        __m128 minv = _mm_loadu_ps(reinterpret_cast<const float *>(position));
+        __m128 maxv = minv;
+
+        for (size_t i = 0; i < simdCount; i++)
+        {
+            __m128 p = _mm_loadu_ps(reinterpret_cast<const float *>(position));
+            __m128 n = _mm_loadu_ps(reinterpret_cast<const float *>(normal));
+            __m128 t = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double *>(uv)));
+            __m128 c = _mm_loadu_ps(reinterpret_cast<const float *>(color));
+            if (rgb)
+                c = _mm_or_ps(_mm_and_ps(c, rgbMask), alphaOne);
+
+            // (px, py, pz, u) and (nx, ny, nz, v)
+            __m128 zu = _mm_shuffle_ps(p, t, _MM_SHUFFLE(0, 0, 2, 2));
+            __m128 zv = _mm_shuffle_ps(n, t, _MM_SHUFFLE(1, 1, 2, 2));
+            __m128 row0 = _mm_shuffle_ps(p, zu, _MM_SHUFFLE(2, 0, 1, 0));
+            __m128 row1 = _mm_shuffle_ps(n, zv, _MM_SHUFFLE(2, 0, 1, 0));
+
+            float *out = reinterpret_cast<float *>(&vertices[i]);
+            _mm_storeu_ps(out, row0);
+            _mm_storeu_ps(out + 4, row1);
+            _mm_storeu_ps(out + 8, c);
+
+            // the w lane holds whatever followed the position, it is dropped below
+            minv = _mm_min_ps(minv, p);
+            maxv = _mm_max_ps(maxv, p);
+
+            position += streams.positions.stride;
+            normal += streams.normals.stride;
+            uv += streams.uvs.stride;
+            color += streams.colors.stride;
+        }
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, minv);
+        minPos = glm::vec3(lanes[0], lanes[1], lanes[2]);
+        _mm_store_ps(lanes, maxv);
+        maxPos = glm::vec3(lanes[0], lanes[1], lanes[2]);
+        first = simdCount;
+    }
+#endif
+
+    assemble_scalar(streams, first, vertices, minPos, maxPos);
+    return {minPos, maxPos};
+}
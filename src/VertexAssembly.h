@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vk_types.h>
+
+namespace fastgltf
+{
+    class Asset;
+    struct Accessor;
+} // namespace fastgltf
+
+/**
+ * @brief Bulk conversion of glTF vertex attributes into the Vertex layout. The attributes are read straight from the
+ * buffers in one pass, which interleaves them and computes the position bounds at the same time, with SSE where the
+ * target has it.
+ *
+ */
+namespace vertexasm
+{
+    // float attribute data, element i starts at data + i * stride
+    struct FloatStream
+    {
+        const std::byte *data = nullptr;
+        size_t stride = 0;
+    };
+
+    // a stream without data gets the default of the attribute: normal (1, 0, 0), uv (0, 0), color (1, 1, 1, 1)
+    struct VertexStreams
+    {
+        FloatStream positions; // vec3
+        FloatStream normals;   // vec3
+        FloatStream uvs;       // vec2
+        FloatStream colors;    // vec3 or vec4
+        uint32_t colorComponents = 4;
+    };
+
+    struct PositionBounds
+    {
+        glm::vec3 min{0.f};
+        glm::vec3 max{0.f};
+    };
+
+    /**
+     * @brief Stream of an accessor that can be read in place: float components, no sparse substitution, and buffer
+     * data that is already in memory. Anything else (quantized or sparse attributes) has to be converted first.
+     *
+     * @param components number of floats per element the caller expects
+     */
+    std::optional<FloatStream> float_stream(const fastgltf::Asset &asset, const fastgltf::Accessor &accessor,
+                                            uint32_t components);
+
+    /**
+     * @brief Fill vertices from the streams, one vertex per element, and return the bounds of the positions.
+     *
+     */
+    PositionBounds assemble_vertices(const VertexStreams &streams, std::span<Vertex> vertices);
+} // namespace vertexasm
@@ -0,0 +1,179 @@
+// Loads gltf/glb files through loadGltf on a headless device and reports the time spent in every phase of the load,
+// the bytes that went through them and the peak memory of the process. Runs without a display, so a software driver
+// (lavapipe, swiftshader) is enough to track the loader over time.
+//
+// usage: loader_bench [--runs N] [--cache] [--csv path] file...
+//   --runs N     load every file N times, the scene is destroyed between runs (default 1)
+//   --cache      allow the scene cache, by default every run imports the source file
+//   --csv path   also write one line per run to path, for scripts
+#include "MaterialSystem.h"
+#include "vk_engine.h"
+#include "vk_loader.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+// psapi after windows.h
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    // peak resident memory of the process so far
+    size_t peak_memory_bytes()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters{};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return counters.PeakWorkingSetSize;
+        return 0;
+#else
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+
+    float megabytes(size_t bytes)
+    {
+        return bytes / (1024.f * 1024.f);
+    }
+
+    void print_run(const std::string &file, int run, const LoadStats &stats, float totalMs, size_t peakBytes)
+    {
+        fmt::println("{} (run {}{})", file, run + 1, stats.fromSceneCache ? ", from the scene cache" : "");
+        fmt::println("  file read          {:>9.2f} ms  {:>9.1f} MB", stats.fileReadMs, megabytes(stats.fileBytes));
+        fmt::println("  parse              {:>9.2f} ms", stats.parseMs);
+        fmt::println("  image decode       {:>9.2f} ms  {:>9.1f} MB texels", stats.imageDecodeMs,
+                     megabytes(stats.texelBytes));
+        fmt::println("  vertex conversion  {:>9.2f} ms  (bounds are computed in the same pass)",
+                     stats.vertexConversionMs);
+        fmt::println("  mesh processing    {:>9.2f} ms  {:>9.1f} MB vertices, {:.1f} MB indices",
+                     stats.meshProcessingMs, megabytes(stats.vertexBytes), megabytes(stats.indexBytes));
+        fmt::println("  gpu upload         {:>9.2f} ms  {:>9.1f} MB staged", stats.uploadMs,
+                     megabytes(stats.uploadBytes));
+        fmt::println("  descriptor writes  {:>9.2f} ms", stats.descriptorWriteMs);
+        fmt::println("  total              {:>9.2f} ms, peak memory {:.1f} MB", totalMs, megabytes(peakBytes));
+    }
+
+    void print_csv_header(FILE *out)
+    {
+        fmt::println(out, "file,run,scene_cache,file_read_ms,parse_ms,image_decode_ms,vertex_conversion_ms,"
+                     "mesh_processing_ms,upload_ms,descriptor_write_ms,total_ms,file_bytes,texel_bytes,vertex_bytes,"
+                     "index_bytes,upload_bytes,peak_memory_bytes");
+    }
+
+    void print_csv(FILE *out, const std::string &file, int run, const LoadStats &stats, float totalMs,
+                   size_t peakBytes)
+    {
+        fmt::println(out, "{},{},{},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{},{},{},{},{},{}", file,
+                     run + 1, stats.fromSceneCache ? 1 : 0, stats.fileReadMs, stats.parseMs, stats.imageDecodeMs,
+                     stats.vertexConversionMs, stats.meshProcessingMs, stats.uploadMs, stats.descriptorWriteMs,
+                     totalMs, stats.fileBytes, stats.texelBytes, stats.vertexBytes, stats.indexBytes,
+                     stats.uploadBytes, peakBytes);
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int runs = 1;
+    bool useSceneCache = false;
+    std::string csvPath;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--cache")
+            useSceneCache = true;
+        else if (arg == "--csv" && i + 1 < argc)
+            csvPath = argv[++i];
+        else
+            files.push_back(arg);
+    }
+
+    if (files.empty())
+    {
+        fmt::println("usage: loader_bench [--runs N] [--cache] [--csv path] file...");
+        return 2;
+    }
+
+    VulkanEngine engine;
+    engine.init_headless();
+
+    GLTFMRMaterialSystem materialSystem;
+    materialSystem.build_descriptors(engine._device, engine.getGPUResourceAllocator());
+
+    GLTFCreatorData creatorData = {};
+    creatorData._device = engine._device;
+    creatorData.gpuResourceAllocator = engine.getGPUResourceAllocator();
+    creatorData.defaultImage = engine._whiteImage;
+    creatorData.loadErrorImage = engine._errorCheckerboardImage;
+    creatorData._defaultSamplerLinear = engine._defaultSamplerLinear;
+    creatorData.materialSystemReference = &materialSystem;
+    creatorData.useSceneCache = useSceneCache;
+    creatorData.importOptions.textureCompressionBC = engine._textureCompressionBC;
+
+    // the loader logs to stdout as well, so the csv goes to its own file
+    FILE *csv = nullptr;
+    if (!csvPath.empty())
+    {
+        csv = std::fopen(csvPath.c_str(), "w");
+        if (csv == nullptr)
+        {
+            fmt::println("Failed to open {}", csvPath);
+            return 2;
+        }
+        print_csv_header(csv);
+    }
+
+    int status = 0;
+    uint64_t frame = 0;
+    for (const std::string &file : files)
+    {
+        for (int run = 0; run < runs; run++)
+        {
+            LoadStats stats{};
+            auto start = std::chrono::steady_clock::now();
+            std::optional<std::shared_ptr<sgraph::GLTFScene>> scene = loadGltf(creatorData, file, &stats);
+            auto end = std::chrono::steady_clock::now();
+
+            if (!scene.has_value())
+            {
+                fmt::println("Failed to load {}", file);
+                status = 1;
+                break;
+            }
+
+            float totalMs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.f;
+            size_t peakBytes = peak_memory_bytes();
+            print_run(file, run, stats, totalMs, peakBytes);
+            if (csv)
+                print_csv(csv, file, run, stats, totalMs, peakBytes);
+
+            // the next run uploads everything again. nothing is in flight, so the freed material entries can be reused
+            vkDeviceWaitIdle(engine._device);
+            scene->reset();
+            frame += FRAME_OVERLAP;
+            materialSystem.begin_frame(frame);
+        }
+    }
+
+    if (csv)
+        std::fclose(csv);
+
+    materialSystem.clear_resources(engine._device);
+    engine.cleanup();
+    return status;
+}
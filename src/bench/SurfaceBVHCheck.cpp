@@ -0,0 +1,289 @@
+// Checks the queries of SurfaceBVH against brute force over every live item, while items are streamed in, removed
+// and moved from several threads the way the scenes update it every frame. Run without arguments, or with the frame
+// count and the seed. Exits with 1 on the first mismatch.
+#include "SurfaceBVH.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <set>
+#include <unordered_map>
+
+namespace
+{
+    constexpr float WORLD_SIZE = 500.f;
+    constexpr float RAY_LENGTH = 2000.f;
+
+    struct Checker
+    {
+        std::mt19937 random;
+        SurfaceBVH bvh;
+        // a pool of its own, so the updates run on several threads however many cores the machine has
+        ThreadPool pool{4};
+        // the reference, every live item with its box
+        std::unordered_map<uint32_t, SurfaceBVH::Box> boxes;
+        std::vector<uint32_t> freeItems;
+        uint32_t nextItem = 0;
+
+        // how often every path of the tree was checked, a run that never took one proves nothing about it
+        size_t refitFrames = 0;
+        size_t tombstoneFrames = 0;
+        size_t parallelUpdates = 0;
+        size_t queries = 0;
+
+        float uniform(float min, float max)
+        {
+            return std::uniform_real_distribution<float>(min, max)(random);
+        }
+
+        SurfaceBVH::Box random_box()
+        {
+            glm::vec3 center(uniform(-WORLD_SIZE, WORLD_SIZE), uniform(-50.f, 50.f), uniform(-WORLD_SIZE, WORLD_SIZE));
+            glm::vec3 extents(uniform(0.1f, 5.f), uniform(0.1f, 5.f), uniform(0.1f, 5.f));
+            return SurfaceBVH::Box{center - extents, center + extents};
+        }
+
+        std::vector<uint32_t> live_items() const
+        {
+            std::vector<uint32_t> items;
+            items.reserve(boxes.size());
+            for (const auto &[item, box] : boxes)
+                items.push_back(item);
+            std::sort(items.begin(), items.end());
+            return items;
+        }
+
+        // ids of removed items are handed out again, like the proxy slots of the registry
+        void add(size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                uint32_t item = nextItem;
+                if (!freeItems.empty() && uniform(0.f, 1.f) < 0.5f)
+                {
+                    item = freeItems.back();
+                    freeItems.pop_back();
+                }
+                else
+                    nextItem++;
+
+                SurfaceBVH::Box box = random_box();
+                bvh.insert(item, box);
+                boxes[item] = box;
+            }
+        }
+
+        size_t remove(size_t count)
+        {
+            std::vector<uint32_t> items = live_items();
+            std::shuffle(items.begin(), items.end(), random);
+            items.resize(std::min(count, items.size()));
+            for (uint32_t item : items)
+            {
+                bvh.remove(item);
+                boxes.erase(item);
+                freeItems.push_back(item);
+            }
+            return items.size();
+        }
+
+        // moves a share of the items by a small step, split into batches on the pool like the scene sync
+        size_t move(float share, float step)
+        {
+            std::vector<uint32_t> items = live_items();
+            std::shuffle(items.begin(), items.end(), random);
+            items.resize(static_cast<size_t>(items.size() * share));
+
+            std::vector<SurfaceBVH::Box> moved(items.size());
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                glm::vec3 offset(uniform(-step, step), uniform(-step * 0.1f, step * 0.1f), uniform(-step, step));
+                SurfaceBVH::Box box = boxes[items[i]];
+                box.min += offset;
+                box.max += offset;
+                boxes[items[i]] = box;
+                moved[i] = box;
+            }
+
+            pool.parallel_for(items.size(), 64,
+                              [&](uint32_t, size_t begin, size_t end)
+                              {
+                                  for (size_t i = begin; i < end; i++)
+                                      bvh.update(items[i], moved[i]);
+                              });
+            if (pool.batch_count(items.size(), 64) > 1)
+                parallelUpdates++;
+            return items.size();
+        }
+
+        bool check_frustum()
+        {
+            glm::vec3 eye(uniform(-WORLD_SIZE, WORLD_SIZE), 10.f, uniform(-WORLD_SIZE, WORLD_SIZE));
+            glm::vec3 forward(uniform(-1.f, 1.f), uniform(-0.2f, 0.2f), uniform(-1.f, 1.f));
+            glm::mat4 viewproj = glm::perspective(glm::radians(70.f), 1.7f, 0.1f, 300.f) *
+                                 glm::lookAt(eye, eye + forward, glm::vec3(0.f, 1.f, 0.f));
+
+            // the planes of the clip volume, inside on the positive side
+            glm::mat4 rows = glm::transpose(viewproj);
+            std::array<glm::vec4, 6> planes = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1],
+                                               rows[3] - rows[1], rows[2],           rows[3] - rows[2]};
+            for (glm::vec4 &plane : planes)
+                plane /= glm::length(glm::vec3(plane));
+
+            std::set<uint32_t> visited;
+            bool duplicate = false;
+            bvh.query_frustum(planes, [&](uint32_t item) { duplicate |= !visited.insert(item).second; });
+
+            std::set<uint32_t> expected;
+            for (const auto &[item, box] : boxes)
+            {
+                glm::vec3 center = (box.min + box.max) * 0.5f;
+                glm::vec3 extents = (box.max - box.min) * 0.5f;
+                bool inside = std::all_of(planes.begin(), planes.end(),
+                                          [&](const glm::vec4 &p)
+                                          {
+                                              return glm::dot(glm::vec3(p), center) + p.w >=
+                                                     -glm::dot(glm::abs(glm::vec3(p)), extents);
+                                          });
+                if (inside)
+                    expected.insert(item);
+            }
+
+            if (duplicate || visited != expected)
+            {
+                fmt::println("frustum query visited {} item(s){}, brute force found {}", visited.size(),
+                             duplicate ? " with duplicates" : "", expected.size());
+                return false;
+            }
+            return true;
+        }
+
+        bool check_point()
+        {
+            // inside one of the items when there are any, so the query does not trivially come back empty
+            glm::vec3 point(uniform(-WORLD_SIZE, WORLD_SIZE), 0.f, uniform(-WORLD_SIZE, WORLD_SIZE));
+            if (!boxes.empty())
+            {
+                const SurfaceBVH::Box &box = boxes.begin()->second;
+                point = (box.min + box.max) * 0.5f;
+            }
+
+            std::set<uint32_t> visited;
+            bvh.query_point(point, [&](uint32_t item) { visited.insert(item); });
+
+            std::set<uint32_t> expected;
+            for (const auto &[item, box] : boxes)
+            {
+                if (glm::all(glm::greaterThanEqual(point, box.min)) && glm::all(glm::lessThanEqual(point, box.max)))
+                    expected.insert(item);
+            }
+
+            if (visited != expected)
+            {
+                fmt::println("point query visited {} item(s), brute force found {}", visited.size(), expected.size());
+                return false;
+            }
+            return true;
+        }
+
+        bool check_raycast()
+        {
+            glm::vec3 origin(uniform(-WORLD_SIZE, WORLD_SIZE), uniform(-60.f, 60.f), uniform(-WORLD_SIZE, WORLD_SIZE));
+            glm::vec3 direction =
+                glm::normalize(glm::vec3(uniform(-1.f, 1.f), uniform(-0.1f, 0.1f), uniform(-1.f, 1.f)));
+            std::optional<SurfaceBVH::RayHit> hit = bvh.raycast(origin, direction, RAY_LENGTH);
+
+            // nearest entry distance over every item, items hit at the same distance are equally right
+            std::optional<float> nearest;
+            glm::vec3 inverseDirection = 1.f / direction;
+            for (const auto &[item, box] : boxes)
+            {
+                glm::vec3 t0 = (box.min - origin) * inverseDirection;
+                glm::vec3 t1 = (box.max - origin) * inverseDirection;
+                glm::vec3 near = glm::min(t0, t1);
+                glm::vec3 far = glm::max(t0, t1);
+                float enter = std::max({near.x, near.y, near.z, 0.f});
+                float exit = std::min({far.x, far.y, far.z, RAY_LENGTH});
+                if (enter <= exit && (!nearest || enter < *nearest))
+                    nearest = enter;
+            }
+
+            bool same = hit.has_value() == nearest.has_value() &&
+                        (!hit || std::abs(hit->distance - *nearest) <= 1e-4f * std::max(1.f, *nearest));
+            if (hit && boxes.find(hit->item) == boxes.end())
+                same = false;
+            if (!same)
+            {
+                fmt::println("raycast hit {} at {}, brute force nearest at {}", hit ? int64_t(hit->item) : -1,
+                             hit ? hit->distance : -1.f, nearest.value_or(-1.f));
+                return false;
+            }
+            return true;
+        }
+
+        bool check_queries()
+        {
+            if (bvh.size() != boxes.size())
+            {
+                fmt::println("tree holds {} item(s), {} are live", bvh.size(), boxes.size());
+                return false;
+            }
+            queries++;
+            return check_frustum() && check_point() && check_raycast();
+        }
+    };
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    uint32_t frames = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 300;
+    uint32_t seed = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 1;
+
+    Checker checker;
+    checker.random.seed(seed);
+
+    // items removed since the last rebuild stay in their leaves as tombstones
+    size_t removedSinceRebuild = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        // stream a scene in first, then a trickle of adds and removes while everything keeps moving
+        size_t rebuilds = checker.bvh.rebuild_count();
+        checker.add(frame < 10 ? 2000 : static_cast<size_t>(checker.uniform(0.f, 30.f)));
+        removedSinceRebuild += checker.remove(static_cast<size_t>(checker.uniform(0.f, 20.f)));
+        size_t moved = checker.move(0.3f, frame % 50 == 49 ? 50.f : 2.f);
+        checker.bvh.commit();
+
+        if (checker.bvh.rebuild_count() != rebuilds)
+            removedSinceRebuild = 0;
+        else
+        {
+            checker.refitFrames += moved > 0 ? 1 : 0;
+            checker.tombstoneFrames += removedSinceRebuild > 0 ? 1 : 0;
+        }
+
+        if (!checker.check_queries())
+        {
+            fmt::println("mismatch at frame {} with seed {}", frame, seed);
+            return 1;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    fmt::println("{} frame(s), {} item(s) left, {} rebuild(s) in {:.1f} ms", frames, checker.boxes.size(),
+                 checker.bvh.rebuild_count(), std::chrono::duration<double, std::milli>(end - start).count());
+    fmt::println("queries checked after {} refit(s), with tombstones {} time(s), {} parallel update(s)",
+                 checker.refitFrames, checker.tombstoneFrames, checker.parallelUpdates);
+
+    // every path has to have been checked at least once
+    if (checker.refitFrames == 0 || checker.tombstoneFrames == 0 || checker.parallelUpdates == 0)
+    {
+        fmt::println("not every update path of the tree was exercised");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,216 @@
+// Checks the incremental propagation of sgraph::TransformStore against a full recompute of every world matrix, on a
+// random nested hierarchy whose local matrices and root are changed a few at a time. Run without arguments, or with
+// the frame count and the seed. Exits with 1 on the first mismatch.
+#include "sgraph/TransformStore.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+namespace
+{
+    constexpr uint32_t NODE_COUNT = 20'000;
+    constexpr uint32_t MAX_DEPTH = 24;
+
+    struct Checker
+    {
+        std::mt19937 random;
+        sgraph::TransformStore store;
+        glm::mat4 root{1.f};
+
+        // how often the incremental path ran, and how much less it recomputed than a full sweep
+        size_t partialUpdates = 0;
+        size_t nestedDirtyUpdates = 0;
+        size_t recomputed = 0;
+
+        float uniform(float min, float max)
+        {
+            return std::uniform_real_distribution<float>(min, max)(random);
+        }
+
+        glm::mat4 random_local()
+        {
+            glm::mat4 local = glm::translate(glm::mat4(1.f), glm::vec3(uniform(-2.f, 2.f), uniform(-2.f, 2.f),
+                                                                        uniform(-2.f, 2.f)));
+            local = glm::rotate(local, uniform(0.f, 6.28f),
+                                glm::normalize(glm::vec3(uniform(-1.f, 1.f), uniform(-1.f, 1.f), 1.f)));
+            return glm::scale(local, glm::vec3(uniform(0.9f, 1.1f)));
+        }
+
+        // depth first, each node goes under a random ancestor of the previous one, so subtrees nest deeply and
+        // end at every depth
+        void build()
+        {
+            std::vector<uint32_t> path;
+            for (uint32_t i = 0; i < NODE_COUNT; i++)
+            {
+                size_t keep = std::uniform_int_distribution<size_t>(0, path.size())(random);
+                // mostly go deeper, sometimes back up or start a new root
+                if (uniform(0.f, 1.f) < 0.7f && path.size() < MAX_DEPTH)
+                    keep = path.size();
+                path.resize(keep);
+
+                uint32_t parent = path.empty() ? sgraph::TransformStore::NO_PARENT : path.back();
+                path.push_back(store.add(parent, random_local()));
+            }
+        }
+
+        // every world matrix from scratch, parents first
+        std::vector<glm::mat4> full_recompute() const
+        {
+            std::vector<glm::mat4> worlds(store.size());
+            for (uint32_t i = 0; i < store.size(); i++)
+            {
+                uint32_t parent = store.parent(i);
+                worlds[i] = (parent == sgraph::TransformStore::NO_PARENT ? root : worlds[parent]) * store.local(i);
+            }
+            return worlds;
+        }
+
+        bool same(const glm::mat4 &a, const glm::mat4 &b) const
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                for (int r = 0; r < 4; r++)
+                {
+                    if (std::abs(a[c][r] - b[c][r]) > 1e-4f * std::max(1.f, std::abs(b[c][r])))
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        bool check_frame(uint32_t frame)
+        {
+            std::vector<glm::mat4> before(store.size());
+            for (uint32_t i = 0; i < store.size(); i++)
+                before[i] = store.world(i);
+
+            // a few local changes, sometimes one inside the subtree of another, sometimes the root
+            std::vector<uint32_t> changed;
+            uint32_t changes = std::uniform_int_distribution<uint32_t>(1, 20)(random);
+            for (uint32_t i = 0; i < changes; i++)
+            {
+                uint32_t handle = std::uniform_int_distribution<uint32_t>(0, NODE_COUNT - 1)(random);
+                changed.push_back(handle);
+                store.set_local(handle, random_local());
+                uint32_t parent = store.parent(handle);
+                if (parent != sgraph::TransformStore::NO_PARENT && uniform(0.f, 1.f) < 0.2f)
+                {
+                    changed.push_back(parent);
+                    store.set_local(parent, random_local());
+                    nestedDirtyUpdates++;
+                }
+            }
+            bool rootChanged = frame % 25 == 24;
+            if (rootChanged)
+            {
+                root = random_local();
+                store.set_root(root);
+            }
+
+            size_t updated = store.update();
+            std::vector<glm::mat4> expected = full_recompute();
+
+            // every entry against the full recompute
+            for (uint32_t i = 0; i < store.size(); i++)
+            {
+                if (!same(store.world(i), expected[i]))
+                {
+                    fmt::println("world matrix {} differs from the full recompute", i);
+                    return false;
+                }
+            }
+
+            // the swept ranges account for the count, do not overlap and cover every changed subtree
+            std::vector<uint8_t> inRange(store.size(), 0);
+            size_t sweptCount = 0;
+            for (auto [first, end] : store.swept())
+            {
+                sweptCount += end - first;
+                for (uint32_t i = first; i < end; i++)
+                {
+                    if (inRange[i])
+                    {
+                        fmt::println("entry {} is in two swept ranges", i);
+                        return false;
+                    }
+                    inRange[i] = 1;
+                }
+            }
+            if (sweptCount != updated)
+            {
+                fmt::println("update returned {}, the swept ranges hold {}", updated, sweptCount);
+                return false;
+            }
+            for (uint32_t handle : changed)
+            {
+                if (!inRange[handle])
+                {
+                    fmt::println("changed entry {} was not swept", handle);
+                    return false;
+                }
+            }
+            for (uint32_t i = 0; i < store.size(); i++)
+            {
+                uint32_t parent = store.parent(i);
+                if (parent != sgraph::TransformStore::NO_PARENT && inRange[parent] && !inRange[i])
+                {
+                    fmt::println("entry {} was not swept with its parent {}", i, parent);
+                    return false;
+                }
+                // outside the swept ranges nothing may have been touched
+                if (!inRange[i] && store.world(i) != before[i])
+                {
+                    fmt::println("entry {} changed outside the swept ranges", i);
+                    return false;
+                }
+            }
+
+            if (!rootChanged)
+            {
+                partialUpdates += updated < store.size() ? 1 : 0;
+                recomputed += updated;
+            }
+            return true;
+        }
+    };
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    uint32_t frames = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 200;
+    uint32_t seed = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 1;
+
+    Checker checker;
+    checker.random.seed(seed);
+    checker.build();
+    checker.store.update();
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        if (!checker.check_frame(frame))
+        {
+            fmt::println("mismatch at frame {} with seed {}", frame, seed);
+            return 1;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    size_t partialFrames = std::max<size_t>(checker.partialUpdates, 1);
+    fmt::println("{} frame(s) over {} transforms in {:.1f} ms", frames, checker.store.size(),
+                 std::chrono::duration<double, std::milli>(end - start).count());
+    fmt::println("{} partial update(s), {} with nested dirty entries, {:.0f} matrices recomputed on average",
+                 checker.partialUpdates, checker.nestedDirtyUpdates, double(checker.recomputed) / partialFrames);
+
+    // the incremental path has to have been checked, a run of full sweeps proves nothing about it
+    if (checker.partialUpdates == 0 || checker.nestedDirtyUpdates == 0)
+    {
+        fmt::println("the incremental update path was not exercised");
+        return 1;
+    }
+    return 0;
+}
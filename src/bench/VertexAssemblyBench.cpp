@@ -0,0 +1,185 @@
+// Compares the bulk vertex assembly of the loader with the per element accessor iteration it replaced, on large
+// synthetic meshes. Run without arguments, or with vertex counts to measure.
+#include "VertexAssembly.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fastgltf/core.hpp>
+#include <fastgltf/glm_element_traits.hpp>
+#include <fastgltf/tools.hpp>
+#include <random>
+
+namespace
+{
+    constexpr int REPETITIONS = 5;
+
+    enum AttributeSlot
+    {
+        Position,
+        Normal,
+        Uv,
+        Color,
+        SlotCount
+    };
+
+    constexpr uint32_t COMPONENTS[SlotCount] = {3, 3, 2, 4};
+    constexpr fastgltf::AccessorType TYPES[SlotCount] = {fastgltf::AccessorType::Vec3, fastgltf::AccessorType::Vec3,
+                                                         fastgltf::AccessorType::Vec2, fastgltf::AccessorType::Vec4};
+
+    // one buffer with the four attributes, either one after the other or interleaved in a single view
+    fastgltf::Asset make_asset(size_t vertexCount, bool interleaved)
+    {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> distribution(-100.f, 100.f);
+
+        size_t vertexSize = 0;
+        for (uint32_t components : COMPONENTS)
+            vertexSize += components * sizeof(float);
+
+        std::vector<std::byte> bytes(vertexCount * vertexSize);
+        for (size_t i = 0; i < bytes.size(); i += sizeof(float))
+        {
+            float value = distribution(random);
+            memcpy(bytes.data() + i, &value, sizeof(float));
+        }
+
+        fastgltf::Asset asset;
+        asset.buffers.push_back(fastgltf::Buffer{bytes.size(), fastgltf::sources::Vector{std::move(bytes)}, {}});
+
+        size_t offset = 0;
+        for (int slot = 0; slot < SlotCount; slot++)
+        {
+            size_t elementSize = COMPONENTS[slot] * sizeof(float);
+
+            fastgltf::Accessor accessor{};
+            accessor.count = vertexCount;
+            accessor.type = TYPES[slot];
+            accessor.componentType = fastgltf::ComponentType::Float;
+            if (interleaved)
+            {
+                if (asset.bufferViews.empty())
+                {
+                    fastgltf::BufferView view{};
+                    view.bufferIndex = 0;
+                    view.byteLength = vertexCount * vertexSize;
+                    view.byteStride = vertexSize;
+                    asset.bufferViews.push_back(std::move(view));
+                }
+                accessor.bufferViewIndex = 0;
+                accessor.byteOffset = offset;
+            }
+            else
+            {
+                fastgltf::BufferView view{};
+                view.bufferIndex = 0;
+                view.byteOffset = offset * vertexCount;
+                view.byteLength = elementSize * vertexCount;
+                asset.bufferViews.push_back(std::move(view));
+                accessor.bufferViewIndex = asset.bufferViews.size() - 1;
+            }
+            asset.accessors.push_back(std::move(accessor));
+            offset += elementSize;
+        }
+
+        return asset;
+    }
+
+    // the loader before the bulk path: one callback per element and attribute, then a pass for the bounds
+    vertexasm::PositionBounds assemble_per_element(const fastgltf::Asset &asset, std::span<Vertex> vertices)
+    {
+        fastgltf::iterateAccessorWithIndex<glm::vec3>(asset, asset.accessors[Position],
+                                                      [&](glm::vec3 v, size_t index)
+                                                      {
+                                                          Vertex newvtx;
+                                                          newvtx.position = v;
+                                                          newvtx.normal = {1, 0, 0};
+                                                          newvtx.color = glm::vec4{1.f};
+                                                          newvtx.uv_x = 0;
+                                                          newvtx.uv_y = 0;
+                                                          vertices[index] = newvtx;
+                                                      });
+        fastgltf::iterateAccessorWithIndex<glm::vec3>(asset, asset.accessors[Normal], [&](glm::vec3 v, size_t index)
+                                                      { vertices[index].normal = v; });
+        fastgltf::iterateAccessorWithIndex<glm::vec2>(asset, asset.accessors[Uv],
+                                                      [&](glm::vec2 v, size_t index)
+                                                      {
+                                                          vertices[index].uv_x = v.x;
+                                                          vertices[index].uv_y = v.y;
+                                                      });
+        fastgltf::iterateAccessorWithIndex<glm::vec4>(asset, asset.accessors[Color], [&](glm::vec4 v, size_t index)
+                                                      { vertices[index].color = v; });
+
+        vertexasm::PositionBounds bounds{vertices[0].position, vertices[0].position};
+        for (const Vertex &vertex : vertices)
+        {
+            bounds.min = glm::min(bounds.min, vertex.position);
+            bounds.max = glm::max(bounds.max, vertex.position);
+        }
+        return bounds;
+    }
+
+    vertexasm::PositionBounds assemble_bulk(const fastgltf::Asset &asset, std::span<Vertex> vertices)
+    {
+        vertexasm::VertexStreams streams;
+        streams.positions = *vertexasm::float_stream(asset, asset.accessors[Position], COMPONENTS[Position]);
+        streams.normals = *vertexasm::float_stream(asset, asset.accessors[Normal], COMPONENTS[Normal]);
+        streams.uvs = *vertexasm::float_stream(asset, asset.accessors[Uv], COMPONENTS[Uv]);
+        streams.colors = *vertexasm::float_stream(asset, asset.accessors[Color], COMPONENTS[Color]);
+        return vertexasm::assemble_vertices(streams, vertices);
+    }
+
+    // best of a few runs, in milliseconds
+    template <typename Function> double measure(Function &&function)
+    {
+        double best = 0;
+        for (int i = 0; i < REPETITIONS; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            auto end = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double, std::milli>(end - start).count();
+            best = i == 0 ? elapsed : std::min(best, elapsed);
+        }
+        return best;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::vector<size_t> counts = {100'000, 1'000'000, 4'000'000};
+    if (argc > 1)
+    {
+        counts.clear();
+        for (int i = 1; i < argc; i++)
+            counts.push_back(std::strtoull(argv[i], nullptr, 10));
+    }
+
+    int status = 0;
+    fmt::println("{:>10} {:>12} {:>14} {:>10} {:>8}", "vertices", "layout", "per element ms", "bulk ms", "speedup");
+    for (size_t count : counts)
+    {
+        if (count == 0)
+            continue;
+
+        for (bool interleaved : {false, true})
+        {
+            fastgltf::Asset asset = make_asset(count, interleaved);
+            std::vector<Vertex> reference(count), bulk(count);
+
+            vertexasm::PositionBounds referenceBounds, bulkBounds;
+            double perElementMs = measure([&] { referenceBounds = assemble_per_element(asset, reference); });
+            double bulkMs = measure([&] { bulkBounds = assemble_bulk(asset, bulk); });
+
+            // both paths have to produce the same vertices, or the numbers mean nothing
+            bool same = memcmp(reference.data(), bulk.data(), count * sizeof(Vertex)) == 0 &&
+                        referenceBounds.min == bulkBounds.min && referenceBounds.max == bulkBounds.max;
+            if (!same)
+                status = 1;
+
+            fmt::println("{:>10} {:>12} {:>14.2f} {:>10.2f} {:>7.2f}x{}", count, interleaved ? "interleaved" : "separate",
+                         perElementMs, bulkMs, perElementMs / bulkMs, same ? "" : "  MISMATCH");
+        }
+    }
+
+    return status;
+}
@@ -1,26 +1,132 @@
 #include "PBRShadingFeature.h"
 #include "MaterialSystem.h"
+#include "RenderProxyRegistry.h"
 #include "RendergraphBuilder.h"
+#include "ThreadPool.h"
 #include "fmt/base.h"
 #include "vk_engine.h"
 #include "vk_initializers.h"
 #include "vk_pipelines.h"
 #include "vk_types.h"
 #include <algorithm>
+#include <array>
 #include <memory>
 
-// forward declaration for now, TODO: come back and move this function here. remove from VKEngine.
-bool is_visible(const RenderObject &obj, const glm::mat4 &viewproj);
+namespace
+{
+    // clip planes of a matrix, in the space the matrix transforms from. normalized so plane distances are in that
+    // space's units
+    struct FrustumPlanes
+    {
+        std::array<glm::vec4, 6> planes;
+
+        explicit FrustumPlanes(const glm::mat4 &m)
+        {
+            glm::mat4 t = glm::transpose(m);
+            planes[0] = t[3] + t[0]; // left
+            planes[1] = t[3] - t[0]; // right
+            planes[2] = t[3] + t[1]; // bottom
+            planes[3] = t[3] - t[1]; // top
+            planes[4] = t[2];        // z >= 0, works for both depth directions
+            planes[5] = t[3] - t[2]; // z <= w
+            for (glm::vec4 &p : planes)
+                p /= glm::length(glm::vec3(p));
+        }
+
+        // false when the box is entirely outside one of the planes
+        bool test_box(const glm::vec3 &center, const glm::vec3 &extents) const
+        {
+            for (const glm::vec4 &p : planes)
+            {
+                float distance = glm::dot(glm::vec3(p), center) + p.w;
+                float reach = glm::dot(glm::abs(glm::vec3(p)), extents);
+                if (distance < -reach)
+                    return false;
+            }
+            return true;
+        }
+
+        // -1 outside, 0 intersecting, 1 inside
+        int test_sphere(const glm::vec4 &sphere) const
+        {
+            int result = 1;
+            for (const glm::vec4 &p : planes)
+            {
+                float distance = glm::dot(glm::vec3(p), glm::vec3(sphere)) + p.w;
+                if (distance < -sphere.w)
+                    return -1;
+                if (distance < sphere.w)
+                    result = 0;
+            }
+            return result;
+        }
+    };
+
+    bool meshlet_backfacing(const Meshlet &meshlet, const glm::vec3 &localCamera)
+    {
+        if (meshlet.coneAxisCutoff.w >= 1.f)
+            return false;
+        glm::vec3 toApex = glm::vec3(meshlet.coneApex) - localCamera;
+        return glm::dot(glm::normalize(toApex), glm::vec3(meshlet.coneAxisCutoff)) >= meshlet.coneAxisCutoff.w;
+    }
+
+    // diameter in pixels of the bounding sphere of the surface, capped at maxSize when the camera is inside it
+    float projected_size(const RenderObject &r, const glm::vec3 &cameraPos, float pixelsPerUnit, float maxSize)
+    {
+        float distance = glm::length(r.worldBounds.center - cameraPos) - r.worldBounds.radius;
+        if (distance <= 0.f)
+            return maxSize;
+        return std::min(2.f * r.worldBounds.radius * pixelsPerUnit / distance, maxSize);
+    }
+
+    // coarsest lod of the surface that stays under maxPixelError on screen. pixelsPerUnit is the size in pixels of
+    // one world unit at distance 1
+    uint32_t select_lod(const RenderObject &r, const glm::vec3 &cameraPos, float pixelsPerUnit, float maxPixelError)
+    {
+        if (r.lodCount < 2)
+            return 0;
+
+        // the world radius is the local one times the largest axis scale
+        float scale = r.bounds.sphereRadius > 0.f ? r.worldBounds.radius / r.bounds.sphereRadius : 1.f;
+        float distance = glm::length(r.worldBounds.center - cameraPos) - r.worldBounds.radius;
+        if (distance <= 0.f)
+            return 0;
+
+        uint32_t lod = 0;
+        while (lod + 1 < r.lodCount && r.lods[lod + 1].error * scale * pixelsPerUnit / distance <= maxPixelError)
+            lod++;
+        return lod;
+    }
+
+    // tests every surface against the frustum, in batches across the pool when no bvh is around. each batch fills
+    // its own list and the lists are joined in batch order, so the result does not depend on how the threads ran
+    void cull_linear(const std::vector<RenderObject> &surfaces, const FrustumPlanes &frustum, size_t batchSize,
+                     std::vector<uint32_t> &visible)
+    {
+        ThreadPool &pool = ThreadPool::Get();
+        std::vector<std::vector<uint32_t>> batchVisible(pool.batch_count(surfaces.size(), batchSize));
+        pool.parallel_for(surfaces.size(), batchSize,
+                          [&](uint32_t batch, size_t begin, size_t end)
+                          {
+                              for (size_t i = begin; i < end; i++)
+                              {
+                                  const WorldBounds &bounds = surfaces[i].worldBounds;
+                                  if (frustum.test_box(bounds.center, bounds.extents))
+                                      batchVisible[batch].push_back(static_cast<uint32_t>(i));
+                              }
+                          });
+        for (const std::vector<uint32_t> &indices : batchVisible)
+            visible.insert(visible.end(), indices.begin(), indices.end());
+    }
+} // namespace
 
 rgraph::PBRShadingFeature::PBRShadingFeature(DrawContext &drwCtx, VkDevice _device,
                                              GLTFMRMaterialSystemCreateInfo &materialSystemCreateInfo,
-                                             GPUSceneData &scnData, VkDescriptorSetLayout gpuSceneLayout,
-                                             DeletionQueue &delQueue)
-    : drawContext(drwCtx), sceneData(scnData)
+                                             GLTFMRMaterialSystem *materialSystem, GPUSceneData &scnData,
+                                             VkDescriptorSetLayout gpuSceneLayout, DeletionQueue &delQueue)
+    : materialSystem(materialSystem), drawContext(drwCtx), sceneData(scnData)
 {
     _gpuSceneDataDescriptorLayout = gpuSceneLayout;
-    materialSystem = std::make_shared<GLTFMRMaterialSystem>();
-    materialSystem->build_descriptors(_device);
 
     // create descriptor set for lights.
     {
@@ -34,7 +140,6 @@ rgraph::PBRShadingFeature::PBRShadingFeature(DrawContext &drwCtx, VkDevice _devi
     delQueue.push_function(
         [_device, this]()
         {
-            materialSystem->clear_resources(_device);
             vkDestroyDescriptorSetLayout(_device, lightDescriptorSetLayout, nullptr);
             vkDestroyPipelineLayout(_device, transparentPipeline.layout, nullptr);
             vkDestroyPipeline(_device, transparentPipeline.pipeline, nullptr);
@@ -56,7 +161,7 @@ void rgraph::PBRShadingFeature::Register(rgraph::RendergraphBuilder *builder)
         [&](PassExecution &passExec) { renderScene(passExec); });
 }
 
-std::shared_ptr<GLTFMRMaterialSystem> rgraph::PBRShadingFeature::getMaterialSystemReference()
+GLTFMRMaterialSystem *rgraph::PBRShadingFeature::getMaterialSystemReference()
 {
     return materialSystem;
 }
@@ -71,20 +176,25 @@ void rgraph::PBRShadingFeature::renderScene(rgraph::PassExecution &passExec)
     std::vector<uint32_t> opaque_draws;
     opaque_draws.reserve(drawContext.OpaqueSurfaces.size());
 
-    for (int i = 0; i < drawContext.OpaqueSurfaces.size(); i++)
-        if (is_visible(drawContext.OpaqueSurfaces[i], sceneData.viewproj))
-            opaque_draws.push_back(i);
+    // the bvh of the proxy registry rejects whole groups of surfaces at once
+    FrustumPlanes viewFrustum(sceneData.viewproj);
+    if (drawContext.proxies)
+        drawContext.proxies->cull_opaque(viewFrustum.planes, opaque_draws);
+    else
+        cull_linear(drawContext.OpaqueSurfaces, viewFrustum, cullBatch, opaque_draws);
 
-    // sort the opaque surfaces by material and mesh
+    // sort the opaque surfaces by material and mesh. meshes share the geometry pool buffers, so the index buffer
+    // only changes between pool pages
     std::sort(opaque_draws.begin(), opaque_draws.end(),
               [&](const auto &iA, const auto &iB)
               {
                   const RenderObject &A = drawContext.OpaqueSurfaces[iA];
                   const RenderObject &B = drawContext.OpaqueSurfaces[iB];
-                  if (A.material == B.material)
-                      return A.indexBuffer < B.indexBuffer;
-                  else
+                  if (A.material != B.material)
                       return A.material < B.material;
+                  if (A.indexBuffer != B.indexBuffer)
+                      return A.indexBuffer < B.indexBuffer;
+                  return A.firstIndex < B.firstIndex;
               });
 
     AllocatedBuffer gpuSceneDataBuffer = passExec.allocatedBuffers["gpuSceneBuffer"];
@@ -128,11 +238,22 @@ void rgraph::PBRShadingFeature::renderScene(rgraph::PassExecution &passExec)
     MaterialInstance *lastMaterial = nullptr;
     VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
 
+    // projection scale for lod selection, proj[1][1] is 1 / tan(fov / 2)
+    float pixelsPerUnit = std::abs(sceneData.proj[1][1]) * passExec._drawExtent.height * 0.5f;
+
+    float maxScreenSize = static_cast<float>(std::max(passExec._drawExtent.width, passExec._drawExtent.height));
+
+    drawContext.visibleMaterials.clear();
+
     auto draw = [&](const RenderObject &r)
     {
+        // the texture streamer sizes the resident mips of the material to its largest surface
+        float screenSize = projected_size(r, glm::vec3(sceneData.cameraPos), pixelsPerUnit, maxScreenSize);
         if (r.material != lastMaterial)
         {
             lastMaterial = r.material;
+            // draws are sorted by material, so this lists most materials once
+            drawContext.visibleMaterials.push_back({r.material, screenSize});
             // rebind pipeline and descriptors if the material changed
             if (r.material->passType != lastPass)
             {
@@ -141,10 +262,11 @@ void rgraph::PBRShadingFeature::renderScene(rgraph::PassExecution &passExec)
                                    ? &transparentPipeline
                                    : &opaquePipeline; // change to use passtype instead of pipeline.
 
-                VkDescriptorSet ds[] = {globalDescriptor, lightDescriptor};
+                // every material lives in the bindless set, it only changes with the pipeline
+                VkDescriptorSet ds[] = {globalDescriptor, lightDescriptor, materialSystem->materialSet};
 
                 vkCmdBindPipeline(passExec.cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lastPipeline->pipeline);
-                vkCmdBindDescriptorSets(passExec.cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lastPipeline->layout, 0, 2, ds,
+                vkCmdBindDescriptorSets(passExec.cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lastPipeline->layout, 0, 3, ds,
                                         0, nullptr);
 
                 VkViewport viewport = {};
@@ -165,9 +287,11 @@ void rgraph::PBRShadingFeature::renderScene(rgraph::PassExecution &passExec)
 
                 vkCmdSetScissor(passExec.cmd, 0, 1, &scissor);
             }
-
-            vkCmdBindDescriptorSets(passExec.cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lastPipeline->layout, 2, 1,
-                                    &r.material->materialSet, 0, nullptr);
+        }
+        else
+        {
+            float &largest = drawContext.visibleMaterials.back().screenSize;
+            largest = std::max(largest, screenSize);
         }
         // rebind index buffer if needed
         if (r.indexBuffer != lastIndexBuffer)
@@ -179,14 +303,66 @@ void rgraph::PBRShadingFeature::renderScene(rgraph::PassExecution &passExec)
         GPUDrawPushConstants push_constants;
         push_constants.worldMatrix = r.transform;
         push_constants.vertexBuffer = r.vertexBufferAddress;
+        push_constants.vertexFormat = r.vertexFormat;
+        push_constants.materialIndex = r.material->materialIndex;
+        push_constants.quantization = r.quantization;
 
         vkCmdPushConstants(passExec.cmd, lastPipeline->layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
                            sizeof(GPUDrawPushConstants), &push_constants);
 
-        vkCmdDrawIndexed(passExec.cmd, r.indexCount, 1, r.firstIndex, 0, 0);
-        // stats
-        passExec.drawCalls++;
-        passExec.triangles += r.indexCount / 3;
+        auto drawRange = [&](uint32_t firstIndex, uint32_t indexCount)
+        {
+            vkCmdDrawIndexed(passExec.cmd, indexCount, 1, firstIndex, r.vertexOffset, 0);
+            // stats
+            passExec.drawCalls++;
+            passExec.triangles += indexCount / 3;
+        };
+
+        uint32_t lod = select_lod(r, glm::vec3(sceneData.cameraPos), pixelsPerUnit, lodPixelError);
+        if (lod > 0)
+        {
+            drawRange(r.meshFirstIndex + r.lods[lod].firstIndex, r.lods[lod].indexCount);
+            return;
+        }
+
+        if (r.meshletCount <= 1)
+        {
+            drawRange(r.firstIndex, r.indexCount);
+            return;
+        }
+
+        // cull the meshlets in mesh space, visible neighbours are merged back into one draw
+        FrustumPlanes frustum(sceneData.viewproj * r.transform);
+        glm::vec4 surfaceSphere(r.bounds.origin, r.bounds.sphereRadius);
+        if (frustum.test_sphere(surfaceSphere) > 0 && !meshletConeCulling)
+        {
+            drawRange(r.firstIndex, r.indexCount);
+            return;
+        }
+
+        glm::vec3 localCamera = glm::inverse(r.transform) * glm::vec4(glm::vec3(sceneData.cameraPos), 1.f);
+        uint32_t runFirst = 0, runCount = 0;
+        for (uint32_t m = 0; m < r.meshletCount; m++)
+        {
+            const Meshlet &meshlet = r.meshlets[m];
+            bool visible = frustum.test_sphere(meshlet.boundingSphere) >= 0 &&
+                           !(meshletConeCulling && meshlet_backfacing(meshlet, localCamera));
+            if (!visible)
+                continue;
+
+            uint32_t first = r.meshFirstIndex + meshlet.firstIndex;
+            if (runCount > 0 && runFirst + runCount == first)
+            {
+                runCount += meshlet.indexCount;
+                continue;
+            }
+            if (runCount > 0)
+                drawRange(runFirst, runCount);
+            runFirst = first;
+            runCount = meshlet.indexCount;
+        }
+        if (runCount > 0)
+            drawRange(runFirst, runCount);
     };
 
     for (auto &r : opaque_draws)
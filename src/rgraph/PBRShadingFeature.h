@@ -17,13 +17,15 @@ namespace rgraph
     class PBRShadingFeature : public IFeature
     {
       public:
+        // the material system is owned by the engine, its bindless set is shared by every scene
         PBRShadingFeature(DrawContext &drwCtx, VkDevice _device,
-                          GLTFMRMaterialSystemCreateInfo &materialSystemCreateInfo, GPUSceneData &sceneData,
+                          GLTFMRMaterialSystemCreateInfo &materialSystemCreateInfo,
+                          GLTFMRMaterialSystem *materialSystem, GPUSceneData &sceneData,
                           VkDescriptorSetLayout gpuSceneLayout, DeletionQueue &delQueue);
 
         void Register(RendergraphBuilder *builder) override;
 
-        std::shared_ptr<GLTFMRMaterialSystem> getMaterialSystemReference();
+        GLTFMRMaterialSystem *getMaterialSystemReference();
 
       private:
         // lighting data struct.
@@ -44,7 +46,7 @@ namespace rgraph
         // execution lambdas for run.
         void renderScene(PassExecution &passExec);
 
-        std::shared_ptr<GLTFMRMaterialSystem> materialSystem;
+        GLTFMRMaterialSystem *materialSystem;
 
         MaterialPipeline opaquePipeline;
         MaterialPipeline transparentPipeline;
@@ -53,5 +55,12 @@ namespace rgraph
         VkDescriptorSetLayout lightDescriptorSetLayout;
         DrawContext &drawContext;
         GPUSceneData &sceneData;
+
+        // skip meshlets facing away from the camera. off while the pipelines draw both faces of every triangle
+        bool meshletConeCulling = false;
+        // the coarsest lod whose error projects to at most this many pixels is drawn
+        float lodPixelError = 1.f;
+        // surfaces per batch when culling on the thread pool without a bvh
+        static constexpr size_t cullBatch = 1024;
     };
 } // namespace rgraph
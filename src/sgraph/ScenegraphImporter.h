@@ -1,5 +1,6 @@
 #pragma once
 
+#include "AsyncSceneLoader.h"
 #include "IScenegraph.h"
 #include "Scenegraph.h"
 #include "ScenegraphStructs.h"
@@ -20,7 +21,9 @@ namespace sgraph
     {
 
       public:
-        ScenegraphImporter(GLTFCreatorData &data) : creatorData(data)
+        // with a loader, gltf files load in the background and show up in the scenegraph once they are ready
+        ScenegraphImporter(GLTFCreatorData &data, AsyncSceneLoader *loader = nullptr)
+            : creatorData(data), sceneLoader(loader)
         {
         }
 
@@ -57,6 +60,17 @@ namespace sgraph
         {
             string name, filePath;
             input >> name >> filePath;
+
+            if (sceneLoader)
+            {
+                // the scenegraph is built right away, the node gets its scene when the loader hands it out
+                shared_ptr<DeferredNode> deferred = make_shared<DeferredNode>();
+                sceneLoader->request(name, filePath, creatorData,
+                                     [deferred](shared_ptr<GLTFScene> scene) { deferred->target = scene; });
+                nodes[name] = deferred;
+                return;
+            }
+
             string_view fileView = filePath;
             auto gltfNode = loadGltf(creatorData, fileView);
             if (!gltfNode.has_value())
@@ -131,6 +145,7 @@ namespace sgraph
 
       private:
         GLTFCreatorData &creatorData;
+        AsyncSceneLoader *sceneLoader;
         unordered_map<string, std::shared_ptr<INode>> nodes;
         std::shared_ptr<INode> root;
     };
@@ -1,72 +1,112 @@
 #include "ScenegraphStructs.h"
+#include "RenderProxyRegistry.h"
 #include "vk_engine.h"
 #include "vk_types.h"
 
-void sgraph::GLTFMeshNode::Draw(const glm::mat4 &topMatrix, DrawContext &ctx)
+namespace
 {
-    glm::mat4 nodeMatrix = topMatrix * worldTransform;
+    GPULightingData light_data(const LightingData &light, const glm::mat4 &transform)
+    {
+        GPULightingData lData;
+        lData.color = light.color;
+        lData.intensity = light.intensity;
+        lData.transform = transform;
+        return lData;
+    }
+} // namespace
+
+void sgraph::Node::setVisible(bool visible)
+{
+    if (this->visible == visible)
+        return;
+    this->visible = visible;
+    for (uint32_t proxy : proxies)
+        registry->set_visible(proxy, visible);
+}
+
+void sgraph::Node::removeProxies()
+{
+    for (uint32_t proxy : proxies)
+        registry->remove(proxy);
+    proxies.clear();
+    registry = nullptr;
+}
+
+void sgraph::Node::addProxy(uint32_t proxy)
+{
+    if (!visible)
+        registry->set_visible(proxy, false);
+    proxies.push_back(proxy);
+}
+
+bool sgraph::GLTFMeshNode::registerProxies(RenderProxyRegistry &registry)
+{
+    // still being uploaded, the scene tries again next frame
+    if (!mesh->resident)
+        return false;
 
-    for (auto &s : mesh->surfaces)
+    this->registry = &registry;
+    const glm::mat4 &nodeMatrix = worldTransform();
+    for (const GeoSurface &s : mesh->surfaces)
     {
         RenderObject def;
         def.indexCount = s.count;
-        def.firstIndex = s.startIndex;
-        def.indexBuffer = mesh->meshBuffers.indexBuffer.buffer;
+        def.firstIndex = mesh->meshBuffers.firstIndex + s.startIndex;
+        def.vertexOffset = mesh->meshBuffers.vertexOffset;
+        def.indexBuffer = mesh->meshBuffers.indexBuffer;
         def.material = &s.material->data;
         def.bounds = s.bounds;
+        def.worldBounds = WorldBounds::from(s.bounds, nodeMatrix);
         def.transform = nodeMatrix;
         def.vertexBufferAddress = mesh->meshBuffers.vertexBufferAddress;
+        def.vertexFormat = mesh->meshBuffers.vertexFormat;
+        def.quantization = mesh->meshBuffers.quantization;
+        def.meshFirstIndex = mesh->meshBuffers.firstIndex;
+        if (s.meshletCount > 0)
+        {
+            def.meshlets = mesh->meshlets.data() + s.firstMeshlet;
+            def.meshletCount = s.meshletCount;
+        }
+        if (s.lodCount > 0)
+        {
+            def.lods = mesh->lods.data() + s.firstLod;
+            def.lodCount = s.lodCount;
+        }
 
-        if (s.material->data.passType == MaterialPass::Transparent)
-            ctx.TransparentSurfaces.push_back(def);
-        else
-            ctx.OpaqueSurfaces.push_back(def);
+        addProxy(registry.add_surface(def));
     }
-
-    // recurse down
-    Node::Draw(topMatrix, ctx);
+    return true;
 }
 
-bool is_visible(const RenderObject &obj, const glm::mat4 &viewproj)
+void sgraph::GLTFMeshNode::transformChanged()
 {
-    std::array<glm::vec3, 8> corners{
-        glm::vec3{1, 1, 1},  glm::vec3{1, 1, -1},  glm::vec3{1, -1, 1},  glm::vec3{1, -1, -1},
-        glm::vec3{-1, 1, 1}, glm::vec3{-1, 1, -1}, glm::vec3{-1, -1, 1}, glm::vec3{-1, -1, -1},
-    };
-
-    glm::mat4 matrix = viewproj * obj.transform;
+    if (!registry)
+        return;
 
-    glm::vec3 min = {1.5, 1.5, 1.5};
-    glm::vec3 max = {-1.5, -1.5, -1.5};
-
-    for (int c = 0; c < 8; c++)
-    {
-        // project each corner into clip space
-        glm::vec4 v = matrix * glm::vec4(obj.bounds.origin + (corners[c] * obj.bounds.extents), 1.f);
-
-        // perspective correction
-        v.x = v.x / v.w;
-        v.y = v.y / v.w;
-        v.z = v.z / v.w;
+    const glm::mat4 &nodeMatrix = worldTransform();
+    for (size_t i = 0; i < proxies.size(); i++)
+        registry->update_transform(proxies[i], nodeMatrix, WorldBounds::from(mesh->surfaces[i].bounds, nodeMatrix));
+}
 
-        min = glm::min(glm::vec3{v.x, v.y, v.z}, min);
-        max = glm::max(glm::vec3{v.x, v.y, v.z}, max);
-    }
+void sgraph::GLTFMeshNode::materialsChanged()
+{
+    if (!registry)
+        return;
 
-    // check the clip space box is within the view
-    if (min.z > 1.f || max.z < 0.f || min.x > 1.f || max.x < -1.f || min.y > 1.f || max.y < -1.f)
-        return false;
-    else
-        return true;
+    for (size_t i = 0; i < proxies.size(); i++)
+        registry->update_material(proxies[i], &mesh->surfaces[i].material->data);
 }
 
-void sgraph::GLTFLightNode::Draw(const glm::mat4 &topMatrix, DrawContext &ctx)
+bool sgraph::GLTFLightNode::registerProxies(RenderProxyRegistry &registry)
 {
     // each light node has 1 light.
-    GPULightingData lData;
-    lData.color = lightingData->color;
-    lData.intensity = lightingData->intensity;
-    lData.transform = topMatrix * this->worldTransform;
-    ctx.lights.push_back(lData);
-    Node::Draw(topMatrix, ctx);
-}
\ No newline at end of file
+    this->registry = &registry;
+    addProxy(registry.add_light(light_data(*lightingData, worldTransform())));
+    return true;
+}
+
+void sgraph::GLTFLightNode::transformChanged()
+{
+    if (registry)
+        registry->update_light(proxies[0], light_data(*lightingData, worldTransform()));
+}
@@ -1,7 +1,8 @@
 #pragma once
 
+#include "TransformStore.h"
 #include <memory>
-struct DrawContext;
+class RenderProxyRegistry;
 struct MeshAsset;
 struct LightingData;
 
@@ -11,12 +12,13 @@ namespace sgraph
     class INode
     {
       public:
-        virtual void Draw(const glm::mat4 &topMatrix, DrawContext &ctx) = 0;
+        // called every frame, registers what is new with the registry and pushes what changed to it
+        virtual void Sync(const glm::mat4 &topMatrix, RenderProxyRegistry &registry) = 0;
     };
 
     // implementation of a drawable scene node.
     // the scene node can hold children and will also keep a transform to propagate
-    // to them
+    // to them. the world transform already includes the topMatrix of the scene, see GLTFScene::Sync
     struct Node : public INode
     {
 
@@ -24,22 +26,60 @@ namespace sgraph
         std::weak_ptr<Node> parent;
         std::vector<std::shared_ptr<Node>> children;
 
-        glm::mat4 localTransform;
-        glm::mat4 worldTransform;
+        // the matrices live in the TransformStore of the scene, the node keeps its handle into it
+        std::shared_ptr<TransformStore> transforms;
+        uint32_t transformHandle = TransformStore::NO_PARENT;
 
-        void refreshTransform(const glm::mat4 &parentMatrix)
+        const glm::mat4 &localTransform() const
         {
-            worldTransform = parentMatrix * localTransform;
-            for (auto c : children)
-                c->refreshTransform(worldTransform);
+            return transforms->local(transformHandle);
         }
+        const glm::mat4 &worldTransform() const
+        {
+            return transforms->world(transformHandle);
+        }
+        // the world matrices of the node and its children follow on the next update of the store
+        void setLocalTransform(const glm::mat4 &local)
+        {
+            transforms->set_local(transformHandle, local);
+        }
+
+        // hidden nodes keep their proxies, they are only left out of the draw context. does not affect the children
+        void setVisible(bool visible);
+        bool isVisible() const
+        {
+            return visible;
+        }
+
+        /**
+         * @brief Create the render proxies of the node from its current world transform.
+         *
+         * @return false while the node has nothing to register yet, the scene tries again next frame
+         */
+        virtual bool registerProxies(RenderProxyRegistry & /*registry*/)
+        {
+            return true;
+        }
+        // push the new world transform to the proxies, called by the scene after the transform store swept the node
+        virtual void transformChanged()
+        {
+        }
+        void removeProxies();
 
-        virtual void Draw(const glm::mat4 &topMatrix, DrawContext &ctx)
+        virtual void Sync(const glm::mat4 &topMatrix, RenderProxyRegistry &registry)
         {
-            // draw children
+            // sync children
             for (auto &c : children)
-                c->Draw(topMatrix, ctx);
+                c->Sync(topMatrix, registry);
         }
+
+      protected:
+        void addProxy(uint32_t proxy);
+
+        // the registry the proxies were added to, null until the node is registered
+        RenderProxyRegistry *registry = nullptr;
+        std::vector<uint32_t> proxies;
+        bool visible = true;
     };
 
     struct GLTFMeshNode : public Node
@@ -47,14 +87,31 @@ namespace sgraph
 
         std::shared_ptr<MeshAsset> mesh;
 
-        virtual void Draw(const glm::mat4 &topMatrix, DrawContext &ctx) override;
+        // one proxy per surface of the mesh, registered once the mesh is uploaded
+        virtual bool registerProxies(RenderProxyRegistry &registry) override;
+        virtual void transformChanged() override;
+        // push the materials of the surfaces again, after they were swapped on the mesh
+        void materialsChanged();
     };
 
     struct GLTFLightNode : public Node
     {
         std::shared_ptr<LightingData> lightingData;
 
-        virtual void Draw(const glm::mat4 &topMatrix, DrawContext &ctx) override;
+        virtual bool registerProxies(RenderProxyRegistry &registry) override;
+        virtual void transformChanged() override;
+    };
+
+    // stands in for a node that is still loading in the background, draws nothing until target is set
+    struct DeferredNode : public INode
+    {
+        std::shared_ptr<INode> target;
+
+        virtual void Sync(const glm::mat4 &topMatrix, RenderProxyRegistry &registry) override
+        {
+            if (target)
+                target->Sync(topMatrix, registry);
+        }
     };
 
 } // namespace sgraph
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "TransformStore.h"
+#include <algorithm>
+#include <cassert>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORMSTORE_SSE 1
+#endif
+
+namespace
+{
+    // out = a * b, column major. out may not alias a or b
+    void multiply(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out)
+    {
+#ifdef TRANSFORMSTORE_SSE
+        const float *pa = &a[0][0];
+        const float *pb = &b[0][0];
+        float *po = &out[0][0];
+        __m128 a0 = _mm_loadu_ps(pa);
+        __m128 a1 = _mm_loadu_ps(pa + 4);
+        __m128 a2 = _mm_loadu_ps(pa + 8);
+        __m128 a3 = _mm_loadu_ps(pa + 12);
+
+        // every column of the result is the columns of a weighted by a column of b
+        for (int column = 0; column < 4; column++)
+        {
+            const float *bc = pb + column * 4;
+            __m128 result = _mm_mul_ps(a0, _mm_set1_ps(bc[0]));
+            result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(bc[1])));
+            result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+            result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(bc[3])));
+            _mm_storeu_ps(po + column * 4, result);
+        }
+#else
+        out = a * b;
+#endif
+    }
+} // namespace
+
+void sgraph::TransformStore::reserve(size_t count)
+{
+    parents.reserve(count);
+    subtreeEnds.reserve(count);
+    locals.reserve(count);
+    worlds.reserve(count);
+}
+
+void sgraph::TransformStore::clear()
+{
+    parents.clear();
+    subtreeEnds.clear();
+    locals.clear();
+    worlds.clear();
+    dirty.clear();
+    allDirty = false;
+    sweptRanges.clear();
+}
+
+uint32_t sgraph::TransformStore::add(uint32_t parent, const glm::mat4 &local)
+{
+    uint32_t handle = static_cast<uint32_t>(parents.size());
+    // depth first: the subtree of the parent has to still be open, so it stays a contiguous range
+    assert(parent == NO_PARENT || subtreeEnds[parent] == handle);
+
+    parents.push_back(parent);
+    subtreeEnds.push_back(handle + 1);
+    locals.push_back(local);
+    worlds.push_back(local);
+
+    // the new entry extends the subtree of every ancestor
+    for (uint32_t ancestor = parent; ancestor != NO_PARENT; ancestor = parents[ancestor])
+        subtreeEnds[ancestor] = handle + 1;
+
+    dirty.push_back(handle);
+    return handle;
+}
+
+void sgraph::TransformStore::set_local(uint32_t handle, const glm::mat4 &local)
+{
+    locals[handle] = local;
+    dirty.push_back(handle);
+}
+
+void sgraph::TransformStore::set_root(const glm::mat4 &root)
+{
+    if (root == this->root)
+        return;
+    this->root = root;
+    allDirty = true;
+}
+
+size_t sgraph::TransformStore::update()
+{
+    size_t updated = 0;
+    sweptRanges.clear();
+    if (allDirty)
+    {
+        sweep(0, static_cast<uint32_t>(parents.size()));
+        updated = parents.size();
+    }
+    else if (!dirty.empty())
+    {
+        // subtrees of dirty entries inside an earlier dirty subtree are covered by its sweep
+        std::sort(dirty.begin(), dirty.end());
+        uint32_t sweptEnd = 0;
+        for (uint32_t handle : dirty)
+        {
+            if (handle < sweptEnd)
+                continue;
+            sweptEnd = subtreeEnds[handle];
+            sweep(handle, sweptEnd);
+            updated += sweptEnd - handle;
+        }
+    }
+
+    dirty.clear();
+    allDirty = false;
+    return updated;
+}
+
+void sgraph::TransformStore::sweep(uint32_t first, uint32_t end)
+{
+    const uint32_t *parent = parents.data();
+    const glm::mat4 *local = locals.data();
+    glm::mat4 *world = worlds.data();
+    sweptRanges.push_back({first, end});
+
+    // parents come first, so their world matrix is final by the time a child reads it
+    for (uint32_t i = first; i < end; i++)
+        multiply(parent[i] == NO_PARENT ? root : world[parent[i]], local[i], world[i]);
+}
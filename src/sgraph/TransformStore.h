@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <vk_types.h>
+
+namespace sgraph
+{
+    /**
+     * @brief Flattened transform hierarchy of a scene. Local and world matrices live in contiguous arrays indexed by
+     * a handle, with the parent handle of every entry next to them. Entries are in depth first order, so the subtree
+     * of an entry is the range of handles right after it, and parents are always updated before their children.
+     *
+     * Changing a local matrix marks its entry dirty. update() then recomputes the world matrices of the dirty
+     * subtrees only, in linear sweeps over their ranges. Caches derived from a world matrix (like the world bounds of
+     * a mesh node) refresh the entries of the swept ranges.
+     *
+     */
+    class TransformStore
+    {
+      public:
+        static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+        void reserve(size_t count);
+        void clear();
+
+        /**
+         * @brief Add a transform, in depth first order: the parent has to be the last entry added or one of its
+         * ancestors. Its world matrix is valid after the next update.
+         *
+         * @param parent handle of the parent, or NO_PARENT for a root
+         * @return uint32_t handle of the new transform
+         */
+        uint32_t add(uint32_t parent, const glm::mat4 &local);
+
+        // the world matrices of the entry and its subtree follow on the next update
+        void set_local(uint32_t handle, const glm::mat4 &local);
+
+        // matrix applied on top of the roots, changing it dirties everything
+        void set_root(const glm::mat4 &root);
+
+        const glm::mat4 &local(uint32_t handle) const
+        {
+            return locals[handle];
+        }
+        const glm::mat4 &world(uint32_t handle) const
+        {
+            return worlds[handle];
+        }
+        uint32_t parent(uint32_t handle) const
+        {
+            return parents[handle];
+        }
+        size_t size() const
+        {
+            return parents.size();
+        }
+
+        /**
+         * @brief Recompute the world matrices of the dirty subtrees.
+         *
+         * @return size_t number of world matrices recomputed
+         */
+        size_t update();
+
+        // handle ranges [first, end) the last update recomputed, for callers that push the new matrices on
+        const std::vector<std::pair<uint32_t, uint32_t>> &swept() const
+        {
+            return sweptRanges;
+        }
+
+      private:
+        // recompute the world matrices of the handles in [first, end)
+        void sweep(uint32_t first, uint32_t end);
+
+        std::vector<uint32_t> parents;
+        // one past the last handle of the subtree of every entry
+        std::vector<uint32_t> subtreeEnds;
+        std::vector<glm::mat4> locals;
+        std::vector<glm::mat4> worlds;
+
+        glm::mat4 root{1.f};
+        std::vector<uint32_t> dirty;
+        bool allDirty = false;
+        std::vector<std::pair<uint32_t, uint32_t>> sweptRanges;
+    };
+} // namespace sgraph
@@ -1,10 +1,10 @@
 ﻿#include <vk_descriptors.h>
 
-void DescriptorLayoutBuilder::add_binding(uint32_t binding, VkDescriptorType type)
+void DescriptorLayoutBuilder::add_binding(uint32_t binding, VkDescriptorType type, uint32_t count)
 {
     VkDescriptorSetLayoutBinding newbind{};
     newbind.binding = binding;
-    newbind.descriptorCount = 1;
+    newbind.descriptorCount = count;
     newbind.descriptorType = type;
 
     bindings.push_back(newbind);
@@ -203,7 +203,7 @@ void DescriptorWriter::write_buffer(int binding, VkBuffer buffer, size_t size, s
 }
 
 void DescriptorWriter::write_image(int binding, VkImageView image, VkSampler sampler, VkImageLayout layout,
-                                   VkDescriptorType type)
+                                   VkDescriptorType type, uint32_t arrayElement)
 {
     VkDescriptorImageInfo &info =
         imageInfos.emplace_back(VkDescriptorImageInfo{.sampler = sampler, .imageView = image, .imageLayout = layout});
@@ -211,6 +211,7 @@ void DescriptorWriter::write_image(int binding, VkImageView image, VkSampler sam
     VkWriteDescriptorSet write = {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
 
     write.dstBinding = binding;
+    write.dstArrayElement = arrayElement;
     write.dstSet = VK_NULL_HANDLE; // left empty for now until we need to write it
     write.descriptorCount = 1;
     write.descriptorType = type;
@@ -31,9 +31,6 @@
 
 VulkanEngine *loadedEngine = nullptr;
 
-// forward declaration - this is present in Scenegraphs.cpp
-bool is_visible(const RenderObject &obj, const glm::mat4 &viewproj);
-
 VulkanEngine &VulkanEngine::Get()
 {
     return *loadedEngine;
@@ -82,19 +79,26 @@ void VulkanEngine::init()
 
 void VulkanEngine::init_vulkan()
 {
+    // without a window there is nothing to present to, no surface or swapchain is needed
+    bool headless = _window == nullptr;
+
     vkb::InstanceBuilder builder;
 
     auto instRet = builder.set_app_name("Vulkan Engine")
                        .request_validation_layers(true)
                        .use_default_debug_messenger()
                        .require_api_version(1, 3, 0)
+                       .set_headless(headless)
                        .build();
 
     vkb::Instance vkbInst = instRet.value();
     _instance = vkbInst.instance;
     _debugMessenger = vkbInst.debug_messenger;
 
-    SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
+    if (headless)
+        _surface = VK_NULL_HANDLE;
+    else
+        SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
 
     // vulkan 1.3 features
     VkPhysicalDeviceVulkan13Features features{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
@@ -103,19 +107,31 @@ void VulkanEngine::init_vulkan()
 
     VkPhysicalDeviceVulkan12Features features12{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
                                                 .descriptorIndexing = true,
+                                                // bindless material textures
+                                                .descriptorBindingSampledImageUpdateAfterBind = true,
+                                                .descriptorBindingUpdateUnusedWhilePending = true,
+                                                .descriptorBindingPartiallyBound = true,
+                                                .runtimeDescriptorArray = true,
                                                 .bufferDeviceAddress = true};
 
     vkb::PhysicalDeviceSelector selector{vkbInst};
 
     vkb::PhysicalDevice PhysicalDevice = selector.set_minimum_version(1, 3)
                                              .prefer_gpu_device_type(vkb::PreferredDeviceType::discrete)
-                                             .allow_any_gpu_device_type(false)
+                                             .allow_any_gpu_device_type(headless) // software drivers for tools
                                              .set_required_features_13(features)
                                              .set_required_features_12(features12)
                                              .set_surface(_surface)
                                              .select()
                                              .value();
 
+    // block compressed textures, when the device has them
+    VkPhysicalDeviceFeatures optionalFeatures{.textureCompressionBC = true};
+    _textureCompressionBC = PhysicalDevice.enable_features_if_present(optionalFeatures);
+
+    // real heap budgets for the texture streamer, VMA estimates them otherwise
+    bool memoryBudget = PhysicalDevice.enable_extension_if_present(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
     vkb::DeviceBuilder DeviceBuilder{PhysicalDevice};
 
     vkb::Device vkbDevice = DeviceBuilder.build().value();
@@ -129,12 +145,18 @@ void VulkanEngine::init_vulkan()
     allocatorInfo.physicalDevice = _chosenGPU;
     allocatorInfo.device = _device;
     allocatorInfo.instance = _instance;
+    // the memory budget extension needs the 1.1 entry points
+    allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
     allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    if (memoryBudget)
+        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
     vmaCreateAllocator(&allocatorInfo, &_allocator);
 
     _gpuResourceAllocator.init(_allocator, _device, this);
 
     _mainDeletionQueue.push_function([&]() { vmaDestroyAllocator(_allocator); });
+    // the geometry pool has to go before the allocator
+    _mainDeletionQueue.push_function([&]() { _gpuResourceAllocator.cleanup(); });
 }
 
 void VulkanEngine::init_swapchain()
@@ -433,6 +455,9 @@ void VulkanEngine::init_background_pipelines()
 
 void VulkanEngine::init_default_data()
 {
+    // all default textures go up in a single submit
+    _gpuResourceAllocator.begin_upload_batch();
+
     // 3 default textures, white, grey, black. 1 pixel each
     uint32_t white = glm::packUnorm4x8(glm::vec4(1, 1, 1, 1));
     _whiteImage = _gpuResourceAllocator.create_image((void *)&white, VkExtent3D{1, 1, 1}, VK_FORMAT_R8G8B8A8_UNORM,
@@ -455,23 +480,23 @@ void VulkanEngine::init_default_data()
     _errorCheckerboardImage = _gpuResourceAllocator.create_image(pixels.data(), VkExtent3D{16, 16, 1},
                                                                  VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
 
+    _gpuResourceAllocator.submit_upload_batch();
+
     VkSamplerCreateInfo sampl = {.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
 
     sampl.magFilter = VK_FILTER_NEAREST;
     sampl.minFilter = VK_FILTER_NEAREST;
 
-    vkCreateSampler(_device, &sampl, nullptr, &_defaultSamplerNearest);
+    // samplers are owned by the allocator, scenes asking for the same state get these same handles
+    _defaultSamplerNearest = _gpuResourceAllocator.get_sampler(sampl);
 
     sampl.magFilter = VK_FILTER_LINEAR;
     sampl.minFilter = VK_FILTER_LINEAR;
-    vkCreateSampler(_device, &sampl, nullptr, &_defaultSamplerLinear);
+    _defaultSamplerLinear = _gpuResourceAllocator.get_sampler(sampl);
 
     _mainDeletionQueue.push_function(
         [&]()
         {
-            vkDestroySampler(_device, _defaultSamplerNearest, nullptr);
-            vkDestroySampler(_device, _defaultSamplerLinear, nullptr);
-
             _gpuResourceAllocator.destroy_image(_whiteImage);
             _gpuResourceAllocator.destroy_image(_greyImage);
             _gpuResourceAllocator.destroy_image(_blackImage);
@@ -551,6 +576,23 @@ void VulkanEngine::init_imgui()
 
 // {{{ DESTRUCTION AND CLEANUP
 
+void VulkanEngine::init_headless()
+{
+    assert(loadedEngine == nullptr);
+    loadedEngine = this;
+
+    // no window, swapchain, draw images or pipelines: only what uploads and material writes need
+    init_vulkan();
+
+    init_commands();
+
+    init_sync_structures();
+
+    init_default_data();
+
+    _isInitialized = true;
+}
+
 void VulkanEngine::cleanup()
 {
     if (_isInitialized)
@@ -581,13 +623,17 @@ void VulkanEngine::cleanup()
 
         _mainDeletionQueue.flush();
 
-        destroy_swapchain();
+        if (_window != nullptr)
+        {
+            destroy_swapchain();
+            vkDestroySurfaceKHR(_instance, _surface, nullptr);
+        }
 
-        vkDestroySurfaceKHR(_instance, _surface, nullptr);
         vkDestroyDevice(_device, nullptr);
         vkb::destroy_debug_utils_messenger(_instance, _debugMessenger);
         vkDestroyInstance(_instance, nullptr);
-        SDL_DestroyWindow(_window);
+        if (_window != nullptr)
+            SDL_DestroyWindow(_window);
     }
 
     // clear engine pointer
@@ -858,10 +904,7 @@ void VulkanEngine::draw()
 
 void VulkanEngine::update_scene()
 {
-    mainDrawContext.OpaqueSurfaces.clear();
-    mainDrawContext.TransparentSurfaces.clear();
-    mainDrawContext.lights.clear();
-
+    // the draw context is retained, the scenes push their changes to it through a RenderProxyRegistry
     mainCamera.update();
 
     glm::mat4 view = mainCamera.getViewMatrix();
@@ -118,20 +118,48 @@ struct GPULightingData
 struct RenderObject
 {
     uint32_t indexCount;
-    uint32_t firstIndex;
+    uint32_t firstIndex;  // into the shared index buffer, already includes the mesh offset
+    int32_t vertexOffset; // added to every index, selects the mesh inside the shared vertex buffer
     VkBuffer indexBuffer;
 
     MaterialInstance *material;
     Bounds bounds;
+    WorldBounds worldBounds; // bounds transformed by transform
     glm::mat4 transform;
     VkDeviceAddress vertexBufferAddress;
+    VertexFormat vertexFormat;
+    VertexQuantization quantization;
+
+    // meshlets and lods of the surface, their index ranges are relative to the mesh and not yet offset by
+    // meshFirstIndex
+    uint32_t meshFirstIndex = 0;
+    const Meshlet *meshlets = nullptr;
+    uint32_t meshletCount = 0;
+    const SurfaceLod *lods = nullptr;
+    uint32_t lodCount = 0;
 };
 
+// a material the renderer drew, with the size on screen in pixels of the largest surface using it
+struct VisibleMaterial
+{
+    const MaterialInstance *material;
+    float screenSize;
+};
+
+class RenderProxyRegistry;
+
+// the surface and light arrays persist across frames, they are maintained by a RenderProxyRegistry
 struct DrawContext
 {
     std::vector<RenderObject> OpaqueSurfaces;
     std::vector<RenderObject> TransparentSurfaces;
     std::vector<GPULightingData> lights;
+
+    // filled by the renderer with every material it drew, read back at the start of the next frame
+    std::vector<VisibleMaterial> visibleMaterials;
+
+    // the registry maintaining the arrays, its bvh culls them. null when nothing does
+    const RenderProxyRegistry *proxies = nullptr;
 };
 
 // }}} SCENEGRAPHS end -----------------------
@@ -148,6 +176,7 @@ class VulkanEngine
     VkInstance _instance;
     VkDebugUtilsMessengerEXT _debugMessenger;
     VkPhysicalDevice _chosenGPU;
+    bool _textureCompressionBC = false; // BCn texture formats can be sampled
     VkDevice _device;
     VkSurfaceKHR _surface;
     VkSwapchainKHR _swapchain;
@@ -225,6 +254,10 @@ class VulkanEngine
     // initializes everything in the engine
     virtual void init();
 
+    // initializes a device without a window, enough to load and upload scenes but not to draw. tools use it to run
+    // without a display, a software driver is accepted
+    void init_headless();
+
     // shuts down the engine
     void cleanup();
 
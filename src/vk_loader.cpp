@@ -1,9 +1,23 @@
 ﻿
 #include "GPUResourceAllocator.h"
+#include "Hash.h"
+#include "Ktx2Reader.h"
+#include "MappedFile.h"
+#include "MeshProcessing.h"
+#include "SceneCache.h"
+#include "ThreadPool.h"
+#include "TextureCache.h"
+#include "TextureProcessing.h"
+#include "TextureStreamer.h"
+#include "VertexAssembly.h"
 #include "fastgltf/types.hpp"
 #include "fmt/base.h"
 #include "sgraph/ScenegraphStructs.h"
 #include "stb_image.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <vk_loader.h>
@@ -11,6 +25,7 @@
 #include "PBREngine.h"
 #include "vk_engine.h"
 #include "vk_types.h"
+#include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/quaternion.hpp>
 
 #include <fastgltf/core.hpp>
@@ -20,37 +35,213 @@
 // forward declaration of global functions
 VkFilter extract_filter(fastgltf::Filter filter);
 VkSamplerMipmapMode extract_mipmap_mode(fastgltf::Filter filter);
-std::optional<AllocatedImage> load_image(GPUResourceAllocator *gpuResourceAllocator, fastgltf::Asset &asset,
-                                         fastgltf::Image &image);
+bool load_external_buffers(fastgltf::Asset &asset, const std::filesystem::path &directory,
+                           std::vector<std::filesystem::path> &sourceFiles,
+                           std::vector<std::shared_ptr<MappedFile>> &mappings);
+
+// gltf/glb input read straight from a mapped file. the json is copied out (simdjson wants padding behind it), the
+// binary chunk of a glb is not: the parser asks for memory to copy it into through the buffer map callback, gets a
+// pointer to where the chunk already is in the mapping, and the copy onto itself is skipped.
+class MappedGltfSource : public fastgltf::GltfDataGetter
+{
+  public:
+    // custom buffer id the binary chunk is parsed as, replaced by a ByteView once parsing is done
+    static constexpr fastgltf::CustomBufferId BINARY_CHUNK_ID = 1;
+
+    explicit MappedGltfSource(std::shared_ptr<MappedFile> file) : file(std::move(file))
+    {
+    }
+
+    void read(void *ptr, std::size_t count) override
+    {
+        const std::byte *source = cursor();
+        if (ptr != source)
+            memcpy(ptr, source, count);
+        offset += count;
+    }
+
+    fastgltf::span<std::byte> read(std::size_t count, std::size_t padding) override
+    {
+        scratch.resize(count + padding);
+        memcpy(scratch.data(), cursor(), count);
+        offset += count;
+        return fastgltf::span<std::byte>(scratch.data(), scratch.size());
+    }
+
+    void reset() override
+    {
+        offset = 0;
+    }
+
+    std::size_t bytesRead() override
+    {
+        return offset;
+    }
+
+    std::size_t totalSize() override
+    {
+        return file->bytes().size();
+    }
+
+    // buffer map callback. only the glb binary chunk is handed the mapping, data uris are decoded (written) into the
+    // buffer they get, so for those the parser falls back to its own allocation
+    static fastgltf::BufferInfo map_buffer(std::uint64_t bufferSize, void *userPointer)
+    {
+        MappedGltfSource *self = static_cast<MappedGltfSource *>(userPointer);
+
+        // the chunk header right before the cursor: length, then the BIN magic
+        uint32_t header[2] = {0, 0};
+        if (self->offset >= sizeof(header) && self->offset + bufferSize <= self->totalSize())
+            memcpy(header, self->cursor() - sizeof(header), sizeof(header));
+        if (header[0] != bufferSize || header[1] != 0x004E4942)
+            return {nullptr, 0};
+
+        self->binaryChunk = std::span<const std::byte>(self->cursor(), bufferSize);
+        return {const_cast<std::byte *>(self->cursor()), BINARY_CHUNK_ID};
+    }
+
+    std::span<const std::byte> binary_chunk() const
+    {
+        return binaryChunk;
+    }
 
-std::optional<std::shared_ptr<sgraph::GLTFScene>> loadGltf(GLTFCreatorData creatorData, std::string_view filePath)
+  private:
+    const std::byte *cursor() const
+    {
+        return file->bytes().data() + offset;
+    }
+
+    std::shared_ptr<MappedFile> file;
+    std::size_t offset = 0;
+    std::vector<std::byte> scratch;
+    std::span<const std::byte> binaryChunk;
+};
+
+// what the materials use an image for, it decides how the image is compressed
+enum class TextureRole
+{
+    Unused,
+    Color,
+    MetalRough,
+    Mixed, // used for several things, kept uncompressed
+};
+
+ImportedImage decode_image(fastgltf::Asset &asset, fastgltf::Image &image, const std::filesystem::path &directory,
+                           const std::vector<std::shared_ptr<MappedFile>> &mappings, const ImportOptions &options,
+                           TextureRole role);
+VkFormat unorm_format(VkFormat format);
+std::optional<size_t> texture_image(const fastgltf::Texture &texture, const std::vector<ImportedImage> &images);
+uint64_t texture_cache_key(const ImportedImage &image);
+template <typename T>
+vertexasm::FloatStream attribute_stream(const fastgltf::Asset &asset, const fastgltf::Accessor &accessor,
+                                        size_t vertexCount, std::vector<T> &scratch);
+float elapsed_ms(std::chrono::steady_clock::time_point start);
+void count_imported_bytes(const ImportedScene &imported, LoadStats &stats);
+
+std::optional<ImportedScene> readOrImportGltf(const std::filesystem::path &path, const GLTFCreatorData &creatorData,
+                                              LoadStats *stats)
 {
-    fmt::print("Loading GLTF: {}", filePath);
+    std::filesystem::path cachePath = scenecache::cache_path(path);
+
+    std::optional<ImportedScene> imported;
+    LoadStats phases{};
+    if (creatorData.useSceneCache)
+    {
+        auto readStart = std::chrono::steady_clock::now();
+        imported = scenecache::read(cachePath);
+        phases.fileReadMs = elapsed_ms(readStart);
+
+        // baked with other options, treat it as out of date
+        if (imported.has_value() && !(imported->options == creatorData.importOptions))
+            imported.reset();
+    }
+
+    if (imported.has_value())
+    {
+        fmt::println("Using scene cache {}", cachePath.string());
+        if (stats)
+        {
+            std::error_code error;
+            phases.fromSceneCache = true;
+            phases.fileBytes = std::filesystem::file_size(cachePath, error);
+            count_imported_bytes(*imported, phases);
+            *stats = phases;
+        }
+        return imported;
+    }
+
+    imported = importGltf(path, creatorData.importOptions, stats);
+    if (!imported.has_value())
+        return {};
+
+    if (creatorData.useSceneCache && !scenecache::write(cachePath, *imported))
+        fmt::println("Failed to write scene cache {}", cachePath.string());
+
+    return imported;
+}
+
+std::optional<std::shared_ptr<sgraph::GLTFScene>> loadGltf(GLTFCreatorData creatorData, std::string_view filePath,
+                                                           LoadStats *stats)
+{
+    fmt::println("Loading GLTF: {}", filePath);
+
+    auto importStart = std::chrono::steady_clock::now();
+
+    std::optional<ImportedScene> imported = readOrImportGltf(filePath, creatorData, stats);
+    if (!imported.has_value())
+        return {};
+
+    auto importEnd = std::chrono::steady_clock::now();
 
-    std::shared_ptr<sgraph::GLTFScene> scene = std::make_shared<sgraph::GLTFScene>();
-    scene->creator = std::move(creatorData);
-    sgraph::GLTFScene &file = *scene.get();
+    std::shared_ptr<sgraph::GLTFScene> scene =
+        buildGltfScene(creatorData, std::make_shared<const ImportedScene>(std::move(*imported)), stats);
 
-    fastgltf::Parser parser(fastgltf::Extensions::KHR_lights_punctual);
+    auto buildEnd = std::chrono::steady_clock::now();
+    fmt::println("Import took {} ms, building the scene took {} ms",
+                 std::chrono::duration_cast<std::chrono::milliseconds>(importEnd - importStart).count(),
+                 std::chrono::duration_cast<std::chrono::milliseconds>(buildEnd - importEnd).count());
 
-    constexpr auto gltfOptions = fastgltf::Options::DontRequireValidAssetMember | fastgltf::Options::AllowDouble |
-                                 fastgltf::Options::LoadExternalBuffers;
+    return scene;
+}
 
-    auto dataResult = fastgltf::GltfDataBuffer::FromPath(filePath);
-    if (!dataResult)
+std::optional<ImportedScene> importGltf(const std::filesystem::path &path, const ImportOptions &options,
+                                        LoadStats *stats)
+{
+    ImportedScene imported;
+    imported.options = options;
+    imported.sourceFiles.push_back(path);
+    LoadStats phases{};
+
+    fastgltf::Parser parser(fastgltf::Extensions::KHR_lights_punctual | fastgltf::Extensions::KHR_texture_basisu);
+
+    // external buffers are loaded by hand so we know which files the scene came from
+    constexpr auto gltfOptions = fastgltf::Options::DontRequireValidAssetMember | fastgltf::Options::AllowDouble;
+
+    // the file and its external buffers are mapped, not read. accessors and images read straight from the mappings,
+    // which are dropped when the import returns since everything imported is copied out of them. only ktx2 textures
+    // keep the mapping they are stored in
+    std::vector<std::shared_ptr<MappedFile>> mappings;
+    auto mapStart = std::chrono::steady_clock::now();
+    std::shared_ptr<MappedFile> mappedFile = MappedFile::open(path);
+    if (!mappedFile)
     {
-        fmt::print("Failed to load file: {} \n", fastgltf::to_underlying(dataResult.error()));
+        fmt::println("Failed to load file: {}", path.string());
         return {};
     }
+    mappings.push_back(mappedFile);
+    phases.fileReadMs = elapsed_ms(mapStart);
 
-    fastgltf::Asset gltf;
+    MappedGltfSource source(mappedFile);
+    parser.setUserPointer(&source);
+    parser.setBufferAllocationCallback(MappedGltfSource::map_buffer);
 
-    std::filesystem::path path = filePath;
+    fastgltf::Asset gltf;
 
-    auto type = fastgltf::determineGltfFileType(dataResult.get());
+    auto parseStart = std::chrono::steady_clock::now();
+    auto type = fastgltf::determineGltfFileType(source);
     if (type == fastgltf::GltfType::glTF)
     {
-        auto load = parser.loadGltf(dataResult.get(), path.parent_path(), gltfOptions);
+        auto load = parser.loadGltf(source, path.parent_path(), gltfOptions);
         if (load)
         {
             gltf = std::move(load.get());
@@ -63,7 +254,7 @@ std::optional<std::shared_ptr<sgraph::GLTFScene>> loadGltf(GLTFCreatorData creat
     }
     else if (type == fastgltf::GltfType::GLB)
     {
-        auto load = parser.loadGltfBinary(dataResult.get(), path.parent_path(), gltfOptions);
+        auto load = parser.loadGltfBinary(source, path.parent_path(), gltfOptions);
         if (load)
         {
             gltf = std::move(load.get());
@@ -80,158 +271,170 @@ std::optional<std::shared_ptr<sgraph::GLTFScene>> loadGltf(GLTFCreatorData creat
         return {};
     }
 
-    // we can stimate the descriptors we will need accurately
-    std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3},
-                                                                     {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3},
-                                                                     {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1}};
+    // the glb binary chunk was parsed as a custom buffer pointing into the mapping
+    for (fastgltf::Buffer &buffer : gltf.buffers)
+    {
+        auto custom = std::get_if<fastgltf::sources::CustomBuffer>(&buffer.data);
+        if (custom != nullptr && custom->id == MappedGltfSource::BINARY_CHUNK_ID)
+        {
+            std::span<const std::byte> chunk = source.binary_chunk();
+            buffer.data = fastgltf::sources::ByteView{fastgltf::span<const std::byte>(chunk.data(), chunk.size()),
+                                                      fastgltf::MimeType::GltfBuffer};
+        }
+    }
+
+    phases.parseMs = elapsed_ms(parseStart);
 
-    file.descriptorPool.init(creatorData._device, gltf.materials.size(), sizes);
+    mapStart = std::chrono::steady_clock::now();
+    if (!load_external_buffers(gltf, path.parent_path(), imported.sourceFiles, mappings))
+        return {};
+    phases.fileReadMs += elapsed_ms(mapStart);
 
     // load samplers
     for (fastgltf::Sampler &sampler : gltf.samplers)
     {
-
-        VkSamplerCreateInfo sampl = {.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO, .pNext = nullptr};
-        sampl.maxLod = VK_LOD_CLAMP_NONE;
-        sampl.minLod = 0;
-
+        ImportedSampler sampl;
         sampl.magFilter = extract_filter(sampler.magFilter.value_or(fastgltf::Filter::Nearest));
         sampl.minFilter = extract_filter(sampler.minFilter.value_or(fastgltf::Filter::Nearest));
 
         sampl.mipmapMode = extract_mipmap_mode(sampler.minFilter.value_or(fastgltf::Filter::Nearest));
 
-        VkSampler newSampler;
-        vkCreateSampler(creatorData._device, &sampl, nullptr, &newSampler);
-
-        file.samplers.push_back(newSampler);
+        imported.samplers.push_back(sampl);
     }
 
-    // temporal arrays for all the objects to use while creating the GLTF data
-    std::vector<std::shared_ptr<MeshAsset>> meshes;
-    std::vector<std::shared_ptr<sgraph::Node>> nodes;
-    std::vector<AllocatedImage> images;
-    std::vector<std::shared_ptr<GLTFMaterial>> materials;
-    std::vector<std::shared_ptr<LightingData>> lights;
-
-    // load all lights first
+    // load all lights
     for (fastgltf::Light &light : gltf.lights)
     {
-        std::shared_ptr<LightingData> ldata = std::make_shared<LightingData>();
-
-        ldata->color = glm::vec3(light.color[0], light.color[1], light.color[2]);
-        ldata->intensity = light.intensity;
-        ldata->range = light.range.value_or(0);
-        ldata->innerConeAngle = light.innerConeAngle.value_or(0);
-        ldata->outerConeAngle = light.outerConeAngle.value_or(0);
-        ldata->type = (light.type == fastgltf::LightType::Directional) ? LightingData::LightType::Directional
-                      : (light.type == fastgltf::LightType::Point)     ? LightingData::LightType::Point
-                                                                       : LightingData::LightType::Spot;
-        ldata->name = light.name;
-        file.lightingData[ldata->name] = ldata;
-        lights.push_back(ldata);
+        LightingData ldata;
+
+        ldata.color = glm::vec3(light.color[0], light.color[1], light.color[2]);
+        ldata.intensity = light.intensity;
+        ldata.range = light.range.value_or(0);
+        ldata.innerConeAngle = light.innerConeAngle.value_or(0);
+        ldata.outerConeAngle = light.outerConeAngle.value_or(0);
+        ldata.type = (light.type == fastgltf::LightType::Directional) ? LightingData::LightType::Directional
+                     : (light.type == fastgltf::LightType::Point)     ? LightingData::LightType::Point
+                                                                      : LightingData::LightType::Spot;
+        ldata.name = light.name;
+        imported.lights.push_back(ldata);
     }
 
-    // load all textures
-    for (fastgltf::Image &image : gltf.images)
+    // decode all textures, spread across the worker pool. the results are collected in image order, so the images
+    // vector still lines up with the gltf image indices.
+    auto decodeStart = std::chrono::steady_clock::now();
+
+    std::vector<TextureRole> roles(gltf.images.size(), TextureRole::Unused);
+    auto addRole = [&](const fastgltf::Optional<fastgltf::TextureInfo> &info, TextureRole role)
     {
-        std::optional<AllocatedImage> img = load_image(creatorData.gpuResourceAllocator, gltf, image);
+        if (!info.has_value())
+            return;
 
-        if (img.has_value())
-        {
-            images.push_back(*img);
-            file.images[image.name.c_str()] = *img;
-        }
-        else
+        // both the ktx2 image and its fallback get the role
+        const fastgltf::Texture &texture = gltf.textures[info->textureIndex];
+        for (const fastgltf::Optional<size_t> &index : {texture.imageIndex, texture.basisuImageIndex})
         {
-            // we failed to load, so lets give the slot a default white texture to not
-            // completely break loading
-            images.push_back(creatorData.loadErrorImage);
-            std::cout << "gltf failed to load texture " << image.name << std::endl;
+            if (!index.has_value())
+                continue;
+            TextureRole &current = roles[*index];
+            current = current == TextureRole::Unused || current == role ? role : TextureRole::Mixed;
         }
+    };
+    for (fastgltf::Material &mat : gltf.materials)
+    {
+        addRole(mat.pbrData.baseColorTexture, TextureRole::Color);
+        addRole(mat.pbrData.metallicRoughnessTexture, TextureRole::MetalRough);
     }
 
-    file.materialDataBuffer = creatorData.gpuResourceAllocator->create_buffer(
-        sizeof(GLTFMRMaterialSystem::MaterialConstants) * gltf.materials.size(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VMA_MEMORY_USAGE_CPU_TO_GPU);
-    int data_index = 0;
-    GLTFMRMaterialSystem::MaterialConstants *sceneMaterialConstants =
-        (GLTFMRMaterialSystem::MaterialConstants *)file.materialDataBuffer.info.pMappedData;
+    std::filesystem::path directory = path.parent_path();
+    std::vector<std::future<ImportedImage>> decodeJobs;
+    decodeJobs.reserve(gltf.images.size());
+    for (size_t i = 0; i < gltf.images.size(); i++)
+        decodeJobs.push_back(ThreadPool::Get().submit(
+            [&gltf, &image = gltf.images[i], &directory, &mappings, &options, role = roles[i]]()
+            { return decode_image(gltf, image, directory, mappings, options, role); }));
+
+    for (fastgltf::Image &image : gltf.images)
+    {
+        // images read from separate files are part of the scene sources too
+        if (auto uri = std::get_if<fastgltf::sources::URI>(&image.data); uri && uri->uri.isLocalPath())
+            imported.sourceFiles.push_back(directory / uri->uri.fspath());
+    }
+
+    size_t rgbaBytes = 0, texelBytes = 0;
+    for (size_t i = 0; i < gltf.images.size(); i++)
+    {
+        ImportedImage decoded = decodeJobs[i].get();
+        decoded.name = gltf.images[i].name;
+        if (decoded.texels.data.empty())
+            std::cout << "gltf failed to load texture " << decoded.name << std::endl;
+
+        rgbaBytes += texproc::mip_chain_size(VK_FORMAT_R8G8B8A8_UNORM, decoded.extent, decoded.mipLevels);
+        texelBytes += decoded.texels.data.size();
+        imported.images.push_back(std::move(decoded));
+    }
+
+    auto decodeEnd = std::chrono::steady_clock::now();
+    phases.imageDecodeMs = elapsed_ms(decodeStart);
+    fmt::println("Decoded {} textures on {} worker threads in {} ms, {:.1f} MB of RGBA8 stored in {:.1f} MB",
+                 gltf.images.size(), ThreadPool::Get().size(),
+                 std::chrono::duration_cast<std::chrono::milliseconds>(decodeEnd - decodeStart).count(),
+                 rgbaBytes / (1024.f * 1024.f), texelBytes / (1024.f * 1024.f));
 
     for (fastgltf::Material &mat : gltf.materials)
     {
-        std::shared_ptr<GLTFMaterial> newMat = std::make_shared<GLTFMaterial>();
-        materials.push_back(newMat);
-        file.materials[mat.name.c_str()] = newMat;
+        ImportedMaterial newMat;
+        newMat.name = mat.name;
 
-        GLTFMRMaterialSystem::MaterialConstants constants;
-        constants.colorFactors.x = mat.pbrData.baseColorFactor[0];
-        constants.colorFactors.y = mat.pbrData.baseColorFactor[1];
-        constants.colorFactors.z = mat.pbrData.baseColorFactor[2];
-        constants.colorFactors.w = mat.pbrData.baseColorFactor[3];
+        newMat.colorFactors.x = mat.pbrData.baseColorFactor[0];
+        newMat.colorFactors.y = mat.pbrData.baseColorFactor[1];
+        newMat.colorFactors.z = mat.pbrData.baseColorFactor[2];
+        newMat.colorFactors.w = mat.pbrData.baseColorFactor[3];
 
-        constants.metal_rough_factors.x = mat.pbrData.metallicFactor;
-        constants.metal_rough_factors.y = mat.pbrData.roughnessFactor;
-        // write material parameters to buffer
-        sceneMaterialConstants[data_index] = constants;
+        newMat.metalRoughFactors = glm::vec4(0.f);
+        newMat.metalRoughFactors.x = mat.pbrData.metallicFactor;
+        newMat.metalRoughFactors.y = mat.pbrData.roughnessFactor;
 
-        MaterialPass passType = MaterialPass::MainColor;
+        newMat.passType = MaterialPass::MainColor;
         if (mat.alphaMode == fastgltf::AlphaMode::Blend)
-            passType = MaterialPass::Transparent;
+            newMat.passType = MaterialPass::Transparent;
 
-        GLTFMRMaterialSystem::MaterialResources materialResources;
-        // default the material textures
-        materialResources.colorImage = creatorData.defaultImage;
-        materialResources.colorSampler = creatorData._defaultSamplerLinear;
-        materialResources.metalRoughImage = creatorData.defaultImage;
-        materialResources.metalRoughSampler = creatorData._defaultSamplerLinear;
-
-        // set the uniform buffer for the material data
-        materialResources.dataBuffer = file.materialDataBuffer.buffer;
-        materialResources.dataBufferOffset = data_index * sizeof(GLTFMRMaterialSystem::MaterialConstants);
         // grab textures from gltf file
         if (mat.pbrData.baseColorTexture.has_value())
         {
-            size_t img = gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex].imageIndex.value();
-            size_t sampler = gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex].samplerIndex.value();
-
-            materialResources.colorImage = images[img];
-            materialResources.colorSampler = file.samplers[sampler];
+            fastgltf::Texture &texture = gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex];
+            newMat.colorImage = static_cast<int32_t>(texture_image(texture, imported.images).value_or(-1));
+            newMat.colorSampler = texture.samplerIndex.has_value() ? static_cast<int32_t>(*texture.samplerIndex) : -1;
         }
         if (mat.pbrData.metallicRoughnessTexture.has_value())
         {
-            size_t img = gltf.textures[mat.pbrData.metallicRoughnessTexture.value().textureIndex].imageIndex.value();
-            size_t sampler =
-                gltf.textures[mat.pbrData.metallicRoughnessTexture.value().textureIndex].samplerIndex.value();
-
-            materialResources.metalRoughImage = images[img];
-            materialResources.metalRoughSampler = file.samplers[sampler];
+            fastgltf::Texture &texture = gltf.textures[mat.pbrData.metallicRoughnessTexture.value().textureIndex];
+            newMat.metalRoughImage = static_cast<int32_t>(texture_image(texture, imported.images).value_or(-1));
+            newMat.metalRoughSampler =
+                texture.samplerIndex.has_value() ? static_cast<int32_t>(*texture.samplerIndex) : -1;
         }
-        // build material
-        newMat->data = creatorData.materialSystemReference->write_material(creatorData._device, passType,
-                                                                           materialResources, file.descriptorPool);
 
-        data_index++;
+        imported.materials.push_back(newMat);
     }
 
-    // use the same vectors for all meshes so that the memory doesnt reallocate as
-    // often
-    std::vector<uint32_t> indices;
-    std::vector<Vertex> vertices;
+    // each mesh keeps its own arrays, they are wrapped into the imported meshes once they are final
+    std::vector<std::vector<uint32_t>> meshIndices(gltf.meshes.size());
+    std::vector<std::vector<Vertex>> meshVertices(gltf.meshes.size());
+    std::vector<glm::vec3> scratchPositions, scratchNormals, scratchRgbColors;
+    std::vector<glm::vec2> scratchUvs;
+    std::vector<glm::vec4> scratchColors;
+    auto conversionStart = std::chrono::steady_clock::now();
 
     for (fastgltf::Mesh &mesh : gltf.meshes)
     {
-        std::shared_ptr<MeshAsset> newmesh = std::make_shared<MeshAsset>();
-        meshes.push_back(newmesh);
-        file.meshes[mesh.name.c_str()] = newmesh;
-        newmesh->name = mesh.name;
+        ImportedMesh newmesh;
+        newmesh.name = mesh.name;
 
-        // clear the mesh arrays each mesh, we dont want to merge them by error
-        indices.clear();
-        vertices.clear();
+        std::vector<uint32_t> &indices = meshIndices[imported.meshes.size()];
+        std::vector<Vertex> &vertices = meshVertices[imported.meshes.size()];
 
         for (auto &&p : mesh.primitives)
         {
-            GeoSurface newSurface;
+            ImportedSurface newSurface;
             newSurface.startIndex = (uint32_t)indices.size();
             newSurface.count = (uint32_t)gltf.accessors[p.indicesAccessor.value()].count;
 
@@ -246,118 +449,218 @@ std::optional<std::shared_ptr<sgraph::GLTFScene>> loadGltf(GLTFCreatorData creat
                                                          { indices.push_back(idx + initial_vtx); });
             }
 
-            // load vertex positions
-            {
-                fastgltf::Accessor &posAccessor = gltf.accessors[p.findAttribute("POSITION")->accessorIndex];
-                vertices.resize(vertices.size() + posAccessor.count);
-
-                fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, posAccessor,
-                                                              [&](glm::vec3 v, size_t index)
-                                                              {
-                                                                  Vertex newvtx;
-                                                                  newvtx.position = v;
-                                                                  newvtx.normal = {1, 0, 0};
-                                                                  newvtx.color = glm::vec4{1.f};
-                                                                  newvtx.uv_x = 0;
-                                                                  newvtx.uv_y = 0;
-                                                                  vertices[initial_vtx + index] = newvtx;
-                                                              });
-            }
+            vertexasm::PositionBounds bounds;
 
-            // load vertex normals
-            auto normals = p.findAttribute("NORMAL");
-            if (normals != p.attributes.end())
+            // vertex attributes, interleaved and bounded in one pass. attributes that can't be read in place are
+            // converted into the scratch arrays first
             {
+                vertexasm::VertexStreams streams;
+                fastgltf::Accessor &posAccessor = gltf.accessors[p.findAttribute("POSITION")->accessorIndex];
+                size_t count = posAccessor.count;
+                streams.positions = attribute_stream(gltf, posAccessor, count, scratchPositions);
 
-                fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, gltf.accessors[(*normals).accessorIndex],
-                                                              [&](glm::vec3 v, size_t index)
-                                                              { vertices[initial_vtx + index].normal = v; });
-            }
-
-            // load UVs
-            auto uv = p.findAttribute("TEXCOORD_0");
-            if (uv != p.attributes.end())
-            {
+                auto normals = p.findAttribute("NORMAL");
+                if (normals != p.attributes.end())
+                    streams.normals = attribute_stream(gltf, gltf.accessors[normals->accessorIndex], count,
+                                                     scratchNormals);
 
-                fastgltf::iterateAccessorWithIndex<glm::vec2>(gltf, gltf.accessors[(*uv).accessorIndex],
-                                                              [&](glm::vec2 v, size_t index)
-                                                              {
-                                                                  vertices[initial_vtx + index].uv_x = v.x;
-                                                                  vertices[initial_vtx + index].uv_y = v.y;
-                                                              });
-            }
+                auto uv = p.findAttribute("TEXCOORD_0");
+                if (uv != p.attributes.end())
+                    streams.uvs = attribute_stream(gltf, gltf.accessors[uv->accessorIndex], count, scratchUvs);
 
-            // load vertex colors
-            auto colors = p.findAttribute("COLOR_0");
-            if (colors != p.attributes.end())
-            {
-                auto &accessor = gltf.accessors[(*colors).accessorIndex];
-                if (accessor.type == fastgltf::AccessorType::Vec4)
-                {
-                    fastgltf::iterateAccessorWithIndex<glm::vec4>(gltf, gltf.accessors[(*colors).accessorIndex],
-                                                                  [&](glm::vec4 v, size_t index)
-                                                                  { vertices[initial_vtx + index].color = v; });
-                }
-                else if (accessor.type == fastgltf::AccessorType::Vec3)
+                auto colors = p.findAttribute("COLOR_0");
+                if (colors != p.attributes.end())
                 {
-                    fastgltf::iterateAccessorWithIndex<glm::vec3>(
-                        gltf, gltf.accessors[(*colors).accessorIndex],
-                        [&](glm::vec3 v, size_t index) { vertices[initial_vtx + index].color = glm::vec4(v, 1.0f); });
+                    fastgltf::Accessor &accessor = gltf.accessors[colors->accessorIndex];
+                    if (accessor.type == fastgltf::AccessorType::Vec4)
+                        streams.colors = attribute_stream(gltf, accessor, count, scratchColors);
+                    else if (accessor.type == fastgltf::AccessorType::Vec3)
+                    {
+                        streams.colors = attribute_stream(gltf, accessor, count, scratchRgbColors);
+                        streams.colorComponents = 3;
+                    }
                 }
+
+                vertices.resize(vertices.size() + count);
+                bounds = vertexasm::assemble_vertices(streams, std::span(vertices).subspan(initial_vtx));
             }
 
-            if (p.materialIndex.has_value())
-                newSurface.material = materials[p.materialIndex.value()];
-            else
-                newSurface.material = materials[0];
+            newSurface.materialIndex = p.materialIndex.has_value() ? static_cast<uint32_t>(p.materialIndex.value()) : 0;
 
-            // loop the vertices of this surface, find min/max bounds
-            glm::vec3 minpos = vertices[initial_vtx].position;
-            glm::vec3 maxpos = vertices[initial_vtx].position;
-            for (int i = initial_vtx; i < vertices.size(); i++)
-            {
-                minpos = glm::min(minpos, vertices[i].position);
-                maxpos = glm::max(maxpos, vertices[i].position);
-            }
             // calculate origin and extents from the min/max, use extent lenght for radius
-            newSurface.bounds.origin = (maxpos + minpos) / 2.f;
-            newSurface.bounds.extents = (maxpos - minpos) / 2.f;
+            newSurface.bounds.origin = (bounds.max + bounds.min) / 2.f;
+            newSurface.bounds.extents = (bounds.max - bounds.min) / 2.f;
             newSurface.bounds.sphereRadius = glm::length(newSurface.bounds.extents);
 
-            newmesh->surfaces.push_back(newSurface);
+            newmesh.surfaces.push_back(newSurface);
         }
 
-        newmesh->meshBuffers = creatorData.gpuResourceAllocator->uploadMesh(indices, vertices);
+        imported.meshes.push_back(std::move(newmesh));
     }
 
-    // load all nodes and their meshes
-    for (fastgltf::Node &node : gltf.nodes)
+    phases.vertexConversionMs = elapsed_ms(conversionStart);
+
+    // per mesh processing. meshes dont share anything, so they are all processed in parallel
+    auto processingStart = std::chrono::steady_clock::now();
+    std::vector<std::vector<Meshlet>> meshMeshlets(imported.meshes.size());
+    std::vector<std::vector<SurfaceLod>> meshLods(imported.meshes.size());
+    if (options.optimizeMeshes || options.buildMeshlets || options.buildLods)
     {
-        std::shared_ptr<sgraph::Node> newNode;
+        auto optimizeStart = std::chrono::steady_clock::now();
 
-        // find if the node has a mesh, and if it does hook it to the mesh pointer and allocate it with the meshnode
-        // class
-        if (node.meshIndex.has_value())
+        struct MeshJobStats
         {
-            newNode = std::make_shared<sgraph::GLTFMeshNode>();
-            static_cast<sgraph::GLTFMeshNode *>(newNode.get())->mesh = meshes[*node.meshIndex];
+            meshproc::MeshOptimizationStats optimize;
+            meshproc::MeshletStats meshlets;
+            size_t lodSurfaces = 0;
+            size_t lodLevels = 0;
+            size_t lodTriangles = 0;
+        };
+
+        std::vector<std::future<MeshJobStats>> meshJobs;
+        meshJobs.reserve(imported.meshes.size());
+        for (size_t i = 0; i < imported.meshes.size(); i++)
+        {
+            meshJobs.push_back(ThreadPool::Get().submit(
+                [&, i]()
+                {
+                    MeshJobStats stats;
+                    std::vector<ImportedSurface> &surfaces = imported.meshes[i].surfaces;
+                    if (options.optimizeMeshes)
+                    {
+                        std::vector<meshproc::IndexRange> ranges;
+                        for (const ImportedSurface &surface : surfaces)
+                            ranges.push_back({surface.startIndex, surface.count});
+                        stats.optimize = meshproc::optimize_mesh(meshVertices[i], meshIndices[i], ranges);
+                    }
+
+                    if (options.buildMeshlets)
+                    {
+                        for (ImportedSurface &surface : surfaces)
+                        {
+                            std::vector<Meshlet> meshlets = meshproc::build_meshlets(
+                                std::span(meshIndices[i]).subspan(surface.startIndex, surface.count), meshVertices[i],
+                                surface.startIndex);
+                            surface.firstMeshlet = static_cast<uint32_t>(meshMeshlets[i].size());
+                            surface.meshletCount = static_cast<uint32_t>(meshlets.size());
+                            meshMeshlets[i].insert(meshMeshlets[i].end(), meshlets.begin(), meshlets.end());
+                        }
+                        stats.meshlets = meshproc::analyze_meshlets(meshMeshlets[i]);
+                    }
+
+                    if (options.buildLods)
+                    {
+                        for (ImportedSurface &surface : surfaces)
+                        {
+                            std::vector<SurfaceLod> lods = meshproc::build_lod_chain(
+                                meshIndices[i], {surface.startIndex, surface.count}, meshVertices[i],
+                                options.lodMaxError * surface.bounds.sphereRadius);
+                            if (lods.size() < 2)
+                                continue;
+
+                            surface.firstLod = static_cast<uint32_t>(meshLods[i].size());
+                            surface.lodCount = static_cast<uint32_t>(lods.size());
+                            meshLods[i].insert(meshLods[i].end(), lods.begin(), lods.end());
+
+                            stats.lodSurfaces++;
+                            stats.lodLevels += lods.size();
+                            for (const SurfaceLod &lod : lods)
+                                stats.lodTriangles += lod.indexCount / 3;
+                        }
+                    }
+
+                    // meshlets reorder the triangles, put the vertices back in fetch order
+                    if (options.buildMeshlets || options.buildLods)
+                        meshproc::optimize_vertex_fetch(meshVertices[i], meshIndices[i]);
+                    return stats;
+                }));
         }
-        else if (node.lightIndex.has_value())
+
+        MeshJobStats totals;
+        for (auto &job : meshJobs)
         {
-            // lighting mesh node.
-            newNode = std::make_shared<sgraph::GLTFLightNode>();
-            static_cast<sgraph::GLTFLightNode *>(newNode.get())->lightingData = lights[node.lightIndex.value()];
+            MeshJobStats stats = job.get();
+            totals.optimize.add(stats.optimize);
+            totals.meshlets.add(stats.meshlets);
+            totals.lodSurfaces += stats.lodSurfaces;
+            totals.lodLevels += stats.lodLevels;
+            totals.lodTriangles += stats.lodTriangles;
+        }
+
+        auto optimizeEnd = std::chrono::steady_clock::now();
+        fmt::println("Processed {} meshes in {} ms", imported.meshes.size(),
+                     std::chrono::duration_cast<std::chrono::milliseconds>(optimizeEnd - optimizeStart).count());
+        if (options.optimizeMeshes)
+            fmt::println("Optimized {} meshes ({} triangles): vertices {} -> {}, ACMR {:.3f} -> {:.3f}",
+                         totals.optimize.meshes, totals.optimize.triangles, totals.optimize.verticesBefore,
+                         totals.optimize.verticesAfter, totals.optimize.acmrBefore, totals.optimize.acmrAfter);
+        if (options.buildMeshlets && totals.meshlets.meshlets > 0)
+        {
+            const meshproc::MeshletStats &m = totals.meshlets;
+            float avgTriangles = float(m.triangles) / m.meshlets;
+            float avgVertices = float(m.vertices) / m.meshlets;
+            fmt::println("Built {} meshlets: {:.1f} triangles ({:.0f}% full), {:.1f} vertices ({:.0f}% full), {} with "
+                         "a normal cone",
+                         m.meshlets, avgTriangles, 100.f * avgTriangles / meshproc::MESHLET_MAX_TRIANGLES,
+                         avgVertices, 100.f * avgVertices / meshproc::MESHLET_MAX_VERTICES, m.withCone);
+        }
+        if (options.buildLods && totals.lodSurfaces > 0)
+            fmt::println("Built LOD chains for {} surfaces, {:.1f} levels each, {} triangles over all levels",
+                         totals.lodSurfaces, float(totals.lodLevels) / totals.lodSurfaces, totals.lodTriangles);
+    }
+
+    // pick the vertex layout per mesh, meshes that would lose too much precision stay in the float layout
+    size_t packedMeshes = 0, floatBytes = 0, storedBytes = 0;
+    for (size_t i = 0; i < imported.meshes.size(); i++)
+    {
+        ImportedMesh &mesh = imported.meshes[i];
+        mesh.indices = SharedSpan<uint32_t>::fromVector(std::move(meshIndices[i]));
+        mesh.meshlets = SharedSpan<Meshlet>::fromVector(std::move(meshMeshlets[i]));
+        mesh.lods = SharedSpan<SurfaceLod>::fromVector(std::move(meshLods[i]));
+        floatBytes += meshVertices[i].size() * sizeof(Vertex);
+
+        std::optional<meshproc::QuantizedVertices> quantized;
+        if (options.quantizeVertices)
+            quantized = meshproc::quantize_vertices(meshVertices[i], options.maxPositionError,
+                                                    options.maxUVError);
+
+        if (quantized.has_value())
+        {
+            mesh.vertexFormat = VertexFormat::Packed;
+            mesh.quantization = quantized->quantization;
+            mesh.packedVertices = SharedSpan<PackedVertex>::fromVector(std::move(quantized->vertices));
+            storedBytes += mesh.packedVertices.data.size_bytes();
+            packedMeshes++;
         }
         else
         {
-            newNode = std::make_shared<sgraph::Node>();
+            mesh.vertexFormat = VertexFormat::Float;
+            mesh.vertices = SharedSpan<Vertex>::fromVector(std::move(meshVertices[i]));
+            storedBytes += mesh.vertices.data.size_bytes();
         }
+    }
 
-        nodes.push_back(newNode);
-        file.nodes[node.name.c_str()];
+    if (options.quantizeVertices)
+        fmt::println("Packed vertices of {}/{} meshes, vertex data {:.1f} MB -> {:.1f} MB", packedMeshes,
+                     imported.meshes.size(), floatBytes / (1024.f * 1024.f), storedBytes / (1024.f * 1024.f));
+    phases.meshProcessingMs = elapsed_ms(processingStart);
+
+    // load all nodes and their transforms
+    for (fastgltf::Node &node : gltf.nodes)
+    {
+        ImportedNode newNode;
+        newNode.name = node.name;
+
+        if (node.meshIndex.has_value())
+            newNode.mesh = static_cast<int32_t>(*node.meshIndex);
+        else if (node.lightIndex.has_value())
+            newNode.light = static_cast<int32_t>(*node.lightIndex);
+
+        for (auto &c : node.children)
+            newNode.children.push_back(static_cast<uint32_t>(c));
 
         std::visit(fastgltf::visitor{[&](fastgltf::math::fmat4x4 matrix)
-                                     { memcpy(&newNode->localTransform, matrix.data(), sizeof(matrix)); },
+                                     { newNode.localTransform = glm::make_mat4(matrix.data()); },
                                      [&](fastgltf::TRS transform)
                                      {
                                          glm::vec3 tl(transform.translation[0], transform.translation[1],
@@ -370,18 +673,306 @@ std::optional<std::shared_ptr<sgraph::GLTFScene>> loadGltf(GLTFCreatorData creat
                                          glm::mat4 rm = glm::toMat4(rot);
                                          glm::mat4 sm = glm::scale(glm::mat4(1.f), sc);
 
-                                         newNode->localTransform = tm * rm * sm;
+                                         newNode.localTransform = tm * rm * sm;
                                      }},
                    node.transform);
+
+        imported.nodes.push_back(std::move(newNode));
+    }
+
+    if (stats)
+    {
+        for (const std::shared_ptr<MappedFile> &mapping : mappings)
+            phases.fileBytes += mapping->bytes().size();
+        count_imported_bytes(imported, phases);
+        *stats = phases;
+    }
+
+    return imported;
+}
+
+GLTFSceneBuilder::GLTFSceneBuilder(GLTFCreatorData creatorData, std::shared_ptr<const ImportedScene> imported)
+    : creatorData(creatorData), imported(std::move(imported))
+{
+    builtScene = std::make_shared<sgraph::GLTFScene>();
+    builtScene->creator = creatorData;
+    sgraph::GLTFScene &file = *builtScene.get();
+
+    // load samplers
+    for (const ImportedSampler &sampler : this->imported->samplers)
+    {
+
+        VkSamplerCreateInfo sampl = {.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO, .pNext = nullptr};
+        sampl.maxLod = VK_LOD_CLAMP_NONE;
+        sampl.minLod = 0;
+
+        sampl.magFilter = sampler.magFilter;
+        sampl.minFilter = sampler.minFilter;
+
+        sampl.mipmapMode = sampler.mipmapMode;
+
+        // shared with every other scene and the engine, never destroyed by the scene
+        file.samplers.push_back(creatorData.gpuResourceAllocator->get_sampler(sampl));
+    }
+}
+
+bool GLTFSceneBuilder::step(size_t byteBudget)
+{
+    if (stage == Stage::Done)
+        return true;
+
+    GPUResourceAllocator *allocator = creatorData.gpuResourceAllocator;
+    sgraph::GLTFScene &file = *builtScene.get();
+    auto stepStart = std::chrono::steady_clock::now();
+    float buildNodesMs = 0;
+
+    // everything staged in this step goes into one upload batch, submitted at the end of the step
+    allocator->begin_upload_batch();
+
+    size_t stagedBytes = 0;
+    std::vector<MeshAsset *> uploadedMeshes;
+    while (stage != Stage::Done && stagedBytes < std::max<size_t>(byteBudget, 1))
+    {
+        if (stage == Stage::Images)
+        {
+            if (next == imported->images.size())
+            {
+                // every texture is recorded, the materials can point to them
+                auto buildStart = std::chrono::steady_clock::now();
+                build_nodes();
+                buildNodesMs = elapsed_ms(buildStart);
+                stage = Stage::Meshes;
+                next = 0;
+                continue;
+            }
+
+            const ImportedImage &image = imported->images[next++];
+            if (!image.texels.data.empty() && creatorData.textureStreamer)
+            {
+                // uploaded later, once a material using it is on screen. until then the material samples the default
+                // image
+                uint64_t key = texture_cache_key(image);
+                creatorData.textureStreamer->add_texture(key, image);
+                images.push_back(creatorData.defaultImage);
+                streamedImages.push_back(key);
+                file.textureKeys.push_back(key);
+            }
+            else if (!image.texels.data.empty())
+            {
+                // another scene may have uploaded the same file with the same processing already
+                uint64_t key = texture_cache_key(image);
+                std::optional<AllocatedImage> img = TextureCache::Get().acquire(key);
+                if (img.has_value())
+                {
+                    sharedImages++;
+                }
+                else
+                {
+                    img = allocator->create_image(image.level_spans(), image.extent, image.format,
+                                                  VK_IMAGE_USAGE_SAMPLED_BIT, image.swizzle);
+                    img = TextureCache::Get().insert(key, *img, *allocator);
+                    stagedBytes += image.texels.data.size_bytes();
+                }
+
+                images.push_back(*img);
+                file.images[image.name] = *img;
+                file.textureKeys.push_back(key);
+                streamedImages.push_back(0);
+            }
+            else
+            {
+                // we failed to load, so lets give the slot a default white texture to not
+                // completely break loading
+                images.push_back(creatorData.loadErrorImage);
+                streamedImages.push_back(0);
+            }
+        }
+        else
+        {
+            if (next == imported->meshes.size())
+            {
+                stage = Stage::Done;
+                break;
+            }
+
+            const ImportedMesh &mesh = imported->meshes[next];
+            MeshAsset &newmesh = *meshes[next];
+            next++;
+
+            if (mesh.vertexFormat == VertexFormat::Packed)
+            {
+                newmesh.meshBuffers =
+                    allocator->uploadMesh(mesh.indices.data, mesh.packedVertices.data, mesh.quantization);
+                stagedBytes += mesh.packedVertices.data.size_bytes();
+            }
+            else
+            {
+                newmesh.meshBuffers = allocator->uploadMesh(mesh.indices.data, mesh.vertices.data);
+                stagedBytes += mesh.vertices.data.size_bytes();
+            }
+            stagedBytes += mesh.indices.data.size_bytes();
+            uploadedMeshes.push_back(&newmesh);
+        }
+    }
+
+    UploadBatchStats batchStats = allocator->submit_upload_batch();
+    uploadStats.uploads += batchStats.uploads;
+    uploadStats.submits += batchStats.submits;
+    uploadStats.stagingBytes += batchStats.stagingBytes;
+    uploadStats.submitTime += batchStats.submitTime;
+    uploadStats.roundTripTime = std::max(uploadStats.roundTripTime, batchStats.roundTripTime);
+    buildStats.uploadMs += elapsed_ms(stepStart) - buildNodesMs;
+    buildStats.uploadBytes += batchStats.stagingBytes;
+
+    // the batch waited on the copies, the meshes can be drawn from now on
+    for (MeshAsset *mesh : uploadedMeshes)
+        mesh->resident = true;
+
+    if (stage != Stage::Done)
+        return false;
+
+    // one submit per resource would have paid a round trip for every submit the batches saved
+    uint32_t savedSubmits = uploadStats.uploads > uploadStats.submits ? uploadStats.uploads - uploadStats.submits : 0;
+    fmt::println("Uploaded {} resources ({:.1f} MB) with {} submit(s) in {:.2f} ms. Saved {} submit-and-wait round "
+                 "trips of {:.3f} ms, about {:.2f} ms",
+                 uploadStats.uploads, uploadStats.stagingBytes / (1024.f * 1024.f), uploadStats.submits,
+                 uploadStats.submitTime, savedSubmits, uploadStats.roundTripTime,
+                 savedSubmits * uploadStats.roundTripTime);
+
+    TextureCacheStats textureStats = TextureCache::Get().stats();
+    fmt::println("Texture cache: {} of {} image(s) shared with other scenes, {} texture(s) resident", sharedImages,
+                 imported->images.size(), textureStats.textures);
+    fmt::println("Sampler cache: the file declares {} sampler(s), {} unique sampler(s) exist in total",
+                 imported->samplers.size(), allocator->sampler_count());
+
+    GeometryPoolStats poolStats = allocator->geometry_pool_stats();
+    fmt::println("Geometry pool: {} meshes in {} page(s), {:.1f}/{:.1f} MB vertices, {:.1f}/{:.1f} MB indices",
+                 poolStats.allocations, poolStats.pages, poolStats.vertexBytesUsed / (1024.f * 1024.f),
+                 poolStats.vertexBytesCapacity / (1024.f * 1024.f), poolStats.indexBytesUsed / (1024.f * 1024.f),
+                 poolStats.indexBytesCapacity / (1024.f * 1024.f));
+
+    return true;
+}
+
+void GLTFSceneBuilder::build_nodes()
+{
+    sgraph::GLTFScene &file = *builtScene.get();
+
+    // temporal arrays for all the objects to use while creating the GLTF data
+    std::vector<std::shared_ptr<sgraph::Node>> nodes;
+    std::vector<std::shared_ptr<GLTFMaterial>> materials;
+    std::vector<std::shared_ptr<LightingData>> lights;
+
+    // load all lights first
+    for (const LightingData &light : imported->lights)
+    {
+        std::shared_ptr<LightingData> ldata = std::make_shared<LightingData>(light);
+        file.lightingData[ldata->name] = ldata;
+        lights.push_back(ldata);
+    }
+
+    for (const ImportedMaterial &mat : imported->materials)
+    {
+        std::shared_ptr<GLTFMaterial> newMat = std::make_shared<GLTFMaterial>();
+        materials.push_back(newMat);
+        file.materials[mat.name] = newMat;
+
+        GLTFMRMaterialSystem::MaterialResources materialResources;
+        // default the material textures
+        materialResources.colorImage = creatorData.defaultImage;
+        materialResources.colorSampler = creatorData._defaultSamplerLinear;
+        materialResources.metalRoughImage = creatorData.defaultImage;
+        materialResources.metalRoughSampler = creatorData._defaultSamplerLinear;
+        // material parameters, they go into the material table
+        materialResources.colorFactors = mat.colorFactors;
+        materialResources.metalRoughFactors = mat.metalRoughFactors;
+        // grab textures from gltf file
+        if (mat.colorImage >= 0)
+        {
+            materialResources.colorImage = images[mat.colorImage];
+            if (mat.colorSampler >= 0)
+                materialResources.colorSampler = file.samplers[mat.colorSampler];
+        }
+        if (mat.metalRoughImage >= 0)
+        {
+            materialResources.metalRoughImage = images[mat.metalRoughImage];
+            if (mat.metalRoughSampler >= 0)
+                materialResources.metalRoughSampler = file.samplers[mat.metalRoughSampler];
+        }
+        // build material
+        auto writeStart = std::chrono::steady_clock::now();
+        newMat->data = creatorData.materialSystemReference->write_material(creatorData._device, mat.passType,
+                                                                           materialResources);
+        buildStats.descriptorWriteMs += elapsed_ms(writeStart);
+
+        // the streamer swaps the placeholders for the real textures while the material is visible
+        uint64_t colorKey = mat.colorImage >= 0 ? streamedImages[mat.colorImage] : 0;
+        uint64_t metalRoughKey = mat.metalRoughImage >= 0 ? streamedImages[mat.metalRoughImage] : 0;
+        if (creatorData.textureStreamer && (colorKey != 0 || metalRoughKey != 0))
+        {
+            creatorData.textureStreamer->add_material(&newMat->data, materialResources, colorKey, metalRoughKey);
+        }
+    }
+
+    // the meshes are uploaded by the following steps, until then they are not resident and not drawn
+    for (const ImportedMesh &mesh : imported->meshes)
+    {
+        std::shared_ptr<MeshAsset> newmesh = std::make_shared<MeshAsset>();
+        meshes.push_back(newmesh);
+        file.meshes[mesh.name] = newmesh;
+        newmesh->name = mesh.name;
+        newmesh->meshlets.assign(mesh.meshlets.data.begin(), mesh.meshlets.data.end());
+        newmesh->lods.assign(mesh.lods.data.begin(), mesh.lods.data.end());
+
+        for (const ImportedSurface &surface : mesh.surfaces)
+        {
+            GeoSurface newSurface;
+            newSurface.startIndex = surface.startIndex;
+            newSurface.count = surface.count;
+            newSurface.bounds = surface.bounds;
+            newSurface.firstMeshlet = surface.firstMeshlet;
+            newSurface.meshletCount = surface.meshletCount;
+            newSurface.firstLod = surface.firstLod;
+            newSurface.lodCount = surface.lodCount;
+            newSurface.material = materials[surface.materialIndex];
+
+            newmesh->surfaces.push_back(newSurface);
+        }
+    }
+
+    // load all nodes and their meshes
+    for (const ImportedNode &node : imported->nodes)
+    {
+        std::shared_ptr<sgraph::Node> newNode;
+
+        // find if the node has a mesh, and if it does hook it to the mesh pointer and allocate it with the meshnode
+        // class
+        if (node.mesh >= 0)
+        {
+            newNode = std::make_shared<sgraph::GLTFMeshNode>();
+            static_cast<sgraph::GLTFMeshNode *>(newNode.get())->mesh = meshes[node.mesh];
+        }
+        else if (node.light >= 0)
+        {
+            // lighting mesh node.
+            newNode = std::make_shared<sgraph::GLTFLightNode>();
+            static_cast<sgraph::GLTFLightNode *>(newNode.get())->lightingData = lights[node.light];
+        }
+        else
+        {
+            newNode = std::make_shared<sgraph::Node>();
+        }
+
+        nodes.push_back(newNode);
+        file.nodes[node.name] = newNode;
     }
 
     // run loop again to setup transform hierarchy
-    for (int i = 0; i < gltf.nodes.size(); i++)
+    for (int i = 0; i < imported->nodes.size(); i++)
     {
-        fastgltf::Node &node = gltf.nodes[i];
         std::shared_ptr<sgraph::Node> &sceneNode = nodes[i];
 
-        for (auto &c : node.children)
+        for (uint32_t c : imported->nodes[i].children)
         {
             sceneNode->children.push_back(nodes[c]);
             nodes[c]->parent = sceneNode;
@@ -392,49 +983,127 @@ std::optional<std::shared_ptr<sgraph::GLTFScene>> loadGltf(GLTFCreatorData creat
     for (auto &node : nodes)
     {
         if (node->parent.lock() == nullptr)
-        {
             file.topNodes.push_back(node);
-            node->refreshTransform(glm::mat4{1.f});
-        }
     }
 
-    return scene;
+    // flatten the transforms depth first from the top nodes, so every subtree is a contiguous range of the store.
+    // the stack holds node indices with the handle of their parent
+    file.transforms = std::make_shared<sgraph::TransformStore>();
+    file.transforms->reserve(nodes.size());
+    file.nodesByHandle.reserve(nodes.size());
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    for (uint32_t i = static_cast<uint32_t>(nodes.size()); i-- > 0;)
+    {
+        if (nodes[i]->parent.expired())
+            stack.push_back({i, sgraph::TransformStore::NO_PARENT});
+    }
+    while (!stack.empty())
+    {
+        auto [index, parentHandle] = stack.back();
+        stack.pop_back();
+
+        sgraph::Node &node = *nodes[index];
+        node.transforms = file.transforms;
+        node.transformHandle = file.transforms->add(parentHandle, imported->nodes[index].localTransform);
+        file.nodesByHandle.push_back(&node);
+
+        const std::vector<uint32_t> &children = imported->nodes[index].children;
+        for (auto c = children.rbegin(); c != children.rend(); c++)
+            stack.push_back({*c, node.transformHandle});
+    }
+    file.transforms->update();
 }
 
-void sgraph::GLTFScene::Draw(const glm::mat4 &topMatrix, DrawContext &ctx)
+std::shared_ptr<sgraph::GLTFScene> buildGltfScene(GLTFCreatorData creatorData,
+                                                  std::shared_ptr<const ImportedScene> imported, LoadStats *stats)
 {
-    // create renderables from the scenenodes
-    for (auto &n : topNodes)
-        n->Draw(topMatrix, ctx);
+    GLTFSceneBuilder builder(creatorData, std::move(imported));
+    builder.step(SIZE_MAX);
+
+    if (stats)
+    {
+        stats->uploadMs = builder.stats().uploadMs;
+        stats->descriptorWriteMs = builder.stats().descriptorWriteMs;
+        stats->uploadBytes = builder.stats().uploadBytes;
+    }
+    return builder.scene();
 }
 
-void sgraph::GLTFScene::clearAll()
+void sgraph::GLTFScene::Sync(const glm::mat4 &topMatrix, RenderProxyRegistry &registry)
 {
-    VkDevice dv = creator._device;
+    if (!transforms)
+        return;
 
-    descriptorPool.destroy_pools(dv);
-    creator.gpuResourceAllocator->destroy_buffer(materialDataBuffer);
+    // a scene registers with one registry only
+    assert(this->registry == nullptr || this->registry == &registry);
+    if (this->registry == nullptr)
+    {
+        this->registry = &registry;
+        pendingNodes = nodesByHandle;
+    }
 
-    for (auto &[k, v] : meshes)
+    // the top matrix goes in as the root of the store, only the subtrees that moved since the last frame are swept
+    transforms->set_root(topMatrix);
+    transforms->update();
+
+    // the swept ranges are subtrees, laid end to end they are split into batches across the pool. every node writes
+    // only its own proxies in place, so the batches need no locks and the draw context keeps its order
+    const std::vector<std::pair<uint32_t, uint32_t>> &swept = transforms->swept();
+    size_t moved = 0;
+    for (auto [first, end] : swept)
+        moved += end - first;
+
+    ThreadPool::Get().parallel_for(moved, proxyUpdateBatch,
+                                   [&](uint32_t, size_t begin, size_t end)
+                                   {
+                                       size_t offset = 0;
+                                       for (auto [first, last] : swept)
+                                       {
+                                           size_t from = std::max(begin, offset);
+                                           size_t to = std::min(end, offset + (last - first));
+                                           for (size_t i = from; i < to; i++)
+                                               nodesByHandle[first + i - offset]->transformChanged();
+                                           offset += last - first;
+                                       }
+                                   });
+
+    // nodes register from their current world transform, meshes still being uploaded wait for the next frames
+    std::erase_if(pendingNodes, [&](Node *node) { return node->registerProxies(registry); });
+}
+
+void sgraph::GLTFScene::clearAll()
+{
+    // the proxies point into the mesh buffers and materials freed below
+    if (registry)
     {
+        for (Node *node : nodesByHandle)
+            node->removeProxies();
+    }
 
-        creator.gpuResourceAllocator->destroy_buffer(v->meshBuffers.indexBuffer);
-        creator.gpuResourceAllocator->destroy_buffer(v->meshBuffers.vertexBuffer);
+    // the streamer patches the material table entries, it has to forget them before they are freed
+    for (auto &[k, v] : materials)
+    {
+        if (creator.textureStreamer)
+            creator.textureStreamer->remove_material(&v->data);
+        creator.materialSystemReference->free_material(v->data);
     }
 
-    for (auto &[k, v] : images)
+    for (auto &[k, v] : meshes)
     {
 
-        if (v.image == creator.loadErrorImage.image)
-        {
-            // dont destroy the default images
-            continue;
-        }
-        creator.gpuResourceAllocator->destroy_image(v);
+        // meshes of a scene dropped while it was still loading may not have been uploaded
+        if (v->resident)
+            creator.gpuResourceAllocator->free_mesh(v->meshBuffers);
     }
 
-    for (auto &sampler : samplers)
-        vkDestroySampler(dv, sampler, nullptr);
+    // images can be shared with other scenes, the cache destroys them once nobody uses them anymore
+    for (uint64_t key : textureKeys)
+    {
+        if (creator.textureStreamer)
+            creator.textureStreamer->release_texture(key);
+        else
+            TextureCache::Get().release(key, *creator.gpuResourceAllocator);
+    }
 }
 
 VkFilter extract_filter(fastgltf::Filter filter)
@@ -471,113 +1140,338 @@ VkSamplerMipmapMode extract_mipmap_mode(fastgltf::Filter filter)
     }
 }
 
-std::optional<AllocatedImage> load_image(GPUResourceAllocator *gpuResourceAllocator, fastgltf::Asset &asset,
-                                         fastgltf::Image &image)
+
+bool load_external_buffers(fastgltf::Asset &asset, const std::filesystem::path &directory,
+                           std::vector<std::filesystem::path> &sourceFiles,
+                           std::vector<std::shared_ptr<MappedFile>> &mappings)
 {
-    AllocatedImage newImage{};
+    for (fastgltf::Buffer &buffer : asset.buffers)
+    {
+        auto uri = std::get_if<fastgltf::sources::URI>(&buffer.data);
+        if (uri == nullptr)
+            continue;
+
+        if (!uri->uri.isLocalPath())
+        {
+            std::cerr << "Only local buffers are supported: " << uri->uri.string() << std::endl;
+            return false;
+        }
 
-    int width, height, nrChannels;
+        std::filesystem::path bufferPath = directory / uri->uri.fspath();
+        std::shared_ptr<MappedFile> mapping = MappedFile::open(bufferPath);
+        if (!mapping)
+        {
+            std::cerr << "Failed to open buffer " << bufferPath << std::endl;
+            return false;
+        }
 
-    std::visit(
-        fastgltf::visitor{
-            [](auto &arg) {},
-            [&](fastgltf::sources::URI &filePath)
-            {
-                assert(filePath.fileByteOffset == 0); // We don't support offsets with stbi.
-                assert(filePath.uri.isLocalPath());   // We're only capable of loading
-                                                      // local files.
-
-                const std::string path(filePath.uri.path().begin(),
-                                       filePath.uri.path().end()); // Thanks C++.
-                unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrChannels, 4);
-                if (data)
-                {
-                    VkExtent3D imagesize;
-                    imagesize.width = width;
-                    imagesize.height = height;
-                    imagesize.depth = 1;
+        std::span<const std::byte> bytes = mapping->bytes();
+        if (uri->fileByteOffset + buffer.byteLength > bytes.size())
+        {
+            std::cerr << "Failed to read buffer " << bufferPath << std::endl;
+            return false;
+        }
+        bytes = bytes.subspan(uri->fileByteOffset, buffer.byteLength);
 
-                    newImage = gpuResourceAllocator->create_image(data, imagesize, VK_FORMAT_R8G8B8A8_UNORM,
-                                                                  VK_IMAGE_USAGE_SAMPLED_BIT, false);
+        sourceFiles.push_back(bufferPath);
+        buffer.data = fastgltf::sources::ByteView{fastgltf::span<const std::byte>(bytes.data(), bytes.size()),
+                                                  uri->mimeType};
+        mappings.push_back(std::move(mapping));
+    }
+    return true;
+}
 
-                    stbi_image_free(data);
-                }
-            },
-            [&](fastgltf::sources::Vector &vector)
-            {
-                unsigned char *data =
-                    stbi_load_from_memory(reinterpret_cast<const unsigned char *>(vector.bytes.data()),
-                                          static_cast<int>(vector.bytes.size()), &width, &height, &nrChannels, 4);
-                if (data)
-                {
-                    VkExtent3D imagesize;
-                    imagesize.width = width;
-                    imagesize.height = height;
-                    imagesize.depth = 1;
+ImportedImage decode_image(fastgltf::Asset &asset, fastgltf::Image &image, const std::filesystem::path &directory,
+                           const std::vector<std::shared_ptr<MappedFile>> &mappings, const ImportOptions &options,
+                           TextureRole role)
+{
+    ImportedImage decoded{};
+    decoded.format = VK_FORMAT_R8G8B8A8_UNORM;
+    decoded.mipLevels = 1;
+
+    // find the encoded bytes of the image, files are mapped instead of read
+    std::span<const std::byte> source;
+    std::shared_ptr<MappedFile> mappedFile;
+
+    std::visit(fastgltf::visitor{
+                   [](auto &arg) {},
+                   [&](fastgltf::sources::URI &filePath)
+                   {
+                       assert(filePath.fileByteOffset == 0); // We don't support offsets with stbi.
+                       assert(filePath.uri.isLocalPath());   // We're only capable of loading
+                                                             // local files.
+
+                       // relative to the gltf file, not the working directory
+                       mappedFile = MappedFile::open(directory / filePath.uri.fspath());
+                       if (mappedFile)
+                           source = mappedFile->bytes();
+                   },
+                   [&](fastgltf::sources::Vector &vector) { source = vector.bytes; },
+                   [&](fastgltf::sources::Array &array) { source = array.bytes; },
+                   [&](fastgltf::sources::BufferView &view)
+                   {
+                       auto &bufferView = asset.bufferViews[view.bufferViewIndex];
+                       auto &buffer = asset.buffers[bufferView.bufferIndex];
+
+                       // external buffers and glb binary chunks are views into the mapped files, data uris
+                       // are decoded into arrays
+                       std::visit(fastgltf::visitor{
+                                      [](auto &arg) {},
+                                      [&](fastgltf::sources::Vector &vector)
+                                      {
+                                          source = std::span<const std::byte>(vector.bytes)
+                                                       .subspan(bufferView.byteOffset, bufferView.byteLength);
+                                      },
+                                      [&](fastgltf::sources::Array &array)
+                                      {
+                                          source = std::span<const std::byte>(array.bytes)
+                                                       .subspan(bufferView.byteOffset, bufferView.byteLength);
+                                      },
+                                      [&](fastgltf::sources::ByteView &view)
+                                      {
+                                          source = std::span<const std::byte>(view.bytes.data(), view.bytes.size())
+                                                       .subspan(bufferView.byteOffset, bufferView.byteLength);
+                                      },
+                                  },
+                                  buffer.data);
+                   },
+               },
+               image.data);
+
+    if (source.empty())
+        return decoded;
+
+    decoded.contentHash = hash_bytes(source.data(), source.size());
+
+    // ktx2 textures are already in their final format, the stored levels are uploaded as they are
+    if (ktx2::is_ktx2(source))
+    {
+        std::optional<ktx2::Texture> texture = ktx2::parse(source);
+        if (!texture.has_value())
+            return decoded;
 
-                    newImage = gpuResourceAllocator->create_image(data, imagesize, VK_FORMAT_R8G8B8A8_UNORM,
-                                                                  VK_IMAGE_USAGE_SAMPLED_BIT, false);
+        // stored bc textures do not depend on whether the importer compresses textures, only on the device
+        if (texproc::is_block_compressed(texture->format) && !options.textureCompressionBC)
+        {
+            fmt::println("KTX2 image {} is block compressed, but the device cannot sample BCn formats", image.name);
+            return decoded;
+        }
 
-                    stbi_image_free(data);
-                }
-            },
-            [&](fastgltf::sources::BufferView &view)
-            {
-                auto &bufferView = asset.bufferViews[view.bufferViewIndex];
-                auto &buffer = asset.buffers[bufferView.bufferIndex];
-
-                std::visit(
-                    fastgltf::visitor{
-                        // We only care about VectorWithMime here, because we
-                        // specify LoadExternalBuffers, meaning all buffers
-                        // are already loaded into a vector.
-                        [](auto &arg) {},
-                        [&](fastgltf::sources::Vector &vector)
-                        {
-                            unsigned char *data = stbi_load_from_memory(
-                                reinterpret_cast<const unsigned char *>(vector.bytes.data()) + bufferView.byteOffset,
-                                static_cast<int>(bufferView.byteLength), &width, &height, &nrChannels, 4);
-                            if (data)
-                            {
-                                VkExtent3D imagesize;
-                                imagesize.width = width;
-                                imagesize.height = height;
-                                imagesize.depth = 1;
-
-                                newImage = gpuResourceAllocator->create_image(data, imagesize, VK_FORMAT_R8G8B8A8_UNORM,
-                                                                              VK_IMAGE_USAGE_SAMPLED_BIT, false);
-
-                                stbi_image_free(data);
-                            }
-                        },
-                        [&](fastgltf::sources::Array &array) // Added this case for newer fastgltf!
-                        {
-                            unsigned char *data = stbi_load_from_memory(
-                                reinterpret_cast<const unsigned char *>(array.bytes.data()) + bufferView.byteOffset,
-                                static_cast<int>(bufferView.byteLength), &width, &height, &nrChannels, 4);
-                            if (data)
-                            {
-                                VkExtent3D imagesize;
-                                imagesize.width = width;
-                                imagesize.height = height;
-                                imagesize.depth = 1;
-
-                                newImage = gpuResourceAllocator->create_image(data, imagesize, VK_FORMAT_R8G8B8A8_UNORM,
-                                                                              VK_IMAGE_USAGE_SAMPLED_BIT, false);
-
-                                stbi_image_free(data);
-                            }
-                        },
-                    },
-                    buffer.data);
-            },
-        },
-        image.data);
-
-    // if any of the attempts to load the data failed, we havent written the image
-    // so handle is null
-    if (newImage.image == VK_NULL_HANDLE)
+        decoded.format = texture->format;
+        decoded.extent = texture->extent;
+        decoded.mipLevels = static_cast<uint32_t>(texture->levels.size());
+
+        // the levels stay where the file has them, the mapping is kept alive with the image and every level is
+        // copied into staging on its own. images from data uris are owned by the asset and are copied
+        std::shared_ptr<MappedFile> owner = mappedFile;
+        for (const std::shared_ptr<MappedFile> &mapping : mappings)
+        {
+            std::span<const std::byte> bytes = mapping->bytes();
+            if (!owner && source.data() >= bytes.data() && source.data() + source.size() <= bytes.data() + bytes.size())
+                owner = mapping;
+        }
+        if (owner)
+        {
+            // texels spans every level, from the first one stored to the end of the last
+            auto [first, last] = std::minmax_element(texture->levels.begin(), texture->levels.end(),
+                                                     [](std::span<const std::byte> a, std::span<const std::byte> b)
+                                                     { return a.data() < b.data(); });
+            auto *begin = reinterpret_cast<const uint8_t *>(first->data());
+            auto *end = reinterpret_cast<const uint8_t *>(last->data()) + last->size();
+            decoded.texels.data = std::span<const uint8_t>(begin, end);
+            decoded.texels.owner = std::move(owner);
+            for (std::span<const std::byte> level : texture->levels)
+                decoded.levels.push_back(std::span<const uint8_t>(reinterpret_cast<const uint8_t *>(level.data()),
+                                                                  level.size()));
+        }
+        else
+        {
+            // levels are copied in level index order, which is already the level 0 first layout of texproc
+            std::vector<uint8_t> texels;
+            for (std::span<const std::byte> level : texture->levels)
+                texels.insert(texels.end(), reinterpret_cast<const uint8_t *>(level.data()),
+                              reinterpret_cast<const uint8_t *>(level.data()) + level.size());
+            decoded.texels = SharedSpan<uint8_t>::fromVector(std::move(texels));
+        }
+
+        // the shaders convert colors from srgb themselves
+        decoded.format = unorm_format(decoded.format);
+        if (role == TextureRole::MetalRough && (decoded.format == VK_FORMAT_BC5_UNORM_BLOCK ||
+                                                decoded.format == VK_FORMAT_R8G8_UNORM))
+        {
+            // two channel metal-rough textures are stored the same way the importer compresses them
+            decoded.swizzle = {VK_COMPONENT_SWIZZLE_ZERO, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G,
+                               VK_COMPONENT_SWIZZLE_ONE};
+        }
+        return decoded;
+    }
+
+    // everything else goes through stbi, always asking for 4 channels
+    int width = 0, height = 0, nrChannels;
+    unsigned char *pixels = stbi_load_from_memory(reinterpret_cast<const unsigned char *>(source.data()),
+                                                  static_cast<int>(source.size()), &width, &height, &nrChannels, 4);
+
+    // if any of the attempts to load the data failed, stbi hands back null and texels stay empty
+    if (pixels == nullptr)
+        return decoded;
+
+    decoded.extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1};
+
+    std::shared_ptr<const void> owner(pixels, [](const void *p) { stbi_image_free(const_cast<void *>(p)); });
+    decoded.texels.data = std::span<const uint8_t>(pixels, static_cast<size_t>(width) * height * 4);
+    decoded.texels.owner = std::move(owner);
+
+    if (options.generateMips)
+    {
+        decoded.mipLevels = texproc::mip_level_count(decoded.extent);
+        // color is averaged in linear space, or every level would come out darker than the one above it
+        decoded.texels = SharedSpan<uint8_t>::fromVector(
+            texproc::generate_mips(decoded.texels.data, decoded.extent, role == TextureRole::Color));
+    }
+
+    // the importer only compresses to formats the device can sample
+    bool compress = options.compressTextures && options.textureCompressionBC;
+    if (compress && role == TextureRole::Color)
+    {
+        decoded.format = VK_FORMAT_BC7_UNORM_BLOCK;
+        decoded.texels = SharedSpan<uint8_t>::fromVector(
+            texproc::compress(decoded.texels.data, decoded.extent, decoded.mipLevels, decoded.format));
+    }
+    else if (compress && role == TextureRole::MetalRough)
+    {
+        // a metallic channel that is all 0 or all 1 leaves a single channel roughness map, which fits bc4 and comes
+        // back through the swizzle
+        std::span<const uint8_t> baseLevel = decoded.texels.data.first(
+            texproc::mip_level_size(VK_FORMAT_R8G8B8A8_UNORM, decoded.extent));
+        uint8_t metallic = baseLevel[2];
+        bool uniformMetallic = metallic == 0 || metallic == 255;
+        for (size_t i = 2; uniformMetallic && i < baseLevel.size(); i += 4)
+            uniformMetallic = baseLevel[i] == metallic;
+
+        if (uniformMetallic)
+        {
+            decoded.format = VK_FORMAT_BC4_UNORM_BLOCK;
+            decoded.texels = SharedSpan<uint8_t>::fromVector(
+                texproc::compress(decoded.texels.data, decoded.extent, decoded.mipLevels, decoded.format, {1, 1}));
+            decoded.swizzle = {VK_COMPONENT_SWIZZLE_ZERO, VK_COMPONENT_SWIZZLE_R,
+                               metallic == 0 ? VK_COMPONENT_SWIZZLE_ZERO : VK_COMPONENT_SWIZZLE_ONE,
+                               VK_COMPONENT_SWIZZLE_ONE};
+        }
+        else
+        {
+            // roughness (g) and metallic (b) go into the two bc5 channels, the view moves them back to where the
+            // shader samples them
+            decoded.format = VK_FORMAT_BC5_UNORM_BLOCK;
+            decoded.texels = SharedSpan<uint8_t>::fromVector(
+                texproc::compress(decoded.texels.data, decoded.extent, decoded.mipLevels, decoded.format, {1, 2}));
+            decoded.swizzle = {VK_COMPONENT_SWIZZLE_ZERO, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G,
+                               VK_COMPONENT_SWIZZLE_ONE};
+        }
+    }
+    return decoded;
+}
+
+VkFormat unorm_format(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+        return VK_FORMAT_BC2_UNORM_BLOCK;
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        return VK_FORMAT_BC3_UNORM_BLOCK;
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return VK_FORMAT_BC7_UNORM_BLOCK;
+    default:
+        return format;
+    }
+}
+
+std::optional<size_t> texture_image(const fastgltf::Texture &texture, const std::vector<ImportedImage> &images)
+{
+    // KHR_texture_basisu points at a ktx2 image and keeps imageIndex as a fallback. use the ktx2 one when it loaded
+    if (texture.basisuImageIndex.has_value() && *texture.basisuImageIndex < images.size() &&
+        !images[*texture.basisuImageIndex].texels.data.empty())
+        return *texture.basisuImageIndex;
+    if (texture.imageIndex.has_value())
+        return *texture.imageIndex;
+    if (texture.basisuImageIndex.has_value())
+        return *texture.basisuImageIndex;
+    return {};
+}
+
+std::vector<std::span<const uint8_t>> ImportedImage::level_spans() const
+{
+    if (!levels.empty() || texels.data.empty())
+        return levels;
+
+    std::vector<std::span<const uint8_t>> spans;
+    size_t offset = 0;
+    for (uint32_t level = 0; level < mipLevels; level++)
+    {
+        size_t size = texproc::mip_level_size(format, texproc::mip_extent(extent, level));
+        spans.push_back(texels.data.subspan(offset, size));
+        offset += size;
+    }
+    return spans;
+}
+
+uint64_t texture_cache_key(const ImportedImage &image)
+{
+    // the same file can be uploaded differently depending on how it is used and the import options, so everything
+    // that ends up in the image is part of the key
+    std::array<uint32_t, 9> layout = {image.extent.width,
+                                      image.extent.height,
+                                      image.extent.depth,
+                                      static_cast<uint32_t>(image.format),
+                                      image.mipLevels,
+                                      static_cast<uint32_t>(image.swizzle.r),
+                                      static_cast<uint32_t>(image.swizzle.g),
+                                      static_cast<uint32_t>(image.swizzle.b),
+                                      static_cast<uint32_t>(image.swizzle.a)};
+
+    return hash_bytes(layout.data(), sizeof(layout), image.contentHash);
+}
+
+template <typename T>
+vertexasm::FloatStream attribute_stream(const fastgltf::Asset &asset, const fastgltf::Accessor &accessor,
+                                        size_t vertexCount, std::vector<T> &scratch)
+{
+    // an attribute with fewer elements than there are positions is ignored, the vertices keep the default
+    if (accessor.count < vertexCount)
         return {};
-    else
-        return newImage;
+
+    if (std::optional<vertexasm::FloatStream> stream = vertexasm::float_stream(asset, accessor, T::length()))
+        return *stream;
+
+    scratch.resize(vertexCount);
+    fastgltf::iterateAccessorWithIndex<T>(asset, accessor,
+                                          [&](T v, size_t index)
+                                          {
+                                              if (index < vertexCount)
+                                                  scratch[index] = v;
+                                          });
+    return {reinterpret_cast<const std::byte *>(scratch.data()), sizeof(T)};
+}
+
+float elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.f;
+}
+
+void count_imported_bytes(const ImportedScene &imported, LoadStats &stats)
+{
+    for (const ImportedImage &image : imported.images)
+        stats.texelBytes += image.texels.data.size_bytes();
+    for (const ImportedMesh &mesh : imported.meshes)
+    {
+        stats.vertexBytes += mesh.vertices.data.size_bytes() + mesh.packedVertices.data.size_bytes();
+        stats.indexBytes += mesh.indices.data.size_bytes();
+    }
 }
@@ -3,6 +3,7 @@
 #include "GPUResourceAllocator.h"
 #include "sgraph/ScenegraphStructs.h"
 #include "vk_descriptors.h"
+#include <algorithm>
 #include <filesystem>
 #include <string>
 #include <unordered_map>
@@ -10,6 +11,7 @@
 
 // importing PBEngine gives me circular dependency issues,so forward declaring this for now.
 struct GLTFMRMaterialSystem;
+class TextureStreamer;
 
 struct GLTFMaterial
 {
@@ -23,11 +25,39 @@ struct Bounds
     glm::vec3 extents;
 };
 
+// bounds of a surface in world space: the box around the transformed local box and the transformed sphere, both
+// around center. computed by the mesh nodes when their transform changes and kept in their render proxies
+struct WorldBounds
+{
+    glm::vec3 center;
+    float radius;
+    glm::vec3 extents;
+
+    static WorldBounds from(const Bounds &bounds, const glm::mat4 &transform)
+    {
+        glm::mat3 basis(transform);
+        glm::mat3 absolute(glm::abs(basis[0]), glm::abs(basis[1]), glm::abs(basis[2]));
+        float scale = std::max({glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2])});
+
+        WorldBounds world;
+        world.center = transform * glm::vec4(bounds.origin, 1.f);
+        world.radius = bounds.sphereRadius * scale;
+        world.extents = absolute * bounds.extents;
+        return world;
+    }
+};
+
 struct GeoSurface
 {
     uint32_t startIndex;
     uint32_t count;
     Bounds bounds;
+    // range in MeshAsset::meshlets, empty when the mesh has no meshlets
+    uint32_t firstMeshlet = 0;
+    uint32_t meshletCount = 0;
+    // range in MeshAsset::lods, the first level is the surface itself. empty when the surface was not simplified
+    uint32_t firstLod = 0;
+    uint32_t lodCount = 0;
     std::shared_ptr<GLTFMaterial> material;
 };
 
@@ -36,7 +66,58 @@ struct MeshAsset
     std::string name;
 
     std::vector<GeoSurface> surfaces;
+    // kept on the cpu for culling, index ranges are relative to meshBuffers.firstIndex
+    std::vector<Meshlet> meshlets;
+    std::vector<SurfaceLod> lods;
     GPUMeshBuffers meshBuffers;
+    // set once meshBuffers holds the uploaded geometry, meshes of a scene that is still loading are skipped until then
+    bool resident = false;
+};
+
+// processing done while importing a file. a scene cache is only reused when it was baked with the same options.
+struct ImportOptions
+{
+    // weld, vertex cache, overdraw and vertex fetch passes on every mesh
+    bool optimizeMeshes = true;
+    // store meshes as PackedVertex when the position rounding error stays under maxPositionError (in model units)
+    // and the uv rounding error under maxUVError (in uv units, an eighth of a texel of a 4096 texture)
+    bool quantizeVertices = true;
+    float maxPositionError = 0.0005f;
+    float maxUVError = 1.f / 32768;
+    // split every surface into meshlets with bounds for culling
+    bool buildMeshlets = true;
+    // simplified index lists per surface, the coarsest one may be lodMaxError * the surface radius off
+    bool buildLods = true;
+    float lodMaxError = 0.02f;
+    // full mip chains for every texture, filtered on the worker threads that decode them
+    bool generateMips = true;
+    // BC7 for color textures, BC4 or BC5 for metal-rough. only done when textureCompressionBC is set too
+    bool compressTextures = true;
+    // the device can sample BCn formats. block compressed ktx2 textures are rejected without it, whether or not the
+    // importer compresses textures itself
+    bool textureCompressionBC = true;
+
+    bool operator==(const ImportOptions &) const = default;
+};
+
+// wall time of every phase of loading a file, in ms, and the bytes that went through them. phases that run on the
+// worker pool are timed from the thread waiting on them.
+struct LoadStats
+{
+    bool fromSceneCache = false;
+    float fileReadMs = 0;         // mapping the file and its external buffers, or reading the scene cache
+    float parseMs = 0;            // json and glb chunks
+    float imageDecodeMs = 0;      // decode, mips and compression of every texture
+    float vertexConversionMs = 0; // indices and attributes into the engine layout, bounds are computed in this pass
+    float meshProcessingMs = 0;   // optimization, meshlets, lods and quantization
+    float uploadMs = 0;           // staging and copies, until the gpu is done with them
+    float descriptorWriteMs = 0;  // material sets
+
+    size_t fileBytes = 0;   // mapped from disk
+    size_t texelBytes = 0;  // decoded textures, every mip level
+    size_t vertexBytes = 0; // as stored, after quantization
+    size_t indexBytes = 0;
+    size_t uploadBytes = 0; // staged for the gpu
 };
 
 // contains details requried for the loaders.
@@ -48,6 +129,13 @@ struct GLTFCreatorData
     AllocatedImage defaultImage;
     VkSampler _defaultSamplerLinear;
     GLTFMRMaterialSystem *materialSystemReference;
+
+    // when set, textures are only uploaded once a material using them is visible, see TextureStreamer
+    TextureStreamer *textureStreamer = nullptr;
+
+    // read/write the baked scene cache next to the source file
+    bool useSceneCache = true;
+    ImportOptions importOptions;
 };
 
 // lighting data
@@ -69,6 +157,116 @@ struct LightingData
     std::string name;
 };
 
+// read only view into loaded asset data, together with whatever owns the memory behind it (a heap copy, an stbi
+// allocation or a mapped scene cache)
+template <typename T> struct SharedSpan
+{
+    std::span<const T> data;
+    std::shared_ptr<const void> owner;
+
+    static SharedSpan fromVector(std::vector<T> &&values)
+    {
+        auto owned = std::make_shared<const std::vector<T>>(std::move(values));
+        return SharedSpan{std::span<const T>(*owned), owned};
+    }
+};
+
+// {{{ IMPORTED DATA - cpu side contents of a gltf file (or its scene cache), before anything is on the gpu.
+// indices into the other arrays are -1 when not present.
+
+struct ImportedSurface
+{
+    uint32_t startIndex;
+    uint32_t count;
+    Bounds bounds;
+    uint32_t materialIndex;
+    uint32_t firstMeshlet = 0;
+    uint32_t meshletCount = 0;
+    uint32_t firstLod = 0;
+    uint32_t lodCount = 0;
+};
+
+struct ImportedMesh
+{
+    std::string name;
+    std::vector<ImportedSurface> surfaces;
+
+    // only the array matching the format is filled
+    VertexFormat vertexFormat = VertexFormat::Float;
+    SharedSpan<Vertex> vertices;
+    SharedSpan<PackedVertex> packedVertices;
+    VertexQuantization quantization;
+
+    SharedSpan<uint32_t> indices;
+    SharedSpan<Meshlet> meshlets;
+    SharedSpan<SurfaceLod> lods;
+};
+
+struct ImportedImage
+{
+    std::string name;
+    VkExtent3D extent;
+    VkFormat format;
+    uint32_t mipLevels;
+    // applied by the image view, compressed textures can keep their channels elsewhere than the shader reads them
+    VkComponentMapping swizzle{};
+    // hash of the encoded file bytes, scenes share the uploaded image when it matches (see TextureCache)
+    uint64_t contentHash = 0;
+    // all mip levels, empty if the image failed to decode. back to back in level order unless levels is set
+    SharedSpan<uint8_t> texels;
+    // one view per level into texels, level 0 first. ktx2 files store their levels smallest first with padding in
+    // between, they are uploaded from the file as they are
+    std::vector<std::span<const uint8_t>> levels;
+
+    // a view per mip level, from levels or by splitting texels. empty if the image failed to decode
+    std::vector<std::span<const uint8_t>> level_spans() const;
+};
+
+struct ImportedSampler
+{
+    VkFilter magFilter;
+    VkFilter minFilter;
+    VkSamplerMipmapMode mipmapMode;
+};
+
+struct ImportedMaterial
+{
+    std::string name;
+    glm::vec4 colorFactors;
+    glm::vec4 metalRoughFactors;
+    MaterialPass passType;
+    int32_t colorImage = -1;
+    int32_t colorSampler = -1;
+    int32_t metalRoughImage = -1;
+    int32_t metalRoughSampler = -1;
+};
+
+struct ImportedNode
+{
+    std::string name;
+    int32_t mesh = -1;
+    int32_t light = -1;
+    glm::mat4 localTransform;
+    std::vector<uint32_t> children;
+};
+
+struct ImportedScene
+{
+    std::vector<ImportedMesh> meshes;
+    std::vector<ImportedImage> images;
+    std::vector<ImportedSampler> samplers;
+    std::vector<ImportedMaterial> materials;
+    std::vector<ImportedNode> nodes;
+    std::vector<LightingData> lights;
+
+    // every file the scene was read from, the scene cache is invalidated when any of them change
+    std::vector<std::filesystem::path> sourceFiles;
+    // options the scene was imported with
+    ImportOptions options;
+};
+
+// }}} IMPORTED DATA end
+
 // forward declaration
 class VulkanEngine;
 
@@ -83,18 +281,22 @@ namespace sgraph
         std::unordered_map<std::string, std::shared_ptr<MeshAsset>> meshes;
         std::unordered_map<std::string, std::shared_ptr<Node>> nodes;
         std::unordered_map<std::string, AllocatedImage> images;
+        // TextureCache keys of the images above, they are released instead of destroyed. with a texture streamer
+        // the images are not uploaded here and the keys are released to the streamer instead
+        std::vector<uint64_t> textureKeys;
         std::unordered_map<std::string, std::shared_ptr<GLTFMaterial>> materials;
         std::unordered_map<std::string, std::shared_ptr<LightingData>> lightingData;
 
         // nodes that dont have a parent, for iterating through the file in tree order
         std::vector<std::shared_ptr<Node>> topNodes;
+        // local and world matrices of every node, parents first
+        std::shared_ptr<TransformStore> transforms;
+        // the node of every handle of the store, owned by nodes
+        std::vector<Node *> nodesByHandle;
 
+        // owned by the SamplerCache of the allocator
         std::vector<VkSampler> samplers;
 
-        DescriptorAllocatorGrowable descriptorPool;
-
-        AllocatedBuffer materialDataBuffer;
-
         GLTFCreatorData creator;
 
         ~GLTFScene()
@@ -102,14 +304,127 @@ namespace sgraph
             clearAll();
         };
 
-        virtual void Draw(const glm::mat4 &topMatrix, DrawContext &ctx);
+        /**
+         * @brief Register the nodes that are ready with the registry, and push the world transforms that changed
+         * since the last sync to their proxies. The first sync registers everything it can, after that the cost
+         * follows the nodes that moved and the meshes that are still uploading.
+         *
+         */
+        virtual void Sync(const glm::mat4 &topMatrix, RenderProxyRegistry &registry);
 
         std::string name;
 
       private:
         void clearAll();
+
+        // moved nodes per batch when their proxies are updated on the thread pool
+        static constexpr size_t proxyUpdateBatch = 512;
+
+        // the registry of the first sync, the proxies are removed from it with the scene
+        RenderProxyRegistry *registry = nullptr;
+        // nodes that could not register yet
+        std::vector<Node *> pendingNodes;
     };
 
 } // namespace sgraph
 
-std::optional<std::shared_ptr<sgraph::GLTFScene>> loadGltf(GLTFCreatorData creatorData, std::string_view filePath);
\ No newline at end of file
+/**
+ * @brief Read a gltf/glb file into cpu memory. Textures are decoded, vertices interleaved and bounds computed, but
+ * nothing is uploaded.
+ *
+ */
+std::optional<ImportedScene> importGltf(const std::filesystem::path &filePath, const ImportOptions &options,
+                                        LoadStats *stats = nullptr);
+
+/**
+ * @brief Get the cpu side contents of a gltf/glb file. Uses the scene cache next to the file when it is up to date,
+ * otherwise imports the file and writes a new cache. Does not touch the gpu, so it can run on any thread.
+ *
+ */
+std::optional<ImportedScene> readOrImportGltf(const std::filesystem::path &filePath,
+                                              const GLTFCreatorData &creatorData, LoadStats *stats = nullptr);
+
+/**
+ * @brief Uploads an imported scene in steps, each staging about a given number of bytes, so the upload can be spread
+ * over several frames. Images are uploaded first, then the materials and nodes are built, then the meshes are
+ * uploaded. The scene can be drawn once its nodes exist, meshes that are not uploaded yet are skipped.
+ *
+ */
+class GLTFSceneBuilder
+{
+  public:
+    GLTFSceneBuilder(GLTFCreatorData creatorData, std::shared_ptr<const ImportedScene> imported);
+
+    /**
+     * @brief Upload the next resources, until byteBudget bytes are staged. At least one resource is uploaded per
+     * step, even when it is bigger than the budget. Has to run on the thread that owns the gpu queue.
+     *
+     * @return true once every resource is uploaded.
+     */
+    bool step(size_t byteBudget);
+
+    // the materials and nodes exist once every image is recorded, the scene can be drawn from then on
+    bool nodes_built() const
+    {
+        return stage > Stage::Images;
+    }
+
+    // empty until the nodes are built
+    std::shared_ptr<sgraph::GLTFScene> scene() const
+    {
+        return nodes_built() ? builtScene : nullptr;
+    }
+
+    bool done() const
+    {
+        return stage == Stage::Done;
+    }
+
+    // upload and descriptor write phases of the steps so far, the other fields stay empty
+    const LoadStats &stats() const
+    {
+        return buildStats;
+    }
+
+  private:
+    enum class Stage
+    {
+        Images,
+        Meshes,
+        Done,
+    };
+
+    void build_nodes();
+
+    GLTFCreatorData creatorData;
+    std::shared_ptr<const ImportedScene> imported;
+    std::shared_ptr<sgraph::GLTFScene> builtScene;
+    Stage stage = Stage::Images;
+    // next image or mesh to upload
+    size_t next = 0;
+
+    std::vector<AllocatedImage> images;
+    // streamer keys of the images, 0 for the ones that failed to load
+    std::vector<uint64_t> streamedImages;
+    std::vector<std::shared_ptr<MeshAsset>> meshes;
+    UploadBatchStats uploadStats{};
+    LoadStats buildStats{};
+    uint32_t sharedImages = 0;
+};
+
+/**
+ * @brief Upload an imported scene and build the scene nodes, materials and samplers for it, all at once.
+ *
+ */
+std::shared_ptr<sgraph::GLTFScene> buildGltfScene(GLTFCreatorData creatorData,
+                                                  std::shared_ptr<const ImportedScene> imported,
+                                                  LoadStats *stats = nullptr);
+
+/**
+ * @brief Load a gltf/glb file and upload it, blocking until the scene is resident. See AsyncSceneLoader to load in
+ * the background instead.
+ *
+ * @param stats when set, filled with the time spent in every phase of the load
+ */
+std::optional<std::shared_ptr<sgraph::GLTFScene>> loadGltf(GLTFCreatorData creatorData, std::string_view filePath,
+                                                           LoadStats *stats = nullptr);
@@ -57,13 +57,79 @@ struct Vertex
     glm::vec4 color;
 };
 
-// holds the resources needed for a mesh
-struct GPUMeshBuffers
+// layout of the vertices of a mesh, the shaders decode both
+enum class VertexFormat : uint32_t
+{
+    Float,  // Vertex
+    Packed, // PackedVertex
+};
+
+// 20 byte vertex. position and uv are unorm16 relative to the mesh bounds, normal is octahedral snorm16.
+struct PackedVertex
+{
+    uint16_t position[3];
+    uint16_t pad;
+    int16_t normal[2];
+    uint16_t uv[2];
+    uint8_t color[4];
+};
+static_assert(sizeof(PackedVertex) == 20);
+
+// turns the unorm values of a packed vertex back into positions and uvs: value = offset + unorm * scale
+struct VertexQuantization
+{
+    glm::vec4 positionOffset; // xyz
+    glm::vec4 positionScale;  // xyz
+    glm::vec4 uvOffsetScale;  // xy offset, zw scale
+};
+
+// cluster of up to 64 vertices / 124 triangles of a surface, with culling data in mesh space. the triangles of a
+// meshlet are contiguous in the index buffer.
+struct Meshlet
+{
+    uint32_t firstIndex; // into the index array of the mesh
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    uint32_t pad;
+    glm::vec4 boundingSphere; // xyz center, w radius
+    // the meshlet is back facing from anywhere where dot(normalize(apex - eye), axis) >= cutoff. cutoff 1 when the
+    // triangles face too many directions for a cone
+    glm::vec4 coneAxisCutoff;
+    glm::vec4 coneApex;
+};
+
+// simplified version of a surface, as an index range of the mesh
+struct SurfaceLod
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error; // largest distance from the full detail surface, in model units
+};
+
+// byte ranges of a mesh inside the geometry pool
+struct GeometryAllocation
 {
+    uint32_t page;
+    VkDeviceSize vertexOffset;
+    VkDeviceSize vertexSize;
+    VkDeviceSize indexOffset;
+    VkDeviceSize indexSize;
+};
 
-    AllocatedBuffer indexBuffer;
-    AllocatedBuffer vertexBuffer;
+// holds the resources needed for a mesh. the buffers belong to the geometry pool and are shared with other meshes.
+struct GPUMeshBuffers
+{
+    VkBuffer indexBuffer;
     VkDeviceAddress vertexBufferAddress;
+
+    // where the mesh starts inside the shared buffers, in indices and vertices
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+
+    VertexFormat vertexFormat;
+    VertexQuantization quantization;
+
+    GeometryAllocation allocation;
 };
 
 // push constants for our mesh object draws
@@ -71,7 +137,11 @@ struct GPUDrawPushConstants
 {
     glm::mat4 worldMatrix;
     VkDeviceAddress vertexBuffer;
+    VertexFormat vertexFormat;
+    uint32_t materialIndex; // entry of the bindless material table
+    VertexQuantization quantization;
 };
+static_assert(sizeof(GPUDrawPushConstants) <= 128, "push constants have to fit the guaranteed minimum");
 
 enum class MaterialPass : uint8_t
 {
@@ -87,6 +157,6 @@ struct MaterialPipeline
 
 struct MaterialInstance
 {
-    VkDescriptorSet materialSet;
+    uint32_t materialIndex; // entry of the material table of GLTFMRMaterialSystem
     MaterialPass passType;
 };
\ No newline at end of file